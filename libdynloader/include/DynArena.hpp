@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __DYNARENA_HPP__
+#define __DYNARENA_HPP__
+
+#include <platform.h>
+
+#include "DynClass.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @brief Memory usage of an arena
+ */
+struct DynArenaStats
+{
+	size_t liveBytes;
+	size_t peakBytes;
+	size_t reservedBytes;
+	uint64_t allocations;
+	uint64_t deallocations;
+
+	DynArenaStats() : liveBytes(0), peakBytes(0), reservedBytes(0), allocations(0), deallocations(0)
+	{
+	}
+};
+
+/**
+ * @class DynArena DynArena.hpp <DynArena.hpp>
+ * @brief Memory arena of a single library
+ *
+ * Small blocks are carved from large chunks and recycled through per size
+ * class free lists, so the allocations of one plugin stay together and do
+ * not fragment the process heap. Large blocks come from the global heap
+ * but are still owned by the arena. Everything can be freed at once.
+ */
+class API_EXPORT DynArena : public DynAllocator
+{
+private:
+	/* @brief Header of a large block, linked into the arena */
+	struct LargeBlock;
+
+	/* @brief Granularity and limit of the small size classes */
+	static const size_t Granularity = alignof(std::max_align_t);
+	static const size_t MaxSmallSize = 1024;
+	static const size_t SizeClassCount = MaxSmallSize / Granularity;
+	static const size_t ChunkSize = 64 * 1024;
+
+	std::mutex mutex;
+	std::vector<unsigned char*> chunks;
+	unsigned char* cursor;
+	size_t remaining;
+	void* freeLists[SizeClassCount];
+	LargeBlock* largeBlocks;
+	DynArenaStats stats;
+
+public:
+	DynArena();
+
+	/**
+	 * @brief Free all memory of the arena
+	 */
+	~DynArena();
+
+	/* @brief Disable copy constructors */
+	DynArena(const DynArena&) = delete;
+	DynArena& operator=(const DynArena&) = delete;
+
+	/**
+	 * @brief Allocate memory
+	 * @param size - [in] bytes
+	 * @return memory, nullptr if exhausted
+	 */
+	void* Allocate(size_t size) throw();
+
+	/**
+	 * @brief Free memory
+	 * @param memory - [in] memory returned by Allocate()
+	 * @param size - [in] bytes passed to Allocate()
+	 */
+	void Deallocate(void* memory, size_t size) throw();
+
+	/**
+	 * @brief Free all memory of the arena in one step
+	 * Memory handed out before is invalid afterwards.
+	 */
+	void Release();
+
+	/**
+	 * @brief Get memory usage
+	 */
+	DynArenaStats Stats();
+
+}; // class DynArena
+
+} // namespace DynLoader
+
+#endif // __DYNARENA_HPP__
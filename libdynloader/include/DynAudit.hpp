@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __DYNAUDIT_HPP__
+#define __DYNAUDIT_HPP__
+
+#include <platform.h>
+
+/**
+ * @file DynAudit.hpp
+ * @brief Hooks of the libdynloader-audit rtld-audit module
+ *
+ * Running a process with LD_AUDIT=libdynloader-audit.so breaks every
+ * library load of a DynLib into the phases of the system loader. The
+ * module appends one tab separated line per load to the file named by
+ * DYN_AUDIT_FILE_VARIABLE, /tmp/dynloader-audit-<pid>.log by default:
+ *
+ * @code
+ * open <pid> <ok> <start> <total> <wait> <search> <map> <reloc> <init> <objects> <relocs> <relative> <plt> <bound> <lazy> <file>
+ * close <pid> <lazy> <file>
+ * @endcode
+ *
+ * start is the CLOCK_MONOTONIC time the load began at, the durations are
+ * in nanoseconds:
+ * - wait: until the system loader started, mostly its lock
+ * - search: looking up the files of the library and its new dependencies
+ * - map: mapping them and checking their versions
+ * - reloc: relocating them, up to the last PLT slot bound
+ * - init: the rest, mainly the static constructors
+ *
+ * objects is the number of objects mapped by the load. relocs, relative
+ * and plt are the relocations of those objects, of which relative ones
+ * need no symbol lookup and plt ones are bound lazily unless the library
+ * is opened with SymbolBinding::Now. bound counts the PLT slots bound
+ * while relocating, lazy the ones bound by the constructors. A close line
+ * is written once an object mapped by a load is unmapped, lazy counts the
+ * PLT slots it bound on its first calls over its lifetime.
+ *
+ * Relative and data relocations are not reported to audit modules. Their
+ * time after the last PLT slot, and all relocations of lazily bound
+ * libraries, is counted as init.
+ *
+ * dynloader-audit-report summarizes the file per library.
+ */
+
+/**
+ * @def DYN_AUDIT_FILE_VARIABLE
+ * @brief Environment variable naming the file the audit module writes
+ */
+#define DYN_AUDIT_FILE_VARIABLE "DYNLOADER_AUDIT_FILE"
+
+/**
+ * @def DYN_AUDIT_OPEN_START_SYMBOL
+ * @brief Name of the hook called before a DynLib maps its module
+ */
+#define DYN_AUDIT_OPEN_START_SYMBOL "DynAuditOpenStartV1"
+
+/**
+ * @def DYN_AUDIT_OPEN_DONE_SYMBOL
+ * @brief Name of the hook called after a DynLib mapped its module
+ */
+#define DYN_AUDIT_OPEN_DONE_SYMBOL "DynAuditOpenDoneV1"
+
+extern "C"
+{
+
+/**
+ * @brief Called before a DynLib maps its module
+ * @param fileName - [in] file name passed to the system loader
+ *
+ * Does nothing. Calls go through the PLT of libdynloader, which the audit
+ * module binds to its own hook. The static library cannot be audited.
+ */
+API_EXPORT void DynAuditOpenStartV1(const char* fileName);
+
+/**
+ * @brief Called after a DynLib mapped its module
+ * @param fileName - [in] file name passed to the system loader
+ * @param handle - [in] system library handle, nullptr on failure
+ *
+ * Does nothing, see DynAuditOpenStartV1().
+ */
+API_EXPORT void DynAuditOpenDoneV1(const char* fileName, void* handle);
+
+} // extern "C"
+
+#endif // __DYNAUDIT_HPP__
@@ -31,26 +31,251 @@
 
 #include <platform.h>
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
 /**
  * @namespace DynLoader
  */
 namespace DynLoader
 {
 
+/* @brief DynClass forward declaration */
+class DynClass;
+
+/**
+ * @class DynAllocator DynClass.hpp <DynClass.hpp>
+ * @brief Allocator a host installs into a module
+ * Memory must be aligned for any fundamental type.
+ */
+class API_LOCAL DynAllocator
+{
+public:
+	/**
+	 * @brief Allocate memory
+	 * @param size - [in] bytes
+	 * @return memory, nullptr if exhausted
+	 */
+	virtual void* Allocate(size_t size) throw() = 0;
+
+	/**
+	 * @brief Free memory
+	 * @param memory - [in] memory returned by Allocate()
+	 * @param size - [in] bytes passed to Allocate()
+	 */
+	virtual void Deallocate(void* memory, size_t size) throw() = 0;
+
+protected:
+	virtual ~DynAllocator() { }
+
+}; // class DynAllocator
+
+namespace Detail
+{
+
+/**
+ * @brief Allocator installed into the calling module, nullptr for the global heap
+ * Hidden so that every module binds to its own allocator.
+ */
+inline API_HELPER_LOCAL std::atomic<DynAllocator*>& ModuleAllocator()
+{
+	static std::atomic<DynAllocator*> allocator(nullptr);
+
+	return allocator;
+}
+
+/**
+ * @brief Prefix of every instance allocated with new
+ * Instances remember their allocator, so they are freed correctly even if
+ * the module allocator changed since they were created.
+ */
+struct alignas(std::max_align_t) AllocationHeader
+{
+	DynAllocator* allocator;
+	size_t size;
+};
+
+} // namespace Detail
+
+/**
+ * @brief Get the allocator installed into the calling module
+ * @return allocator, nullptr while the module uses the global heap
+ */
+inline API_HELPER_LOCAL DynAllocator* GetModuleAllocator()
+{
+	return Detail::ModuleAllocator().load(std::memory_order_acquire);
+}
+
+/**
+ * @class DynModuleAllocator DynClass.hpp <DynClass.hpp>
+ * @brief Standard allocator drawing from the allocator of the calling module
+ *
+ * Lets plugin containers allocate from the module arena like the classes
+ * themselves. The allocator is taken when the adaptor is constructed, so
+ * memory goes back to where it came from even if the module allocator
+ * changes. Types aligned beyond std::max_align_t are not supported.
+ */
+template<typename T>
+class API_HELPER_LOCAL DynModuleAllocator
+{
+private:
+	DynAllocator* allocator;
+
+	template<typename U>
+	friend class DynModuleAllocator;
+
+public:
+	typedef T value_type;
+
+	DynModuleAllocator() : allocator(GetModuleAllocator())
+	{
+	}
+
+	template<typename U>
+	DynModuleAllocator(const DynModuleAllocator<U>& other) : allocator(other.allocator)
+	{
+	}
+
+	/**
+	 * @brief Allocate memory for objects
+	 * @param count - [in] number of objects
+	 * @return uninitialized memory
+	 */
+	T* allocate(size_t count)
+	{
+		void* memory = allocator != nullptr ? allocator->Allocate(count * sizeof(T)) : ::operator new(count * sizeof(T));
+		if(memory == nullptr)
+			throw std::bad_alloc();
+
+		return static_cast<T*>(memory);
+	}
+
+	/**
+	 * @brief Free memory of objects
+	 * @param memory - [in] memory returned by allocate()
+	 * @param count - [in] number of objects passed to allocate()
+	 */
+	void deallocate(T* memory, size_t count) throw()
+	{
+		if(allocator != nullptr)
+			allocator->Deallocate(memory, count * sizeof(T));
+		else
+			::operator delete(memory);
+	}
+
+	template<typename U>
+	bool operator==(const DynModuleAllocator<U>& other) const
+	{
+		return allocator == other.allocator;
+	}
+
+	template<typename U>
+	bool operator!=(const DynModuleAllocator<U>& other) const
+	{
+		return allocator != other.allocator;
+	}
+
+}; // class DynModuleAllocator
+
+/**
+ * @class DynClassOwner DynClass.hpp <DynClass.hpp>
+ * @brief Owner of instances that were not allocated with new
+ */
+class API_LOCAL DynClassOwner
+{
+public:
+	/**
+	 * @brief Destroy an instance and reclaim its memory
+	 * @param instance - [in] instance created by this owner
+	 */
+	virtual void Release(DynClass* instance) throw() = 0;
+
+protected:
+	virtual ~DynClassOwner() { }
+
+}; // class DynClassOwner
+
 /**
  * @class DynClass DynClass.hpp <DynClass.hpp>
  * @brief Common interface for all dynamically loaded classes
  */
 class API_LOCAL DynClass
 {
+private:
+	/* @brief Owner of the instance memory, nullptr if allocated with new */
+	DynClassOwner* owner;
+
+	friend class DynClassPool;
+
 public:
 	
 	/**
 	 * @brief Destroy class instance
+	 * Instances constructed in place are handed back to their owner.
 	 */
-	void Destroy() throw() { delete this; }
+	void Destroy() throw()
+	{
+		if(owner != nullptr)
+			owner->Release(this);
+		else
+			delete this;
+	}
+
+	/**
+	 * @brief Allocate an instance from the allocator of its module
+	 * @param size - [in] instance size
+	 * @return memory for the instance
+	 */
+	static void* operator new(size_t size)
+	{
+		DynAllocator* allocator = GetModuleAllocator();
+		const size_t total = size + sizeof(Detail::AllocationHeader);
+
+		void* memory = allocator != nullptr ? allocator->Allocate(total) : ::operator new(total);
+		if(memory == nullptr)
+			throw std::bad_alloc();
+
+		Detail::AllocationHeader* header = static_cast<Detail::AllocationHeader*>(memory);
+		header->allocator = allocator;
+		header->size = total;
+
+		return header + 1;
+	}
+
+	/**
+	 * @brief Free an instance through the allocator it came from
+	 * @param memory - [in] memory returned by operator new
+	 */
+	static void operator delete(void* memory) throw()
+	{
+		if(memory == nullptr)
+			return;
+
+		Detail::AllocationHeader* header = static_cast<Detail::AllocationHeader*>(memory) - 1;
+		if(header->allocator != nullptr)
+			header->allocator->Deallocate(header, header->size);
+		else
+			::operator delete(header);
+	}
 
 protected:
+	DynClass() : owner(nullptr)
+	{
+	}
+
+	/* @brief Copies do not share the memory owner of the original */
+	DynClass(const DynClass&) : owner(nullptr)
+	{
+	}
+
+	DynClass& operator=(const DynClass&)
+	{
+		return *this;
+	}
+
 	/**
 	 * @brief Destructor
 	 */
@@ -59,12 +284,247 @@ protected:
 }; // class DynClass
 
 /**
- * @def EXPORT_DYNCLASS DynClass.hpp <DynClass.hpp>
- * @brief Export constructor for dynamically loaded class
- * @param className - [in] name of the class
+ * @brief Signature of the factory function exported for each class
+ */
+typedef DynClass* (*DynClassBuilder)();
+
+/**
+ * @brief Signature of the placement constructor exported for each class
+ * Constructs the class in memory of at least its size and alignment and
+ * returns nullptr if the constructor failed.
+ */
+typedef DynClass* (*DynClassConstructor)(void* memory);
+
+/**
+ * @brief Signature of the in-place destructor exported for each class
+ */
+typedef void (*DynClassDestructor)(DynClass* instance);
+
+/**
+ * @brief Hash a class or interface name at compile time
+ * @param name - [in] null terminated name
+ * @param hash - [in] hash of the preceding characters
+ * @return 64 bit FNV-1a hash
+ */
+constexpr uint64_t DynClassHash(const char* name, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+	return *name ? DynClassHash(name + 1, (hash ^ static_cast<unsigned char>(*name)) * 0x100000001b3ULL) : hash;
+}
+
+/**
+ * @brief Hash a class name at run time
+ * @param name - [in] class name
+ * @return 64 bit FNV-1a hash, equal to DynClassHash() of the same name
+ */
+inline uint64_t DynClassHash(const dyn_string& name)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for(auto c : name)
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+/**
+ * @brief Class identifier hashed at compile time
+ *
+ * Lookups by identifier probe the class table with the precomputed hash
+ * and neither allocate nor compare strings once the class is loaded. The
+ * name is only read to resolve the class on first use, so it must outlive
+ * the lookup, which string literals do.
+ */
+struct DynClassId
+{
+	uint64_t hash;
+	const char* name;
+
+	constexpr DynClassId(const char* name, uint64_t hash) : hash(hash), name(name)
+	{
+	}
+
+	constexpr explicit DynClassId(const char* name) : hash(DynClassHash(name)), name(name)
+	{
+	}
+};
+
+/**
+ * @def DYN_CLASS_ID
+ * @brief Class identifier of a class name literal, hashed at compile time
+ * @param NAME - [in] class name string literal
+ */
+#define DYN_CLASS_ID(NAME) \
+	(::DynLoader::DynClassId(NAME, std::integral_constant<uint64_t, ::DynLoader::DynClassHash(NAME)>::value))
+
+inline namespace Literals
+{
+
+/**
+ * @brief Class identifier literal, e.g. "Test1"_cls
+ * @param name - [in] class name
+ * @return class identifier, hashed at compile time in constant expressions
+ */
+constexpr DynClassId operator"" _cls(const char* name, size_t)
+{
+	return DynClassId(name);
+}
+
+} // namespace Literals
+
+/**
+ * @brief Description of an exported class
+ * One is emitted by EXPORT_DYNCLASS for every class, all classes of a
+ * module are linked into the list returned by DYN_MODULE_CLASSES_SYMBOL.
+ */
+struct DynClassInfo
+{
+	uint64_t hash;
+	const char* name;
+	DynClassBuilder builder;
+	size_t size;
+	size_t alignment;
+	DynClassConstructor construct;
+	DynClassDestructor destruct;
+	uint64_t interfaceId;
+	const DynClassInfo* next;
+};
+
+/**
+ * @def DYN_MODULE_CLASSES_SYMBOL
+ * @brief Name of the function returning the class list of a module
+ * The suffix changes whenever the layout of DynClassInfo does.
+ */
+#define DYN_MODULE_CLASSES_SYMBOL "DynModuleClassesV2"
+
+/**
+ * @brief Signature of the function returning the class list of a module
+ */
+typedef const DynClassInfo* (*DynModuleClasses)();
+
+/**
+ * @def DYN_MODULE_ALLOCATOR_SYMBOL
+ * @brief Name of the function installing an allocator into a module
+ */
+#define DYN_MODULE_ALLOCATOR_SYMBOL "DynModuleInstallAllocatorV1"
+
+/**
+ * @brief Signature of the function installing an allocator into a module
+ */
+typedef bool (*DynModuleInstallAllocator)(DynAllocator* expected, DynAllocator* desired);
+
+/**
+ * @def DYN_MODULE_WARMUP_SYMBOL
+ * @brief Name of the optional function preparing a module for requests
+ */
+#define DYN_MODULE_WARMUP_SYMBOL "DynModuleWarmUpV1"
+
+/**
+ * @brief Signature of the function preparing a module for requests
+ */
+typedef void (*DynModuleWarmUp)();
+
+/**
+ * @brief Point of DynLoader::ForkWorker() a fork handler is called at
+ */
+enum class DynForkPhase
+{
+	/* @brief Before fork(), in the parent */
+	Prepare,
+	/* @brief After fork(), in the parent */
+	Parent,
+	/* @brief After fork(), in the new worker */
+	Child
+};
+
+/**
+ * @def DYN_MODULE_FORK_SYMBOL
+ * @brief Name of the optional function adjusting a module to a fork
+ */
+#define DYN_MODULE_FORK_SYMBOL "DynModuleForkV1"
+
+/**
+ * @brief Signature of the function adjusting a module to a fork
+ */
+typedef void (*DynModuleFork)(DynForkPhase phase);
+
+namespace Detail
+{
+
+/**
+ * @brief Head of the class list of the calling module
+ * Hidden so that every module binds to its own list, even when modules are
+ * opened with global symbol scope.
+ */
+inline API_HELPER_LOCAL const DynClassInfo*& ModuleClasses()
+{
+	static const DynClassInfo* head = nullptr;
+
+	return head;
+}
+
+} // namespace Detail
+
+} // namespace DynLoader
+
+/**
+ * @brief Get the class list of this module
+ * @return first class, nullptr if the module exports none
+ */
+extern "C" inline API_HELPER_EXPORT const DynLoader::DynClassInfo* DynModuleClassesV2() throw()
+{
+	return DynLoader::Detail::ModuleClasses();
+}
+
+/**
+ * @brief Replace the allocator of this module
+ * @param expected - [in] allocator that must be installed
+ * @param desired - [in] new allocator, nullptr for the global heap
+ * @return false if a different allocator was installed
+ */
+extern "C" inline API_HELPER_EXPORT bool DynModuleInstallAllocatorV1(DynLoader::DynAllocator* expected,
+		DynLoader::DynAllocator* desired) throw()
+{
+	return DynLoader::Detail::ModuleAllocator().compare_exchange_strong(expected, desired);
+}
+
+namespace DynLoader
+{
+
+namespace Detail
+{
+
+/**
+ * @brief Links a class into the class list of its module at load time
  */
-#define EXPORT_DYNCLASS(NAME) \
-extern "C" API_EXPORT DynClass* Create##NAME() throw() \
+struct API_HELPER_LOCAL DynClassRegistrar
+{
+	explicit DynClassRegistrar(DynClassInfo& info)
+	{
+		info.next = ModuleClasses();
+		ModuleClasses() = &info;
+
+		// Taking the addresses makes every module exporting classes define
+		// the module functions, modules that only include this header do not.
+		static DynModuleClasses volatile exports = &DynModuleClassesV2;
+		static DynModuleInstallAllocator volatile install = &DynModuleInstallAllocatorV1;
+		(void) exports;
+		(void) install;
+	}
+};
+
+} // namespace Detail
+
+/**
+ * @def DYNCLASS_EXPORT
+ * @brief Export constructor and description of a class, see EXPORT_DYNCLASS
+ * @param NAME - [in] name of the class
+ * @param INTERFACE_ID - [in] hash of the interface name, 0 if unknown
+ */
+#define DYNCLASS_EXPORT(NAME, INTERFACE_ID) \
+extern "C" API_EXPORT ::DynLoader::DynClass* Create##NAME() throw() \
 { \
 	try \
 	{ \
@@ -75,6 +535,92 @@ extern "C" API_EXPORT DynClass* Create##NAME() throw() \
 		;; \
 	} \
 	return nullptr; \
+} \
+static ::DynLoader::DynClass* Construct##NAME(void* memory) throw() \
+{ \
+	try \
+	{ \
+		return ::new(memory) NAME(); \
+	} \
+	catch(...) \
+	{ \
+		;; \
+	} \
+	return nullptr; \
+} \
+static void Destruct##NAME(::DynLoader::DynClass* instance) throw() \
+{ \
+	static_cast<NAME*>(instance)->~NAME(); \
+} \
+static ::DynLoader::DynClassInfo DynClassInfo##NAME = \
+{ \
+	::DynLoader::DynClassHash(#NAME), #NAME, &Create##NAME, sizeof(NAME), alignof(NAME), \
+	&Construct##NAME, &Destruct##NAME, INTERFACE_ID, nullptr \
+}; \
+static ::DynLoader::Detail::DynClassRegistrar DynClassRegistrar##NAME(DynClassInfo##NAME);
+
+/**
+ * @def EXPORT_DYNCLASS DynClass.hpp <DynClass.hpp>
+ * @brief Export constructor for dynamically loaded class
+ * @param NAME - [in] name of the class
+ *
+ * Besides the Create function resolved per class, the class is linked
+ * into the class list of its module so the loader can index all classes
+ * of a module with one symbol lookup.
+ */
+#define EXPORT_DYNCLASS(NAME) DYNCLASS_EXPORT(NAME, 0)
+
+/**
+ * @def EXPORT_DYNCLASS_INTERFACE DynClass.hpp <DynClass.hpp>
+ * @brief Export constructor for dynamically loaded class implementing an interface
+ * @param NAME - [in] name of the class
+ * @param INTERFACE - [in] name of the interface, recorded as its hash
+ */
+#define EXPORT_DYNCLASS_INTERFACE(NAME, INTERFACE) \
+	DYNCLASS_EXPORT(NAME, ::DynLoader::DynClassHash(#INTERFACE))
+
+/**
+ * @def EXPORT_DYNMODULE_WARMUP DynClass.hpp <DynClass.hpp>
+ * @brief Export a function prefilling the caches of a module
+ * @param FUNCTION - [in] function without parameters
+ *
+ * DynLoader::WarmStart() calls it once the module's profiled classes are
+ * instantiated. Exceptions are discarded. At most one per module.
+ */
+#define EXPORT_DYNMODULE_WARMUP(FUNCTION) \
+extern "C" API_EXPORT void DynModuleWarmUpV1() throw() \
+{ \
+	try \
+	{ \
+		FUNCTION(); \
+	} \
+	catch(...) \
+	{ \
+		;; \
+	} \
+}
+
+/**
+ * @def EXPORT_DYNMODULE_FORK DynClass.hpp <DynClass.hpp>
+ * @brief Export a function adjusting per-process state of a module to a fork
+ * @param FUNCTION - [in] function taking the DynForkPhase
+ *
+ * DynLoader::ForkWorker() calls it before and after forking, e.g. to stop
+ * threads of the module in the parent and start new ones in the worker or
+ * to reseed random number generators. Exceptions are discarded. At most
+ * one per module.
+ */
+#define EXPORT_DYNMODULE_FORK(FUNCTION) \
+extern "C" API_EXPORT void DynModuleForkV1(::DynLoader::DynForkPhase phase) throw() \
+{ \
+	try \
+	{ \
+		FUNCTION(phase); \
+	} \
+	catch(...) \
+	{ \
+		;; \
+	} \
 }
 
 } // namespace DynLoader
@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __DYNCLASSPOOL_HPP__
+#define __DYNCLASSPOOL_HPP__
+
+#include <platform.h>
+
+#include "DynClass.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @class DynClassPool DynClassPool.hpp <DynClassPool.hpp>
+ * @brief Fixed number of instance slots of one class in contiguous memory
+ *
+ * Instances are constructed in place with the placement constructor of
+ * the class description. DynClass::Destroy() runs the destructor in place
+ * and returns the slot to the pool, so creating and dropping instances
+ * never touches the heap. The pool must be destroyed before the library
+ * of the class is unloaded, instances still alive at that point are
+ * destroyed with it.
+ */
+class API_EXPORT DynClassPool : public DynClassOwner
+{
+private:
+	const DynClassInfo& info;
+	unsigned char* buffer;
+	unsigned char* slots;
+	size_t stride;
+	size_t capacity;
+	bool ownsBuffer;
+
+	std::mutex mutex;
+	std::vector<uint32_t> freeSlots;
+	std::vector<DynClass*> instances;
+
+	/**
+	 * @brief Lay out the slots in a buffer
+	 * @param bytes - [in] buffer size
+	 */
+	void Init(size_t bytes);
+
+public:
+	/**
+	 * @brief Create a pool in caller provided memory
+	 * @param info - [in] class description
+	 * @param storage - [in] memory the instances are constructed in, must
+	 * outlive the pool
+	 * @param bytes - [in] size of the memory
+	 */
+	DynClassPool(const DynClassInfo& info, void* storage, size_t bytes);
+
+	/**
+	 * @brief Create a pool with its own memory
+	 * @param info - [in] class description
+	 * @param capacity - [in] number of instances
+	 */
+	DynClassPool(const DynClassInfo& info, size_t capacity);
+
+	/**
+	 * @brief Destroy remaining instances
+	 */
+	~DynClassPool();
+
+	/* @brief Disable copy constructors */
+	DynClassPool(const DynClassPool&) = delete;
+	DynClassPool& operator=(const DynClassPool&) = delete;
+
+	/**
+	 * @brief Construct an instance in a free slot
+	 * @return instance, nullptr if the pool is exhausted or the constructor failed
+	 */
+	DynClass* Construct();
+
+	/**
+	 * @brief Construct an instance in a free slot
+	 * @return instance, nullptr if the pool is exhausted or the constructor failed
+	 * Class must be the class of the pool or one of its bases
+	 */
+	template<typename Class>
+	Class* Create()
+	{
+		return static_cast<Class*>(Construct());
+	}
+
+	/**
+	 * @brief Destroy an instance in place and free its slot
+	 * @param instance - [in] instance constructed by this pool
+	 */
+	void Release(DynClass* instance) throw();
+
+	/**
+	 * @brief Get number of slots
+	 */
+	size_t Capacity() const { return capacity; }
+
+	/**
+	 * @brief Get number of free slots
+	 */
+	size_t Available();
+
+	/**
+	 * @brief Get the memory needed for a number of instances
+	 * @param info - [in] class description
+	 * @param count - [in] number of instances
+	 * @return bytes, including slack to align the first slot
+	 */
+	static size_t RequiredBytes(const DynClassInfo& info, size_t count);
+
+}; // class DynClassPool
+
+} // namespace DynLoader
+
+#endif // __DYNCLASSPOOL_HPP__
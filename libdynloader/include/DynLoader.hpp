@@ -106,10 +106,25 @@
 #include <platform.h>
 
 #include "DynClass.hpp"
+#include "DynClassPool.hpp"
+#include "DynArena.hpp"
 #include "LoaderException.hpp"
+#include "LibRegistry.hpp"
+#include "EpochDomain.hpp"
+#include "DynStats.hpp"
+#include "DynStatsSegment.hpp"
+#include "DynAudit.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
-#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
 #include <windows.h>
@@ -126,77 +141,1403 @@ namespace DynLoader
 /* @brief DynLib forward declaration */
 struct DynLib;
 
+/* @brief DynClassEntry forward declaration */
+struct DynClassEntry;
+
+/* @brief WorkerPool forward declaration */
+class WorkerPool;
+
+/* @brief PluginCatalog forward declaration */
+class PluginCatalog;
+
+/* @brief Reclaimer forward declaration */
+class Reclaimer;
+
+/* @brief StatsPublisher forward declaration */
+class StatsPublisher;
+
+/* @brief PerfMap forward declaration */
+class PerfMap;
+
+/**
+ * @brief Runs a completion callback, e.g. by posting it to an event loop
+ */
+typedef std::function<void(std::function<void()>)> Executor;
+
+/**
+ * @brief Completion of an asynchronous instance request
+ * Receives the instance, or nullptr and the exception that occurred.
+ */
+typedef std::function<void(DynClass*, std::exception_ptr)> InstanceCallback;
+
+/**
+ * @brief Called before and after DynLoader::ForkWorker() forks
+ */
+typedef std::function<void(DynForkPhase)> ForkHandler;
+
+/**
+ * @brief Library and class lifecycle events, see DynLoader::AddListener()
+ */
+enum class DynEventType
+{
+	/* @brief A library was opened by the system loader */
+	Open,
+	/* @brief A library was closed */
+	Close,
+	/* @brief A symbol was looked up in a library */
+	Resolve,
+	/* @brief A shared class instance was constructed */
+	Create,
+	/* @brief A shared class instance was destroyed with its library */
+	Destroy
+};
+
+/**
+ * @brief Lifecycle event passed to listeners
+ * The strings are only valid during the call.
+ */
+struct DynEvent
+{
+	DynEventType type;
+	/* @brief Steady clock time the operation started */
+	std::chrono::steady_clock::time_point time;
+	std::chrono::nanoseconds duration;
+	/* @brief Library file name and namespace */
+	const DYN_CHAR* library;
+	DynNamespace space;
+	/* @brief Class or symbol name, nullptr for Open and Close */
+	const DYN_CHAR* name;
+	/* @brief Instance, symbol address or system library handle */
+	const void* object;
+	/* @brief The operation failed, e.g. the library could not be opened */
+	bool failed;
+
+	DynEvent(DynEventType type, std::chrono::steady_clock::time_point time, const DYN_CHAR* library,
+			DynNamespace space, const DYN_CHAR* name, const void* object, bool failed = false) :
+			type(type), time(time), duration(0), library(library), space(space), name(name),
+			object(object), failed(failed)
+	{
+	}
+};
+
+/**
+ * @brief Called for lifecycle events, see DynLoader::AddListener()
+ */
+typedef std::function<void(const DynEvent&)> EventListener;
+
+/**
+ * @class Factory DynLoader.hpp <DynLoader.hpp>
+ * @brief Resolved factory of a dynamically loaded class
+ *
+ * Holds the raw `Create` function of a class, so creating an instance is
+ * a single indirect call. Every call returns a new instance owned by the
+ * caller, which must release it with DynClass::Destroy(). A factory is
+ * only valid while its library stays loaded.
+ */
+template<typename Class>
+class Factory
+{
+private:
+	DynClassBuilder builder;
+
+public:
+	Factory() : builder(nullptr)
+	{
+	}
+
+	explicit Factory(DynClassBuilder builder) : builder(builder)
+	{
+	}
+
+	/**
+	 * @brief Create class instance
+	 * @return new class instance, nullptr if the constructor failed
+	 */
+	Class* operator()() const
+	{
+		return static_cast<Class*>(builder());
+	}
+
+	/**
+	 * @brief Check whether the factory has been resolved
+	 */
+	explicit operator bool() const
+	{
+		return builder != nullptr;
+	}
+
+}; // class Factory
+
+/**
+ * @class DynHandle DynLoader.hpp <DynLoader.hpp>
+ * @brief Counted reference to a class instance and its library
+ *
+ * The count is kept in the library, so copying a handle is a single atomic
+ * increment. A library is closed when its last handle drops, unless raw
+ * instances or factories of it were handed out; DynLoader::UnloadLib()
+ * closes it once the remaining handles drop. Handles must be released
+ * before their loader is destroyed.
+ */
+template<typename Class>
+class DynHandle
+{
+private:
+	Class* instance;
+	DynLib* lib;
+
+	friend class DynLoader;
+
+	DynHandle(Class* instance, DynLib* lib) : instance(instance), lib(lib)
+	{
+	}
+
+public:
+	DynHandle() : instance(nullptr), lib(nullptr)
+	{
+	}
+
+	DynHandle(const DynHandle& other);
+
+	DynHandle(DynHandle&& other) : instance(other.instance), lib(other.lib)
+	{
+		other.instance = nullptr;
+		other.lib = nullptr;
+	}
+
+	~DynHandle()
+	{
+		Reset();
+	}
+
+	DynHandle& operator=(DynHandle other)
+	{
+		std::swap(instance, other.instance);
+		std::swap(lib, other.lib);
+
+		return *this;
+	}
+
+	/**
+	 * @brief Drop the reference, closing the library if it was the last one
+	 */
+	void Reset();
+
+	/**
+	 * @brief Get class instance
+	 * @return class instance, nullptr for an empty handle
+	 */
+	Class* Get() const
+	{
+		return instance;
+	}
+
+	Class* operator->() const
+	{
+		return instance;
+	}
+
+	Class& operator*() const
+	{
+		return *instance;
+	}
+
+	/**
+	 * @brief Check whether the handle references an instance
+	 */
+	explicit operator bool() const
+	{
+		return instance != nullptr;
+	}
+
+}; // class DynHandle
+
+/**
+ * @brief Outcome of preloading a single library
+ */
+struct PreloadEntry
+{
+	dyn_string name;
+	bool loaded;
+	dyn_string error;
+	std::chrono::nanoseconds openTime;
+	/* @brief Classes prepared by DynLoader::WarmStart() */
+	size_t classes;
+	/* @brief The module's EXPORT_DYNMODULE_WARMUP function was called */
+	bool warmedUp;
+
+	PreloadEntry() : name(), loaded(false), error(), openTime(0), classes(0), warmedUp(false)
+	{
+	}
+};
+
+/**
+ * @brief Outcome of a bulk preload
+ */
+struct PreloadResult
+{
+	std::vector<PreloadEntry> libraries;
+	size_t loaded;
+	size_t failed;
+	std::chrono::nanoseconds elapsed;
+
+	PreloadResult() : libraries(), loaded(0), failed(0), elapsed(0)
+	{
+	}
+};
+
+/**
+ * @brief Counters of the background reclaimer
+ * Lag is the time a library waited in the queue, teardown the time it took
+ * to destroy its instances and close it.
+ */
+struct ReclaimStats
+{
+	size_t queued;
+	uint64_t reclaimed;
+	uint64_t overflows;
+	uint64_t failures;
+	std::chrono::nanoseconds totalLag;
+	std::chrono::nanoseconds maxLag;
+	std::chrono::nanoseconds totalTeardown;
+	std::chrono::nanoseconds maxTeardown;
+
+	ReclaimStats() : queued(0), reclaimed(0), overflows(0), failures(0),
+			totalLag(0), maxLag(0), totalTeardown(0), maxTeardown(0)
+	{
+	}
+};
+
+/**
+ * @brief Work done by DynLoader::PrepareFork()
+ */
+struct ForkPreparation
+{
+	size_t libraries;
+	/* @brief Function slots bound in lazily bound libraries */
+	size_t boundSymbols;
+	/* @brief Bytes of the loadable segments faulted in */
+	size_t touchedBytes;
+
+	ForkPreparation() : libraries(0), boundSymbols(0), touchedBytes(0)
+	{
+	}
+};
+
+/**
+ * @brief Symbol scope of an opened library
+ */
+enum class SymbolScope
+{
+	/* @brief Symbols are used to bind libraries opened later */
+	Global,
+	/* @brief Symbols are only visible through the library handle */
+	Local
+};
+
+/**
+ * @brief Time the function references of an opened library are bound
+ */
+enum class SymbolBinding
+{
+	/* @brief All references are bound while the library is opened */
+	Now,
+	/* @brief References are bound on their first call */
+	Lazy
+};
+
+/**
+ * @brief How the system loader opens a library
+ * The defaults open libraries in the global scope with all references
+ * bound, as earlier versions did.
+ */
+struct DynLoadOptions
+{
+	SymbolScope scope;
+	SymbolBinding binding;
+	/* @brief Prefer the library's own symbols and dependencies over global
+	 * ones, where supported */
+	bool deepBind;
+	/* @brief Keep the module mapped when the library is closed */
+	bool noDelete;
+	/* @brief With lazy binding, bind the remaining references on a loader
+	 * thread after opening */
+	bool bindInBackground;
+
+	DynLoadOptions() : scope(SymbolScope::Global), binding(SymbolBinding::Now), deepBind(false),
+			noDelete(false), bindInBackground(false)
+	{
+	}
+};
+
+/**
+ * @brief Memory use and activity of a loaded library
+ * Segment sizes are those of the module's loadable segments: executable
+ * ones count as text, the file backed part of the others as data and the
+ * rest as bss.
+ */
+struct LibraryUsage
+{
+	/* @brief Library file name and namespace it is loaded into */
+	dyn_string name;
+	DynNamespace space;
+	size_t textBytes;
+	size_t dataBytes;
+	size_t bssBytes;
+	size_t instances;
+	size_t handles;
+	size_t boundInBackground;
+	bool pinned;
+	std::chrono::nanoseconds idle;
+
+	LibraryUsage() : name(), space(0), textBytes(0), dataBytes(0), bssBytes(0), instances(0),
+			handles(0), boundInBackground(0), pinned(false), idle(0)
+	{
+	}
+};
+
+/**
+ * @brief Memory arenas installed into opened modules
+ * Classes are allocated from the arena, other plugin memory only when it
+ * goes through DynModuleAllocator.
+ */
+enum class ArenaMode
+{
+	/* @brief Modules allocate from the global heap */
+	Disabled,
+	/* @brief Every module gets an arena, kept until its memory is freed */
+	Tracked,
+	/* @brief Every module gets an arena, freed as a whole when the library
+	 * is closed. Only for modules whose objects do not outlive their library. */
+	ReleaseOnClose
+};
+
 /**
  * @class DynLoader DynLoader.hpp <DynLoader.hpp>
  * @brief Dynamic module and interface loader
+ *
+ * All methods are thread-safe. Lookups of loaded libraries and created
+ * instances read epoch protected snapshots and take no locks; opening
+ * libraries, creating instances and unloading go through writer paths.
  */
 class API_EXPORT DynLoader
 {
 private:
-	dyn_string lastError;
+	std::atomic<LibRegistry*> libs;
+
+	EpochDomain epoch;
+
+	std::mutex writeMutex;
+
+	/* @brief Opens in progress, keyed by requested name */
+	std::mutex openMutex;
+	std::unordered_map<DynLibKey, std::shared_future<DynLib*>, DynLibKeyHash> opening;
+
+	/* @brief Asynchronous instance request shared by concurrent callers */
+	struct AsyncLoad;
+
+	std::mutex asyncMutex;
+	std::unordered_map<dyn_string, std::shared_ptr<AsyncLoad> > asyncLoads;
+	std::unique_ptr<WorkerPool> asyncPool;
+
+	/* @brief Catalog of OpenCatalog(), lookups keep their own reference
+	 * since they stat and rescan library files */
+	std::mutex catalogMutex;
+	std::shared_ptr<PluginCatalog> catalog;
+
+	std::atomic<ArenaMode> arenaMode;
+
+	/* @brief Arenas of closed libraries that still had live memory */
+	std::mutex arenaMutex;
+	std::vector<DynArena*> retiredArenas;
+
+	/* @brief Libraries unlinked while raw pointers were handed out, guarded
+	 * by writeMutex */
+	std::vector<DynLib*> detached;
+
+	/* @brief Background teardown of unloaded libraries, created once */
+	std::atomic<Reclaimer*> reclaimer;
+
+	/* @brief Libraries the system loader failed to close */
+	std::atomic<uint64_t> closeFailures;
+
+	/* @brief Mapped size of registered libraries and its limit */
+	std::atomic<size_t> mappedBytes;
+	std::atomic<size_t> memoryBudget;
+	std::atomic<bool> evictionPending;
+
+	/* @brief Load options of libraries opened from now on */
+	std::mutex optionsMutex;
+	DynLoadOptions loadOptions;
+	std::unordered_map<dyn_string, DynLoadOptions> libraryOptions;
+
+	/* @brief Class used while profiling, see SetProfiling() */
+	struct ProfileRecord
+	{
+		dyn_string libName;
+		dyn_string className;
+		/* @brief The shared instance was created, not only the factory used */
+		bool instantiated;
+
+		ProfileRecord(const dyn_string& libName, const dyn_string& className, bool instantiated) :
+				libName(libName), className(className), instantiated(instantiated)
+		{
+		}
+	};
+
+	/* @brief Classes in order of first use while profiling */
+	std::atomic<bool> profiling;
+	std::mutex profileMutex;
+	std::vector<ProfileRecord> profile;
+
+	/* @brief Handlers registered with AddForkHandler() */
+	std::mutex forkMutex;
+	std::vector<ForkHandler> forkHandlers;
+
+	/* @brief One module kept open per namespace, see CreateNamespace() */
+	std::mutex namespaceMutex;
+	std::vector<DYN_HANDLE> namespaces;
+
+	/* @brief Latency histograms, see GetStats() */
+	DynStatsCollector stats;
+
+	/* @brief Worker updating the stats segment, see PublishStats() */
+	std::mutex publisherMutex;
+	StatsPublisher* publisher;
+
+	/* @brief Listeners registered with AddListener() and their ids */
+	typedef std::vector<std::pair<size_t, EventListener> > ListenerList;
+
+	/* @brief Copy on write, nullptr while no listener is registered */
+	std::atomic<ListenerList*> listeners;
+	std::mutex listenerMutex;
+	size_t nextListener;
+
+	/* @brief Code records for samplers, see EnablePerfMap() */
+	std::mutex perfMapMutex;
+	PerfMap* perfMap;
+
+	friend struct DynLib;
+
+	template<typename Class>
+	friend class DynHandle;
+
+	/**
+	 * @brief Open library
+	 * @param space - [in] namespace
+	 * @param libName - [in] library file name
+	 * @return true - loaded successfully, false otherwise
+	 * Caller must hold an epoch guard. Concurrent calls for the same name
+	 * wait for a single open.
+	 */
+	DynLib* OpenLib(DynNamespace space, const dyn_string& libName);
+
+	/**
+	 * @brief Open library and register it, called once per in-flight name
+	 * @param space - [in] namespace
+	 * @param libName - [in] library file name
+	 * @return pointer to dynamic library
+	 */
+	DynLib* OpenNewLib(DynNamespace space, const dyn_string& libName);
+
+	/**
+	 * @brief Get the options a library is opened with
+	 * @param libName - [in] library file name
+	 * @return load options
+	 */
+	DynLoadOptions GetLoadOptions(const dyn_string& libName);
+
+	/**
+	 * @brief Record the first use of a class while profiling
+	 * @param lib - [in] library of the class
+	 * @param entry - [in] class entry
+	 * @param instantiated - [in] the shared instance was created
+	 */
+	void RecordProfile(const DynLib& lib, DynClassEntry& entry, bool instantiated);
+
+	/**
+	 * @brief Get the system loader's id of a namespace
+	 * @param space - [in] namespace
+	 * @return link-map list id, 0 for the base namespace
+	 */
+	long GetLinkMap(DynNamespace space);
+
+	/**
+	 * @brief Run a task on a loader thread
+	 * @param task - [in] task, must not throw
+	 */
+	void RunInBackground(std::function<void()> task);
+
+	/**
+	 * @brief Bind the remaining references of a lazily bound library
+	 * @param lib - [in] registered library
+	 */
+	void ScheduleBinding(DynLib& lib);
+
+	/**
+	 * @brief Register an opened library unless its module is already known
+	 * @param libName - [in] library file name
+	 * @param opened - [in] opened library, released if registered
+	 * @return registered library
+	 */
+	DynLib* PublishLib(const dyn_string& libName, std::unique_ptr<DynLib>& opened);
+
+	/**
+	 * @brief Open the current file of a library under a distinct name
+	 * @param space - [in] namespace
+	 * @param libName - [in] library file name
+	 * @return opened library, not registered yet
+	 */
+	std::unique_ptr<DynLib> OpenReplacement(DynNamespace space, const dyn_string& libName);
+
+	/**
+	 * @brief Index all classes listed by a module's class list
+	 * @param lib - [in] library that has not been published yet
+	 * Modules without a class list are resolved class by class.
+	 */
+	void IndexClasses(DynLib& lib);
+
+	/**
+	 * @brief Install an arena into a module exporting the allocator hook
+	 * @param lib - [in] library that has not been published yet
+	 */
+	void InstallArena(DynLib& lib);
+
+	/**
+	 * @brief Dispose of the arena of a closed library
+	 * @param arena - [in] arena no longer installed in its module
+	 * @param release - [in] free the arena even if memory is still live
+	 */
+	void RetireArena(DynArena* arena, bool release);
+
+	/**
+	 * @brief Find library without taking locks
+	 * @param space - [in] namespace
+	 * @param libName - [in] library file name
+	 * @return library, nullptr if not found
+	 * Caller must hold an epoch guard.
+	 */
+	DynLib* FindLib(DynNamespace space, const dyn_string& libName);
+
+	/**
+	 * @brief Replace the published registry, caller must hold writeMutex
+	 * @param next - [in] new registry snapshot
+	 */
+	void Publish(LibRegistry* next);
+
+	/**
+	 * @brief Remove a library from the registry, caller must hold writeMutex
+	 * @param lib - [in] registered library
+	 */
+	void Unlink(DynLib& lib);
+
+	/**
+	 * @brief Drop one reference of each library, closing those left unused
+	 * @param released - [in] libraries
+	 * Must not be called while holding an epoch guard.
+	 */
+	void DropReferences(const std::vector<DynLib*>& released);
+
+	/**
+	 * @brief Close unlinked idle libraries, keeping those pinned meanwhile
+	 * @param idle - [in] libraries unlinked for being idle
+	 * Must not be called while holding an epoch guard.
+	 */
+	void CloseIdle(const std::vector<DynLib*>& idle);
+
+	/**
+	 * @brief Evict idle libraries on a loader thread if over the budget
+	 */
+	void ScheduleEviction();
+
+	/**
+	 * @brief Tear down a library no reader can reach anymore
+	 * @param lib - [in] unused library
+	 */
+	void Dispose(DynLib* lib);
+
+	/**
+	 * @brief Close library once its handles are released
+	 * @param lib - [in] library already removed from the registry
+	 */
+	void CloseLib(DynLib& lib);
+
+	/**
+	 * @brief Release a handle reference
+	 * @param lib - [in] library referenced by the handle
+	 */
+	void ReleaseReference(DynLib* lib);
+
+	/**
+	 * @brief Open library, get class instance and reference the library
+	 * @param space - [in] namespace
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @param lib - [out] referenced library
+	 * @return pointer to DynClass instance
+	 */
+	DynClass* AcquireClassInstance(DynNamespace space, const dyn_string& libName, const dyn_string& className,
+			DynLib*& lib);
+
+	/**
+	 * @brief Get symbol by name
+	 * @param symbolName - [in] symbol name
+	 * @return pointer to symbol, nullptr if not found
+	 */
+	DYN_SYMBOL GetSymbolByName(DynLib& lib, const DYN_CHAR* symbolName);
+
+	/**
+	 * @brief Get a symbol defined by the module itself
+	 * @param lib - [in] library
+	 * @param symbolName - [in] symbol name
+	 * @return pointer to symbol, nullptr if not found or only defined by a
+	 * dependency of the module
+	 */
+	DYN_SYMBOL GetModuleSymbol(DynLib& lib, const DYN_CHAR* symbolName);
+
+	/**
+	 * @brief Finish the work of the loader's own threads and join them
+	 * The asynchronous request pool is started again on demand.
+	 */
+	void StopBackgroundThreads();
+
+	/**
+	 * @brief Start the threads stopped by StopBackgroundThreads() again
+	 * @param publish - [in] also start the stats publisher, which only
+	 * belongs to the process that created it
+	 */
+	void StartBackgroundThreads(bool publish);
+
+	/**
+	 * @brief Fill the data of a stats segment
+	 * @param data - [out] segment data
+	 */
+	void CollectSegment(DynSegmentData& data);
+
+	/**
+	 * @brief Get the start time of an operation reported to listeners
+	 * @return current time, or the clock's epoch while no listener is
+	 * registered
+	 */
+	std::chrono::steady_clock::time_point EventStart() const
+	{
+		return listeners.load(std::memory_order_relaxed) != nullptr ?
+				std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+	}
+
+	/**
+	 * @brief Pass an event to the listeners
+	 * @param event - [in] event, its duration is taken from its start
+	 * until now
+	 */
+	void Notify(DynEvent& event);
+
+	/**
+	 * @brief Destroy the shared instance of a class of an unloaded library
+	 * @param lib - [in] library being torn down
+	 * @param entry - [in] class entry with an instance
+	 */
+	void DestroyInstance(DynLib& lib, DynClassEntry& entry);
+
+	/**
+	 * @brief Close the system handle of a library being torn down
+	 * @param lib - [in] library
+	 * @return true on success
+	 */
+	bool CloseHandle(DynLib& lib);
+
+	/**
+	 * @brief Record the code of an opened library in the perf map
+	 * @param lib - [in] opened library
+	 * @param scanName - [in] file the symbols are read from, empty for
+	 * the path the system loader opened
+	 */
+	void RecordCode(const DynLib& lib, const dyn_string& scanName);
+
+	/**
+	 * @brief Record that a library closed its system handle
+	 * @param lib - [in] closed library
+	 */
+	void RecordUnload(const DynLib& lib);
+
+	/**
+	 * @brief Move the perf map to the files of a forked worker
+	 */
+	void ForkPerfMap();
+
+	/**
+	 * @brief Call the registered and the module fork handlers
+	 * @param phase - [in] fork phase
+	 */
+	void RunForkHandlers(DynForkPhase phase);
+
+	/**
+	 * @brief Get class instance
+	 * @param lib - [in] reference a DynLib instance
+	 * @param className - [in] class name
+	 * @return pointer to DynClass instance
+	 */
+	DynClass* GetClassInstance(DynLib& lib, const dyn_string& className);
+
+	/**
+	 * @brief Get class instance by identifier
+	 * @param lib - [in] reference a DynLib instance
+	 * @param classId - [in] class identifier
+	 * @return pointer to DynClass instance
+	 */
+	DynClass* GetClassInstance(DynLib& lib, const DynClassId& classId);
+
+	/**
+	 * @brief Get class entry, resolving its factory on first use
+	 * @param lib - [in] reference a DynLib instance
+	 * @param className - [in] class name
+	 * @return class entry
+	 * Caller must hold the library mutex.
+	 */
+	DynClassEntry& GetClassEntry(DynLib& lib, const dyn_string& className);
+
+	/**
+	 * @brief Get the shared instance of a class, constructing it once
+	 * @param lib - [in] library of the class
+	 * @param entry - [in] class entry
+	 * @return pointer to DynClass instance
+	 */
+	DynClass* GetEntryInstance(DynLib& lib, DynClassEntry& entry);
+
+	/**
+	 * @brief Open library and get class instance
+	 * @param space - [in] namespace
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @return pointer to DynClass instance
+	 */
+	DynClass* LoadClassInstance(DynNamespace space, const dyn_string& libName, const dyn_string& className);
+
+	/**
+	 * @brief Open library and get class instance by identifier
+	 * @param space - [in] namespace
+	 * @param libName - [in] library file name
+	 * @param classId - [in] class identifier
+	 * @return pointer to DynClass instance
+	 */
+	DynClass* LoadClassInstance(DynNamespace space, const dyn_string& libName, const DynClassId& classId);
+
+	/**
+	 * @brief Find the library of a class in the catalog and get class instance
+	 * @param className - [in] class name
+	 * @return pointer to DynClass instance
+	 */
+	DynClass* LoadCatalogClassInstance(const dyn_string& className);
+
+	/**
+	 * @brief Open library and get class factory function
+	 * @param space - [in] namespace
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @return factory function
+	 */
+	DynClassBuilder LoadClassBuilder(DynNamespace space, const dyn_string& libName, const dyn_string& className);
+
+	/**
+	 * @brief Find an existing class instance without taking locks
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @return pointer to DynClass instance, nullptr if not created yet
+	 */
+	DynClass* FindClassInstance(const dyn_string& libName, const dyn_string& className);
+
+	/**
+	 * @brief Get class instance without blocking the caller
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @param callback - [in] completion callback
+	 * @param executor - [in] runs the callback, empty to run it on the
+	 * loader thread that completed the request
+	 */
+	void LoadClassInstanceAsync(const dyn_string& libName, const dyn_string& className,
+			InstanceCallback callback, Executor executor);
+
+	/**
+	 * @brief Get class factory function
+	 * @param lib - [in] reference a DynLib instance
+	 * @param className - [in] class name
+	 * @return factory function, resolved once per library
+	 */
+	DynClassBuilder GetClassBuilder(DynLib& lib, const dyn_string& className);
+
+public:
+
+	/**
+	 * @brief Get an already loaded library
+	 * @param libName - [in] library file name
+	 * @return library, nullptr if not loaded
+	 */
+	DynLib* GetLoadedLibrary(const dyn_string& libName)
+	{
+		return GetLoadedLibrary(0, libName);
+	}
+
+	/**
+	 * @brief Get an already loaded library of a namespace
+	 * @param space - [in] namespace, see CreateNamespace()
+	 * @param libName - [in] library file name
+	 * @return library, nullptr if not loaded
+	 */
+	DynLib* GetLoadedLibrary(DynNamespace space, const dyn_string& libName);
+
+	/* @brief Disable copy and default constructors */
+	DynLoader(const DynLoader&) = delete;
+	DynLoader& operator=(const DynLoader&) = delete;
+
+	/**
+	 * @brief Default constructor and destructor
+	 */
+	DynLoader();
+	~DynLoader();
+
+	/**
+	 * @brief Create class instance
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @return class instance, 0 if failed
+	 * Class must be derived from DynClass
+	 */
+	template<typename Class>
+	Class* GetClassInstance(const dyn_string& libName, const dyn_string& className)
+	{
+		return static_cast<Class*>(LoadClassInstance(0, libName, className));
+	}
+
+	/**
+	 * @brief Create class instance from a library copy in a namespace
+	 * @param space - [in] namespace, see CreateNamespace()
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @return class instance
+	 * Class must be derived from DynClass
+	 */
+	template<typename Class>
+	Class* GetClassInstance(DynNamespace space, const dyn_string& libName, const dyn_string& className)
+	{
+		return static_cast<Class*>(LoadClassInstance(space, libName, className));
+	}
+
+	/**
+	 * @brief Create class instance by compile time class identifier
+	 * @param libName - [in] library file name
+	 * @param classId - [in] class identifier, e.g. DYN_CLASS_ID("Name") or "Name"_cls
+	 * @return class instance
+	 * Class must be derived from DynClass
+	 */
+	template<typename Class>
+	Class* GetClassInstance(const dyn_string& libName, const DynClassId& classId)
+	{
+		return static_cast<Class*>(LoadClassInstance(0, libName, classId));
+	}
 
-	std::list<DynLib*> libs;
+	/**
+	 * @brief Create class instance by identifier from a library copy in a namespace
+	 * @param space - [in] namespace, see CreateNamespace()
+	 * @param libName - [in] library file name
+	 * @param classId - [in] class identifier
+	 * @return class instance
+	 * Class must be derived from DynClass
+	 */
+	template<typename Class>
+	Class* GetClassInstance(DynNamespace space, const dyn_string& libName, const DynClassId& classId)
+	{
+		return static_cast<Class*>(LoadClassInstance(space, libName, classId));
+	}
 
 	/**
-	 * @brief Open library
+	 * @brief Create class instance from the library the catalog lists for it
+	 * @param className - [in] class name
+	 * @return class instance
+	 * A catalog must have been opened with OpenCatalog().
+	 * Class must be derived from DynClass
+	 */
+	template<typename Class>
+	Class* GetClassInstance(const dyn_string& className)
+	{
+		return static_cast<Class*>(LoadCatalogClassInstance(className));
+	}
+
+	/**
+	 * @brief Get a counted handle to a class instance
 	 * @param libName - [in] library file name
-	 * @return true - loaded successfully, false otherwise
+	 * @param className - [in] class name
+	 * @return handle keeping the library loaded
+	 * Class must be derived from DynClass
 	 */
-	DynLib* OpenLib(const dyn_string& libName, bool resolveSymbols = true);
+	template<typename Class>
+	DynHandle<Class> GetClassHandle(const dyn_string& libName, const dyn_string& className)
+	{
+		return GetClassHandle<Class>(0, libName, className);
+	}
 
 	/**
-	 * @brief Close library
-	 * @param lib - [in] reference to dynamic library instance
+	 * @brief Get a counted handle to a class instance of a namespace
+	 * @param space - [in] namespace, see CreateNamespace()
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @return handle keeping the library loaded
+	 * Class must be derived from DynClass
 	 */
-	void CloseLib(DynLib& lib);
+	template<typename Class>
+	DynHandle<Class> GetClassHandle(DynNamespace space, const dyn_string& libName, const dyn_string& className)
+	{
+		DynLib* lib = nullptr;
+		DynClass* instance = AcquireClassInstance(space, libName, className, lib);
+
+		return DynHandle<Class>(static_cast<Class*>(instance), lib);
+	}
 
 	/**
-	 * @brief Get symbol by name
-	 * @param symbolName - [in] symbol name
-	 * @return pointer to symbol, nullptr if not found
+	 * @brief Unload a single library
+	 * @param libName - [in] library file name
+	 * @return false if the library is not loaded
+	 *
+	 * The library can no longer be found once this returns. It is closed
+	 * right away, or when the last of its handles is released.
 	 */
-	DYN_SYMBOL GetSymbolByName(DynLib& lib, const DYN_CHAR* symbolName);
+	bool UnloadLib(const dyn_string& libName)
+	{
+		return UnloadLib(0, libName);
+	}
 
 	/**
-	 * @brief Get class instance
-	 * @param lib - [in] reference a DynLib instance
+	 * @brief Unload a library copy of a namespace
+	 * @param space - [in] namespace, see CreateNamespace()
+	 * @param libName - [in] library file name
+	 * @return false if the library is not loaded
+	 */
+	bool UnloadLib(DynNamespace space, const dyn_string& libName);
+
+	/**
+	 * @brief Tear down unloaded libraries on a background thread
+	 * @param queueLimit - [in] maximum number of libraries waiting for
+	 * teardown, further ones are torn down by the releasing thread
+	 *
+	 * Instances of such libraries are destroyed and the libraries closed on
+	 * the reclaim thread. Cannot be disabled again, calling it once more
+	 * only changes the queue limit.
+	 */
+	void EnableBackgroundReclaim(size_t queueLimit = 64);
+
+	/**
+	 * @brief Wait until all unloaded libraries have been torn down
+	 */
+	void FlushReclaim();
+
+	/**
+	 * @brief Get the counters of the background reclaimer
+	 * @return counters, all zero if background reclaim is disabled
+	 */
+	ReclaimStats GetReclaimStats();
+
+	/**
+	 * @brief Get the number of libraries the system loader failed to close
+	 * @return failed closes, including those of the background reclaimer
+	 */
+	uint64_t GetCloseFailures() const;
+
+	/**
+	 * @brief Get the latency histograms of the loader operations
+	 * @return metrics snapshot, see DynStats::ToJson() and DynStats::ToText()
+	 */
+	DynStats GetStats();
+
+	/**
+	 * @brief Turn recording of the latency histograms on or off
+	 * @param on - [in] record latencies, on by default
+	 */
+	void SetStatsEnabled(bool on);
+
+	/**
+	 * @brief Publish the loader's state to a shared memory segment
+	 * @param segmentName - [in] shared memory object name, empty for
+	 * DynStatsSegment::DefaultName() of this process
+	 * @param interval - [in] time between updates
+	 * @return name of the published segment
+	 *
+	 * A worker thread copies the loaded libraries, their instance counts
+	 * and sizes, and the latency histograms into the segment, where tools
+	 * such as dynloader-top read them with DynStatsSegment. Replaces the
+	 * segment published before. Throws LoaderException if the segment
+	 * cannot be created.
+	 */
+	dyn_string PublishStats(const dyn_string& segmentName = dyn_string(),
+			std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+
+	/**
+	 * @brief Stop publishing and remove the stats segment
+	 */
+	void StopPublishingStats();
+
+	/**
+	 * @brief Set the options libraries are opened with
+	 * @param options - [in] load options of libraries without own options
+	 * Applies to libraries opened from now on.
+	 */
+	void SetLoadOptions(const DynLoadOptions& options);
+
+	/**
+	 * @brief Set the options a library is opened with
+	 * @param libName - [in] library file name
+	 * @param options - [in] load options
+	 * Applies the next time the library is opened.
+	 */
+	void SetLoadOptions(const dyn_string& libName, const DynLoadOptions& options);
+
+	/**
+	 * @brief Create a link-map namespace, e.g. for a tenant
+	 * @return namespace
+	 *
+	 * Libraries requested with the namespace, e.g. through
+	 * GetClassInstance(space, libName, className), are loaded into it with
+	 * their own copy of the module and its dependencies, including their
+	 * global state and locks. Only
+	 * supported with glibc, which allows 15 namespaces per process.
+	 * Namespaces live as long as the loader.
+	 */
+	DynNamespace CreateNamespace();
+
+	/**
+	 * @brief Load the current file of a library alongside the loaded one
+	 * @param libName - [in] library file name, as passed when it was loaded
+	 * @return false if the library is not loaded
+	 *
+	 * The new module replaces the old one in the registry in one step, so
+	 * requests from then on use its factories and instances. Handles keep
+	 * the old module loaded until they are released, raw instances of it
+	 * until Reset(). Throws if the new file cannot be loaded, the old
+	 * module stays in use then. Plugin files must be replaced by renaming a
+	 * new file over them, files modified in place cannot be reloaded.
+	 */
+	bool ReloadLib(const dyn_string& libName)
+	{
+		return ReloadLib(0, libName);
+	}
+
+	/**
+	 * @brief Load the current file of a library copy in a namespace
+	 * @param space - [in] namespace, see CreateNamespace()
+	 * @param libName - [in] library file name, as passed when it was loaded
+	 * @return false if the library is not loaded
+	 */
+	bool ReloadLib(DynNamespace space, const dyn_string& libName);
+
+	/**
+	 * @brief Keep idle libraries loaded within a memory budget
+	 * @param bytes - [in] mapped size of all libraries above which the
+	 * least recently used idle ones are unloaded, SIZE_MAX to never unload
+	 * them, 0 to close libraries as soon as their last handle is released
+	 *
+	 * Idle libraries are those without handles or constructed instances
+	 * whose raw instances or factories were never handed out. They are
+	 * opened again by the next request for one of their classes.
+	 */
+	void SetMemoryBudget(size_t bytes);
+
+	/**
+	 * @brief Unload least recently used idle libraries down to the budget
+	 * @return number of unloaded libraries
+	 * Runs on a loader thread by itself when the budget is exceeded.
+	 */
+	size_t EvictIdle();
+
+	/**
+	 * @brief Get memory use and activity of all loaded libraries
+	 * @return one entry per library
+	 */
+	std::vector<LibraryUsage> GetLibraryUsage();
+
+	/**
+	 * @brief Use a plugin catalog for lookups by class name
+	 * @param catalogFile - [in] catalog file built by PluginCatalog::Build()
+	 * @return false if the catalog could not be read, the current catalog
+	 * is kept in that case
+	 */
+	bool OpenCatalog(const dyn_string& catalogFile);
+
+	/**
+	 * @brief Get class instance without blocking the caller
+	 * @param libName - [in] library file name
 	 * @param className - [in] class name
-	 * @return pointer to DynClass instance
+	 * @return future of the class instance
+	 *
+	 * Opening the library and constructing the instance run on loader
+	 * threads. Concurrent requests for the same class share one load.
+	 * Class must be derived from DynClass
 	 */
-	DynClass* GetClassInstance(DynLib& lib, const dyn_string& className);
+	template<typename Class>
+	std::future<Class*> GetClassInstanceAsync(const dyn_string& libName, const dyn_string& className)
+	{
+		std::shared_ptr<std::promise<Class*> > promise(new std::promise<Class*>());
+		std::future<Class*> future = promise->get_future();
 
-public:
+		LoadClassInstanceAsync(libName, className,
+				[promise](DynClass* instance, std::exception_ptr error)
+				{
+					if(error)
+						promise->set_exception(error);
+					else
+						promise->set_value(static_cast<Class*>(instance));
+				},
+				Executor());
 
-	DynLib* GetLoadedLibrary(const dyn_string& libName);
+		return future;
+	}
 
-	/* @brief Disable copy and default constructors */
-	DynLoader(const DynLoader&) = delete;
-	DynLoader& operator=(const DynLoader&) = delete;
+	/**
+	 * @brief Get class instance without blocking the caller
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @param callback - [in] receives the instance, or nullptr and the error
+	 * @param executor - [in] runs the callback, empty to run it on a loader
+	 * thread. Already created instances complete through the executor
+	 * or, without one, immediately on the calling thread.
+	 * Class must be derived from DynClass
+	 */
+	template<typename Class>
+	void GetClassInstanceAsync(const dyn_string& libName, const dyn_string& className,
+			std::function<void(Class*, std::exception_ptr)> callback, Executor executor = Executor())
+	{
+		LoadClassInstanceAsync(libName, className,
+				[callback](DynClass* instance, std::exception_ptr error)
+				{
+					callback(static_cast<Class*>(instance), error);
+				},
+				executor);
+	}
 
 	/**
-	 * @brief Default constructor and destructor
+	 * @brief Get class factory
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @return factory creating new instances of the class
+	 * Class must be derived from DynClass
 	 */
-	DynLoader();
-	~DynLoader();
+	template<typename Class>
+	Factory<Class> GetFactory(const dyn_string& libName, const dyn_string& className)
+	{
+		return Factory<Class>(LoadClassBuilder(0, libName, className));
+	}
 
 	/**
-	 * @brief Create class instance
+	 * @brief Get class factory of a library copy in a namespace
+	 * @param space - [in] namespace, see CreateNamespace()
 	 * @param libName - [in] library file name
 	 * @param className - [in] class name
-	 * @return class instance, 0 if failed
+	 * @return factory creating new instances of the class
 	 * Class must be derived from DynClass
 	 */
 	template<typename Class>
-	Class* GetClassInstance(const dyn_string& libName, const dyn_string& className)
+	Factory<Class> GetFactory(DynNamespace space, const dyn_string& libName, const dyn_string& className)
+	{
+		return Factory<Class>(LoadClassBuilder(space, libName, className));
+	}
+
+	/**
+	 * @brief Create a new class instance
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @return new class instance owned by the caller, nullptr if failed
+	 * Class must be derived from DynClass. Use GetFactory() when creating
+	 * many instances of the same class.
+	 */
+	template<typename Class>
+	Class* CreateInstance(const dyn_string& libName, const dyn_string& className)
 	{
-		DynLib* lib = OpenLib(libName);
+		Factory<Class> factory = GetFactory<Class>(libName, className);
 
-		return lib ? static_cast<Class*>(GetClassInstance(*lib, className)) : nullptr;
+		return factory ? factory() : nullptr;
 	}
 
+	/**
+	 * @brief Get the description a module exports for a class
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @return class description, nullptr if the module has no class list.
+	 * The description is only valid while its library stays loaded.
+	 */
+	const DynClassInfo* GetClassInfo(const dyn_string& libName, const dyn_string& className);
+
+	/**
+	 * @brief Create a pool constructing instances in caller provided memory
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @param storage - [in] memory the instances are constructed in
+	 * @param bytes - [in] size of the memory, see DynClassPool::RequiredBytes()
+	 * @return pool, to be destroyed before the library is unloaded
+	 */
+	std::unique_ptr<DynClassPool> CreatePool(const dyn_string& libName, const dyn_string& className,
+			void* storage, size_t bytes);
+
+	/**
+	 * @brief Create a pool of instances in one contiguous allocation
+	 * @param libName - [in] library file name
+	 * @param className - [in] class name
+	 * @param capacity - [in] number of instances
+	 * @return pool, to be destroyed before the library is unloaded
+	 */
+	std::unique_ptr<DynClassPool> CreatePool(const dyn_string& libName, const dyn_string& className,
+			size_t capacity);
+
+	/**
+	 * @brief Select the arenas installed into modules opened from now on
+	 * @param mode - [in] arena mode
+	 */
+	void SetArenaMode(ArenaMode mode);
+
+	/**
+	 * @brief Get the memory usage of a library arena
+	 * @param libName - [in] library file name
+	 * @param stats - [out] arena usage
+	 * @return false if the library is not loaded or has no arena
+	 */
+	bool GetArenaStats(const dyn_string& libName, DynArenaStats& stats);
+
+	/**
+	 * @brief Load a set of libraries ahead of use
+	 * @param libNames - [in] library file names
+	 * @param workers - [in] number of loader threads, 0 for one per core
+	 * @return per library timings and errors
+	 *
+	 * Read-ahead is issued for all files first so their pages are fetched
+	 * in parallel, then the libraries are opened by a bounded pool of
+	 * threads. Failures are reported in the result, not thrown.
+	 */
+	PreloadResult Preload(const std::vector<dyn_string>& libNames, unsigned workers = 0);
+
+	/**
+	 * @brief Load all libraries of a directory ahead of use
+	 * @param directory - [in] plugin directory
+	 * @param suffix - [in] file name suffix of the libraries to load
+	 * @param workers - [in] number of loader threads, 0 for one per core
+	 * @return per library timings and errors
+	 */
+	PreloadResult PreloadDirectory(const dyn_string& directory,
+			const dyn_string& suffix = DYN_MODULE_SUFFIX, unsigned workers = 0);
+
+	/**
+	 * @brief Record which classes the process uses
+	 * @param enabled - [in] start or stop recording
+	 *
+	 * Libraries and classes are recorded in the order their shared
+	 * instance was first created or their factory first requested.
+	 * Recording again adds to the classes recorded before.
+	 */
+	void SetProfiling(bool enabled);
+
+	/**
+	 * @brief Write the recorded classes to a profile file
+	 * @param profileFile - [in] profile file name, replaced atomically
+	 * @return number of recorded classes
+	 *
+	 * Profile files are native to the byte order of the host that wrote
+	 * them.
+	 */
+	size_t SaveProfile(const dyn_string& profileFile);
+
+	/**
+	 * @brief Load and instantiate the classes of a profile ahead of use
+	 * @param profileFile - [in] profile file name
+	 * @param workers - [in] number of loader threads, 0 for one per core
+	 * @return per library timings and errors, empty if the profile is
+	 * missing or malformed
+	 *
+	 * Libraries are prepared in parallel, a library only after the
+	 * profiled libraries it links against. Each library's classes are
+	 * instantiated in profile order, then its EXPORT_DYNMODULE_WARMUP
+	 * function is called if it has one. Failures are reported in the
+	 * result, not thrown. Warmed libraries are pinned, they are never
+	 * evicted to stay within the memory budget.
+	 */
+	PreloadResult WarmStart(const dyn_string& profileFile, unsigned workers = 0);
+
+	/**
+	 * @brief Register a handler called around ForkWorker()
+	 * @param handler - [in] fork handler
+	 *
+	 * Prepare handlers run in reverse order of registration after the
+	 * modules' EXPORT_DYNMODULE_FORK functions, parent and child handlers
+	 * in order of registration before them.
+	 */
+	void AddForkHandler(ForkHandler handler);
+
+	/**
+	 * @brief Register a listener for library and class lifecycle events
+	 * @param listener - [in] listener
+	 * @return id to remove the listener with
+	 *
+	 * Listeners are called on the thread that performed the operation,
+	 * possibly the reclaimer thread for Destroy and Close, and must not
+	 * unload libraries or remove listeners. The operations take no
+	 * timestamps while no listener is registered.
+	 */
+	size_t AddListener(EventListener listener);
+
+	/**
+	 * @brief Remove a listener
+	 * @param id - [in] id returned by AddListener()
+	 * @return false if no listener has this id
+	 *
+	 * Waits until calls of the listener in progress have returned.
+	 */
+	bool RemoveListener(size_t id);
+
+	/**
+	 * @brief Record the code of the libraries for perf map readers
+	 * @param directory - [in] directory of the record files, readers look
+	 * for the map in /tmp
+	 * @return path of the perf map
+	 *
+	 * The functions of every loaded library and of the libraries loaded
+	 * later are appended to perf-<pid>.map, in the format read by tools
+	 * such as the bcc profilers, so their samples in libraries that were
+	 * closed or reloaded since can still be named. perf report itself only
+	 * reads the map for anonymous memory and symbolizes plugins from their
+	 * files. The executable segments are logged with CLOCK_MONOTONIC load
+	 * and unload times to dynloader-<pid>.log, which tells apart libraries
+	 * that were loaded at the same addresses over time. Replaces the
+	 * records enabled before. Throws LoaderException if a file cannot be
+	 * created.
+	 */
+	dyn_string EnablePerfMap(const dyn_string& directory = "/tmp");
+
+	/**
+	 * @brief Stop recording, the record files are kept for the samplers
+	 */
+	void DisablePerfMap();
+
+	/**
+	 * @brief Make the loaded libraries ready to be shared with forked workers
+	 * @return work done
+	 *
+	 * Binds the remaining function slots of lazily bound libraries and
+	 * faults in all loadable segments, so workers inherit them copy on
+	 * write instead of relocating and faulting them in again each. Load
+	 * and instantiate the classes workers use first, e.g. with
+	 * WarmStart(). The loader's own threads are stopped meanwhile.
+	 */
+	ForkPreparation PrepareFork();
+
+	/**
+	 * @brief Fork a worker process sharing the loaded libraries
+	 * @return process id of the worker in the parent, 0 in the worker
+	 *
+	 * Runs the fork handlers around fork(). Only the calling thread exists
+	 * in the worker, so no other thread may use the loader meanwhile and
+	 * threads such as those of a HotReloader have to be started in the
+	 * worker again. The loader's own threads are stopped before forking
+	 * and restarted in both processes.
+	 */
+	int ForkWorker();
+
 	/**
 	 * @brief Reset the dynamic loader
-	 * Frees all class instances and unloads all libraries
+	 * Frees all class instances and unloads all libraries. Libraries with
+	 * live handles are closed when their last handle is released.
 	 */
 	void Reset();
 
@@ -207,7 +1548,7 @@ public:
 	void Destroy();
 
 	/**
-	 * @brief Get last error description
+	 * @brief Get last error description of the calling thread
 	 * @return last error description
 	 */
 	const dyn_string& GetLastError();
@@ -216,73 +1557,242 @@ public:
 
 /**
  * @brief DynClassEntry structure 
- * We store the name here to keep it out of the client implementation
+ * We store the name here to keep it out of the client implementation.
+ * Each entry constructs its shared instance at most once: concurrent
+ * callers for the same class wait on the entry mutex while other classes
+ * are constructed in parallel.
  */
 struct DynClassEntry
 {
 	dyn_string name;
-	DynClass* instance;
+	DynClassBuilder builder;
+	const DynClassInfo* info;
+	std::atomic<DynClass*> instance;
+	std::mutex mutex;
+	/* @brief Uses already in the profile, see DynLoader::SetProfiling() */
+	std::atomic<unsigned> profiled;
 
-	DynClassEntry(const dyn_string& name, DynClass* instance) :
-			name(name), instance(instance)
+	DynClassEntry(const dyn_string& name, DynClassBuilder builder, const DynClassInfo* info = nullptr) :
+			name(name), builder(builder), info(info), instance(nullptr), mutex(), profiled(0)
 	{
 	}
+
+	DynClassEntry(const DynClassEntry&) = delete;
+	DynClassEntry& operator=(const DynClassEntry&) = delete;
 };
 
+/**
+ * @brief Class table of a library, replaced as a whole on insertion
+ * Keyed by DynClassHash() of the class name, names of one library with
+ * the same hash are rejected when inserted.
+ */
+typedef std::unordered_map<uint64_t, DynClassEntry*> DynClassTable;
+
 /* @brief DynLib structure */
 struct DynLib
 {
 	dyn_string name;
+	/* @brief File name passed to the system loader */
+	dyn_string file;
 	DYN_HANDLE handle;
-	std::list<DynClassEntry*> instances;
+	std::atomic<DynClassTable*> classes;
+	std::mutex mutex;
 	DynLoader& loader;
+	DynLibId id;
+	std::vector<dyn_string> aliases;
+	DynArena* arena;
+	DynModuleInstallAllocator installAllocator;
+	bool releaseArena;
 
-	DynLib(const dyn_string& libName, DynLoader& loader, bool resolveSymbols) :
-			name(libName), handle(nullptr), instances(), loader(loader)
+	/* @brief One reference of the registry while registered, one per handle */
+	std::atomic<size_t> refs;
+	/* @brief Raw instances or factories were handed out, only closed explicitly */
+	std::atomic<bool> pinned;
+	/* @brief Reachable through the registry, guarded by the loader's writeMutex */
+	bool registered;
+	/* @brief Sizes of the loadable segments */
+	size_t textBytes;
+	size_t dataBytes;
+	size_t bssBytes;
+	/* @brief Steady clock time of the last acquired or released handle */
+	std::atomic<int64_t> lastUse;
+	DynLoadOptions options;
+	/* @brief References bound after opening, see DynLoadOptions::bindInBackground */
+	std::atomic<size_t> boundInBackground;
+	DynNamespace space;
+	/* @brief Link-map list id of the namespace, 0 for the base namespace */
+	long linkMap;
+	/* @brief Descriptor the file was opened through, -1 if opened by name */
+	int descriptor;
+
+	DynLib(const dyn_string& libName, DynLoader& loader, const DynLoadOptions& options,
+			const dyn_string& fileName = dyn_string(), DynNamespace space = 0, long linkMap = 0) :
+			name(libName), file(fileName.empty() ? libName : fileName), handle(nullptr), classes(new DynClassTable()), mutex(),
+			loader(loader), id(), aliases(), arena(nullptr), installAllocator(nullptr),
+			releaseArena(false), refs(1), pinned(false), registered(false), textBytes(0),
+			dataBytes(0), bssBytes(0), lastUse(0), options(options), boundInBackground(0),
+			space(space), linkMap(linkMap), descriptor(-1)
 	{
-	
+		// Reuse the module if the process has already mapped it, either
+		// through another loader or as a dependency of the executable.
 		handle =
 #if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
-				::LoadLibraryExA(name.c_str(), nullptr, resolveSymbols ? (DWORD)0 : DONT_RESOLVE_DLL_REFERENCES);
+				::GetModuleHandleExA(0, file.c_str(), &handle) ? handle : nullptr;
+#elif PLATFORM_POSIX
+				Open(RTLD_NOLOAD | OpenFlags(options));
+#endif
+
+		if(handle == nullptr)
+		{
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+			handle = ::LoadLibraryExA(file.c_str(), nullptr,
+					options.binding == SymbolBinding::Now ? (DWORD)0 : DONT_RESOLVE_DLL_REFERENCES);
 #elif PLATFORM_POSIX
-				::dlopen(name.c_str(), RTLD_GLOBAL | (resolveSymbols ? RTLD_NOW : RTLD_LAZY));
+			// Bound to the phase timer of libdynloader-audit when running under it
+			DynAuditOpenStartV1(file.c_str());
+			handle = Open(OpenFlags(options));
+			DynAuditOpenDoneV1(file.c_str(), handle);
 #endif
+		}
 
 		if(handle == nullptr)
+		{
+			delete classes.exchange(nullptr);
 			throw LoaderException("Could not open `" + libName + "`");
+		}
 	}
 
 	~DynLib()
 	{
-	
-		for (auto entry : instances)
+		(void) Unload();
+	}
+
+	/**
+	 * @brief Destroy the instances and close the module
+	 * @return false if the system loader failed to close it
+	 *
+	 * Failures are counted by the loader, see DynLoader::GetCloseFailures().
+	 * Further calls do nothing.
+	 */
+	bool Unload()
+	{
+		DynClassTable* table = classes.exchange(nullptr);
+		if(table != nullptr)
 		{
-			entry->instance->Destroy();
-			delete entry;
+			for (auto& entry : *table)
+			{
+				if(entry.second->instance)
+					loader.DestroyInstance(*this, *entry.second);
+				delete entry.second;
+			}
+			delete table;
 		}
-		instances.clear();
+
+		// Memory allocated later goes to the global heap again
+		if(arena != nullptr)
+			installAllocator(arena, nullptr);
 
 		bool closeSuccess = true;
 		if(handle)
 		{
-			closeSuccess =
-#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
-					(::FreeLibrary(handle) != FALSE);
-#elif PLATFORM_POSIX
-					(::dlclose(handle) == 0);
-#endif
+			closeSuccess = loader.CloseHandle(*this);
 
-			if(!closeSuccess)
-				throw LoaderException("Unable to close library: Error `" + loader.GetLastError() + "`");
+			// The module stays mapped while another library object of it
+			// is pending teardown, and its objects may still free into the arena
+			if(arena != nullptr)
+				loader.RetireArena(arena, releaseArena && closeSuccess && !IsMapped());
 
+			arena = nullptr;
 			handle = nullptr;
 		}
+
+		return closeSuccess;
 	}
 	
+#if PLATFORM_POSIX
+	/**
+	 * @brief Get the system loader flags of load options
+	 * @param options - [in] load options
+	 * @return dlopen() mode
+	 */
+	static int OpenFlags(const DynLoadOptions& options)
+	{
+		int flags = options.scope == SymbolScope::Global ? RTLD_GLOBAL : RTLD_LOCAL;
+		flags |= options.binding == SymbolBinding::Now ? RTLD_NOW : RTLD_LAZY;
+#ifdef RTLD_DEEPBIND
+		if(options.deepBind)
+			flags |= RTLD_DEEPBIND;
+#endif
+		if(options.noDelete)
+			flags |= RTLD_NODELETE;
+
+		return flags;
+	}
+
+	/**
+	 * @brief Open the module in the library's namespace
+	 * @param flags - [in] dlopen() mode
+	 * @return system library handle, nullptr on failure
+	 */
+	DYN_HANDLE Open(int flags) const
+	{
+#ifdef LM_ID_NEWLM
+		// Other namespaces have no global scope to add the module to
+		if(linkMap != LM_ID_BASE)
+			return ::dlmopen(linkMap, file.c_str(), flags & ~RTLD_GLOBAL);
+#endif
+		return ::dlopen(file.c_str(), flags);
+	}
+#endif
+
+	/**
+	 * @brief Check whether the module is still mapped by the process
+	 */
+	bool IsMapped() const
+	{
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+		HMODULE mapped = nullptr;
+		return ::GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, file.c_str(), &mapped) != FALSE;
+#elif PLATFORM_POSIX
+		DYN_HANDLE mapped = Open(RTLD_NOLOAD | RTLD_LAZY);
+		if(mapped != nullptr)
+			::dlclose(mapped);
+
+		return mapped != nullptr;
+#endif
+	}
+
+	/**
+	 * @brief Get the mapped size of the library
+	 */
+	size_t MappedBytes() const
+	{
+		return textBytes + dataBytes + bssBytes;
+	}
+
 	DynLib(const DynLib& lib);
 	const DynLib& operator=(const DynLib& lib);
 };
 
+template<typename Class>
+DynHandle<Class>::DynHandle(const DynHandle& other) : instance(other.instance), lib(other.lib)
+{
+	if(lib != nullptr)
+		lib->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename Class>
+void DynHandle<Class>::Reset()
+{
+	DynLib* released = lib;
+
+	instance = nullptr;
+	lib = nullptr;
+
+	if(released != nullptr)
+		released->loader.ReleaseReference(released);
+}
+
 } // namespace DynLoader
 
 #endif // __DYNLOADER_HPP__
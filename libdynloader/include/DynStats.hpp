@@ -0,0 +1,329 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __DYNSTATS_HPP__
+#define __DYNSTATS_HPP__
+
+#include <platform.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @brief Loader operations with a latency histogram
+ */
+enum class DynMetric
+{
+	/* @brief System loader call opening a library */
+	Open,
+	/* @brief Symbol lookup in a library */
+	Symbol,
+	/* @brief Instance request served by an existing instance */
+	InstanceHit,
+	/* @brief Instance request that resolved or constructed the class */
+	InstanceMiss,
+	/* @brief Factory call constructing an instance */
+	Construct,
+	/* @brief Destruction of an instance of an unloaded library */
+	Destroy,
+	/* @brief System loader call closing a library */
+	Close
+};
+
+/* @brief Number of DynMetric values */
+const size_t DynMetricCount = 7;
+
+/**
+ * @brief Latency histogram with power of two buckets
+ * Bucket i counts durations in [2^i, 2^(i+1)) nanoseconds, the last
+ * bucket also counts all longer ones. Frequent operations are only timed
+ * now and then: count has every operation, the buckets, total and max
+ * only the timed samples.
+ */
+struct API_EXPORT DynHistogram
+{
+	static const size_t Buckets = 40;
+
+	uint64_t count;
+	uint64_t samples;
+	std::chrono::nanoseconds total;
+	std::chrono::nanoseconds max;
+	uint64_t buckets[Buckets];
+
+	DynHistogram();
+
+	/**
+	 * @brief Get the bucket of a duration
+	 * @param duration - [in] duration
+	 * @return bucket index
+	 */
+	static size_t Bucket(std::chrono::nanoseconds duration);
+
+	/**
+	 * @brief Get the mean duration of the samples
+	 * @return mean duration, zero if empty
+	 */
+	std::chrono::nanoseconds Mean() const;
+
+	/**
+	 * @brief Get an upper bound of a percentile
+	 * @param percent - [in] percentile, between 0 and 100
+	 * @return upper bound of the bucket holding the percentile, at most
+	 * the maximum, zero if empty
+	 */
+	std::chrono::nanoseconds Percentile(double percent) const;
+};
+
+/**
+ * @brief Snapshot of the loader metrics
+ */
+struct API_EXPORT DynStats
+{
+	DynHistogram metrics[DynMetricCount];
+	/* @brief Threads that recorded metrics */
+	size_t threads;
+
+	DynStats();
+
+	const DynHistogram& operator[](DynMetric metric) const
+	{
+		return metrics[static_cast<size_t>(metric)];
+	}
+
+	/**
+	 * @brief Get the name of a metric used by the dumps
+	 * @param metric - [in] metric
+	 * @return metric name
+	 */
+	static const char* MetricName(DynMetric metric);
+
+	/**
+	 * @brief Dump as a JSON object, one member per metric
+	 * @return JSON text
+	 */
+	dyn_string ToJson() const;
+
+	/**
+	 * @brief Dump as a table, one line per metric
+	 * @return text
+	 */
+	dyn_string ToText() const;
+};
+
+/**
+ * @class DynStatsCollector DynStats.hpp <DynStats.hpp>
+ * @brief Per-thread latency histograms aggregated on read
+ *
+ * Each thread records into its own shard without atomic read-modify-write
+ * operations or shared cache lines. Snapshot() adds up the shards, it may
+ * miss records made while it runs.
+ */
+class API_EXPORT DynStatsCollector
+{
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	/* @brief Histograms of one thread, only written by that thread */
+	struct Shard
+	{
+		struct Histogram
+		{
+			std::atomic<uint64_t> count;
+			std::atomic<uint64_t> samples;
+			std::atomic<uint64_t> total;
+			std::atomic<uint64_t> max;
+			std::atomic<uint64_t> buckets[DynHistogram::Buckets];
+
+			Histogram() : count(0), samples(0), total(0), max(0), buckets()
+			{
+			}
+		};
+
+		Histogram metrics[DynMetricCount];
+		/* @brief Operations seen by Sample() */
+		unsigned ticks;
+		std::thread::id owner;
+		Shard* next;
+		char padding[64];
+
+		Shard() : metrics(), ticks(0), owner(std::this_thread::get_id()), next(nullptr), padding()
+		{
+		}
+	};
+
+	/* @brief One in this many instance hits is timed */
+	static const unsigned SampleInterval = 64;
+
+	std::atomic<bool> enabled;
+	std::atomic<Shard*> shards;
+	const uint64_t serial;
+
+	/**
+	 * @brief Get the shard of the calling thread
+	 */
+	Shard* LocalShard();
+
+	/**
+	 * @brief Check if an operation is timed or only counted
+	 * @param shard - [in] shard of the calling thread
+	 * @param metric - [in] metric
+	 * @return true if the operation is timed
+	 *
+	 * Instance hits take less time than reading the clock twice, only one
+	 * in SampleInterval of them is timed.
+	 */
+	static bool Sample(Shard& shard, DynMetric metric)
+	{
+		return metric != DynMetric::InstanceHit || shard.ticks++ % SampleInterval == 0;
+	}
+
+	/**
+	 * @brief Count an operation that is not timed
+	 * @param shard - [in] shard of the calling thread
+	 * @param metric - [in] metric
+	 *
+	 * Only the owning thread writes a shard, plain loads and stores suffice.
+	 */
+	static void Count(Shard& shard, DynMetric metric)
+	{
+		std::atomic<uint64_t>& count = shard.metrics[static_cast<size_t>(metric)].count;
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Record a duration
+	 * @param shard - [in] shard of the calling thread
+	 * @param metric - [in] metric
+	 * @param duration - [in] duration
+	 */
+	static void Record(Shard& shard, DynMetric metric, std::chrono::nanoseconds duration);
+
+public:
+	/**
+	 * @class Timer
+	 * @brief Records the time from its construction to its destruction
+	 */
+	class Timer
+	{
+	private:
+		DynMetric metric;
+		/* @brief Shard of the calling thread, nullptr if not recording */
+		Shard* shard;
+		Clock::time_point start;
+
+	public:
+		Timer(DynStatsCollector& collector, DynMetric metric) :
+				metric(metric), shard(collector.Enabled() ? collector.LocalShard() : nullptr),
+				start(shard != nullptr && Sample(*shard, metric) ? Clock::now() : Clock::time_point())
+		{
+		}
+
+		~Timer()
+		{
+			if(shard == nullptr)
+				return;
+
+			if(start != Clock::time_point())
+				Record(*shard, metric, Clock::now() - start);
+			else
+				Count(*shard, metric);
+		}
+
+		/**
+		 * @brief Change the metric recorded
+		 * @param metric - [in] metric
+		 * An operation that was not timed is timed from here on if the new
+		 * metric is.
+		 */
+		void SetMetric(DynMetric metric)
+		{
+			this->metric = metric;
+			if(shard != nullptr && start == Clock::time_point() && Sample(*shard, metric))
+				start = Clock::now();
+		}
+
+		/**
+		 * @brief Record nothing
+		 */
+		void Cancel()
+		{
+			shard = nullptr;
+		}
+
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+	};
+
+	DynStatsCollector();
+	~DynStatsCollector();
+
+	/* @brief Disable copy constructors */
+	DynStatsCollector(const DynStatsCollector&) = delete;
+	DynStatsCollector& operator=(const DynStatsCollector&) = delete;
+
+	/**
+	 * @brief Check if durations are recorded
+	 */
+	bool Enabled() const
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Turn recording on or off
+	 * @param on - [in] record durations
+	 */
+	void SetEnabled(bool on);
+
+	/**
+	 * @brief Record a duration
+	 * @param metric - [in] metric
+	 * @param duration - [in] duration
+	 */
+	void Record(DynMetric metric, std::chrono::nanoseconds duration);
+
+	/**
+	 * @brief Add up the histograms of all threads
+	 * @return metrics snapshot
+	 */
+	DynStats Snapshot() const;
+
+}; // class DynStatsCollector
+
+} // namespace DynLoader
+
+#endif // __DYNSTATS_HPP__
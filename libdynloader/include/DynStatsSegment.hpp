@@ -0,0 +1,190 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __DYNSTATSSEGMENT_HPP__
+#define __DYNSTATSSEGMENT_HPP__
+
+#include <platform.h>
+
+#include "DynStats.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/* @brief Libraries listed in a stats segment, further ones are dropped */
+const size_t DynSegmentLibraries = 256;
+/* @brief Size of a library name in a stats segment, including the terminator */
+const size_t DynSegmentNameLength = 128;
+
+/**
+ * @brief Library of a stats segment, see LibraryUsage
+ */
+struct DynSegmentLibrary
+{
+	char name[DynSegmentNameLength];
+	uint32_t space;
+	uint32_t pinned;
+	uint64_t instances;
+	uint64_t handles;
+	uint64_t textBytes;
+	uint64_t dataBytes;
+	uint64_t bssBytes;
+	uint64_t idleNs;
+};
+
+/**
+ * @brief Latency histogram summary of a stats segment, see DynHistogram
+ */
+struct DynSegmentMetric
+{
+	uint64_t count;
+	uint64_t samples;
+	uint64_t totalNs;
+	uint64_t maxNs;
+	uint64_t p50Ns;
+	uint64_t p99Ns;
+};
+
+/**
+ * @brief Contents of a stats segment
+ * Only fixed size fields, the segment is read by other processes and
+ * other builds.
+ */
+struct DynSegmentData
+{
+	uint64_t pid;
+	/* @brief System clock time of the last update in nanoseconds */
+	uint64_t updatedNs;
+	uint64_t updates;
+	uint64_t mappedBytes;
+	uint64_t memoryBudget;
+	uint64_t libraryCount;
+	/* @brief Loaded libraries beyond DynSegmentLibraries */
+	uint64_t librariesDropped;
+	DynSegmentMetric metrics[DynMetricCount];
+	DynSegmentLibrary libraries[DynSegmentLibraries];
+};
+
+/**
+ * @brief Layout of a stats segment
+ * The sequence is odd while the data is written, see DynStatsSegment.
+ */
+struct DynSegmentLayout
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t size;
+	std::atomic<uint64_t> sequence;
+	DynSegmentData data;
+};
+
+/**
+ * @brief Side of a stats segment a process is on
+ */
+enum class DynSegmentAccess
+{
+	/* @brief Create the segment and write it */
+	Publish,
+	/* @brief Map an existing segment read-only */
+	Read
+};
+
+/**
+ * @class DynStatsSegment DynStatsSegment.hpp <DynStatsSegment.hpp>
+ * @brief Named shared memory segment holding a loader's state
+ *
+ * A single writer updates the segment under a sequence lock: readers copy
+ * the data and retry if the sequence changed or was odd meanwhile. Readers
+ * never block the writer and take no locks.
+ */
+class API_EXPORT DynStatsSegment
+{
+private:
+	DynSegmentLayout* layout;
+	dyn_string name;
+	DynSegmentAccess access;
+	/* @brief Process that created the segment and removes it */
+	long creator;
+
+public:
+	/**
+	 * @brief Create or map a segment
+	 * @param name - [in] shared memory object name, see DefaultName()
+	 * @param access - [in] create the segment or map an existing one
+	 * Throws LoaderException if the segment cannot be created or is not a
+	 * stats segment of this version.
+	 */
+	DynStatsSegment(const dyn_string& name, DynSegmentAccess access);
+
+	/**
+	 * @brief Unmap the segment, the creating process also removes it
+	 */
+	~DynStatsSegment();
+
+	/* @brief Disable copy constructors */
+	DynStatsSegment(const DynStatsSegment&) = delete;
+	DynStatsSegment& operator=(const DynStatsSegment&) = delete;
+
+	/**
+	 * @brief Get the segment name a process publishes to by default
+	 * @param pid - [in] process id
+	 * @return shared memory object name
+	 */
+	static dyn_string DefaultName(long pid);
+
+	/**
+	 * @brief Get the shared memory object name
+	 */
+	const dyn_string& Name() const { return name; }
+
+	/**
+	 * @brief Replace the data of a published segment
+	 * @param data - [in] new contents
+	 */
+	void Write(const DynSegmentData& data);
+
+	/**
+	 * @brief Copy a consistent version of the data
+	 * @param data - [out] contents
+	 * @param retries - [in] attempts while the writer is busy
+	 * @return false if every attempt overlapped an update
+	 */
+	bool Read(DynSegmentData& data, unsigned retries = 1000) const;
+
+}; // class DynStatsSegment
+
+} // namespace DynLoader
+
+#endif // __DYNSTATSSEGMENT_HPP__
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ELFSCANNER_HPP__
+#define __ELFSCANNER_HPP__
+
+#include <platform.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/* @brief Class name to library file map */
+typedef std::unordered_map<dyn_string, dyn_string> ClassLibraryMap;
+
+/**
+ * @class ElfScanner ElfScanner.hpp <ElfScanner.hpp>
+ * @brief Lists the classes a module exports without loading it
+ *
+ * The module file is mapped read-only and the classes are taken from the
+ * Create<Name> factories EXPORT_DYNCLASS puts into the dynamic symbol
+ * table, so no initializers or relocations of the module are run. Only
+ * ELF modules matching the byte order and word size of the host can be
+ * scanned.
+ */
+class API_EXPORT ElfScanner
+{
+public:
+	/**
+	 * @brief Called for every exported class
+	 * @param className - [in] class name, not null terminated, points
+	 * into the mapped file and is only valid during the call
+	 * @param length - [in] length of the class name
+	 */
+	typedef std::function<void(const char* className, size_t length)> ExportVisitor;
+
+	/**
+	 * @brief Called for every function a module defines
+	 * @param name - [in] symbol name, not null terminated, points into the
+	 * mapped file and is only valid during the call
+	 * @param length - [in] length of the symbol name
+	 * @param address - [in] address of the function relative to the load base
+	 * @param size - [in] size of the function code
+	 */
+	typedef std::function<void(const char* name, size_t length, uint64_t address, uint64_t size)> FunctionVisitor;
+
+	/**
+	 * @brief Visit the classes exported by a module
+	 * @param libName - [in] library file name
+	 * @param visitor - [in] callback for every exported class
+	 * @return false if the file could not be read or is not a loadable ELF module
+	 */
+	static bool ScanExports(const dyn_string& libName, const ExportVisitor& visitor);
+
+	/**
+	 * @brief Get the classes exported by a module
+	 * @param libName - [in] library file name
+	 * @param classNames - [out] exported class names are appended
+	 * @return false if the file could not be read or is not a loadable ELF module
+	 */
+	static bool ScanLibrary(const dyn_string& libName, std::vector<dyn_string>& classNames);
+
+	/**
+	 * @brief Get the libraries a module depends on
+	 * @param libName - [in] library file name
+	 * @param needed - [out] names of the needed libraries are appended, as
+	 * recorded in the module
+	 * @param soname - [out] soname of the module, empty if it has none
+	 * @return false if the file could not be read or is not a loadable ELF module
+	 */
+	static bool ScanDependencies(const dyn_string& libName, std::vector<dyn_string>& needed, dyn_string& soname);
+
+	/**
+	 * @brief Visit the functions defined by a module
+	 * @param libName - [in] library file name
+	 * @param visitor - [in] callback for every function, taken from the
+	 * full symbol table unless the module was stripped
+	 * @return false if the file could not be read or has no symbol table
+	 */
+	static bool ScanFunctions(const dyn_string& libName, const FunctionVisitor& visitor);
+
+	/**
+	 * @brief Map the classes of all modules in a directory to their files
+	 * @param directory - [in] plugin directory
+	 * @param classes - [out] class name to library file map, a class
+	 * exported by several modules keeps the first file in name order
+	 * @param suffix - [in] file name suffix of the libraries to scan
+	 * @return number of modules scanned
+	 */
+	static size_t ScanDirectory(const dyn_string& directory, ClassLibraryMap& classes,
+			const dyn_string& suffix = DYN_MODULE_SUFFIX);
+
+}; // class ElfScanner
+
+} // namespace DynLoader
+
+#endif // __ELFSCANNER_HPP__
@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __EPOCHDOMAIN_HPP__
+#define __EPOCHDOMAIN_HPP__
+
+#include <platform.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @class EpochDomain EpochDomain.hpp <EpochDomain.hpp>
+ * @brief Epoch based reclamation for lock-free readers
+ *
+ * Readers enter a critical section with a Guard, which only publishes the
+ * current epoch in a per-thread slot. Writers replace shared objects,
+ * retire the old versions and free them once no reader can still see
+ * them. Guards must not be held across calls that wait for readers,
+ * such as DynLoader::Reset().
+ */
+class API_EXPORT EpochDomain
+{
+private:
+	/* @brief Per-thread reader slot, padded to its own cache lines */
+	struct Record
+	{
+		std::atomic<uint64_t> epoch;
+		std::thread::id owner;
+		unsigned depth;
+		Record* next;
+		char padding[128 - sizeof(std::atomic<uint64_t>) - sizeof(std::thread::id) -
+				sizeof(unsigned) - sizeof(Record*)];
+
+		Record() : epoch(0), owner(std::this_thread::get_id()),
+				depth(0), next(nullptr), padding()
+		{
+		}
+	};
+
+	/* @brief Object waiting for readers to leave */
+	struct Retired
+	{
+		void* object;
+		void (*deleter)(void*);
+		uint64_t epoch;
+	};
+
+	std::atomic<uint64_t> globalEpoch;
+	std::atomic<Record*> records;
+	const uint64_t serial;
+
+	std::mutex retiredMutex;
+	std::vector<Retired> retired;
+
+	/**
+	 * @brief Get the reader slot of the calling thread
+	 */
+	Record* LocalRecord();
+
+	/**
+	 * @brief Get the oldest epoch a reader may still be in
+	 */
+	uint64_t MinActiveEpoch() const;
+
+public:
+	/**
+	 * @class Guard
+	 * @brief Scoped read-side critical section
+	 */
+	class Guard
+	{
+	private:
+		EpochDomain& domain;
+		Record* record;
+
+	public:
+		explicit Guard(EpochDomain& domain);
+		~Guard();
+
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+	};
+
+	EpochDomain();
+	~EpochDomain();
+
+	/* @brief Disable copy constructors */
+	EpochDomain(const EpochDomain&) = delete;
+	EpochDomain& operator=(const EpochDomain&) = delete;
+
+	/**
+	 * @brief Free an object once all current readers have left
+	 * @param object - [in] object no longer reachable by new readers
+	 * @param deleter - [in] function releasing the object
+	 */
+	void Retire(void* object, void (*deleter)(void*));
+
+	/**
+	 * @brief Free an object once all current readers have left
+	 * @param object - [in] object no longer reachable by new readers
+	 */
+	template<typename T>
+	void Retire(T* object)
+	{
+		Retire(object, [](void* p) { delete static_cast<T*>(p); });
+	}
+
+	/**
+	 * @brief Free retired objects that no reader can see anymore
+	 */
+	void Reclaim();
+
+	/**
+	 * @brief Wait until all readers that entered before the call have left
+	 */
+	void Synchronize();
+
+}; // class EpochDomain
+
+} // namespace DynLoader
+
+#endif // __EPOCHDOMAIN_HPP__
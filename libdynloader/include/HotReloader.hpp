@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __HOTRELOADER_HPP__
+#define __HOTRELOADER_HPP__
+
+#include <platform.h>
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/* @brief DynLoader forward declaration */
+class DynLoader;
+
+/**
+ * @brief Outcome of a reload, receives the library name and the exception
+ * that occurred, if any
+ */
+typedef std::function<void(const dyn_string&, std::exception_ptr)> ReloadCallback;
+
+/**
+ * @class HotReloader HotReloader.hpp <HotReloader.hpp>
+ * @brief Reloads libraries whose files are replaced on disk
+ *
+ * Watches the directories of the libraries with inotify and calls
+ * DynLoader::ReloadLib() on its own thread when a new file is renamed over
+ * a library or a library file is written and closed. Requests are not
+ * delayed by a reload, they keep using the old module until the new one
+ * is published. Only available on Linux, Watch() fails elsewhere.
+ */
+class API_EXPORT HotReloader
+{
+private:
+	/* @brief Watched library file */
+	struct Watched
+	{
+		int directory;
+		dyn_string fileName;
+		dyn_string libName;
+
+		Watched(int directory, const dyn_string& fileName, const dyn_string& libName) :
+				directory(directory), fileName(fileName), libName(libName)
+		{
+		}
+	};
+
+	DynLoader& loader;
+	ReloadCallback callback;
+
+	int notifyFd;
+	int wakeFds[2];
+
+	std::mutex mutex;
+	std::vector<Watched> watched;
+
+	std::atomic<size_t> reloads;
+	std::thread thread;
+
+	/**
+	 * @brief Watcher thread loop
+	 */
+	void Run();
+
+	/**
+	 * @brief Reload a library and report the outcome
+	 * @param libName - [in] library file name
+	 */
+	void Reload(const dyn_string& libName);
+
+public:
+	/**
+	 * @brief Start watching
+	 * @param loader - [in] loader the libraries are loaded with, must
+	 * outlive the reloader
+	 * @param callback - [in] receives the outcome of every reload, called on
+	 * the watcher thread, must not throw
+	 */
+	explicit HotReloader(DynLoader& loader, ReloadCallback callback = ReloadCallback());
+
+	/**
+	 * @brief Stop watching and join the watcher thread
+	 */
+	~HotReloader();
+
+	/* @brief Disable copy constructors */
+	HotReloader(const HotReloader&) = delete;
+	HotReloader& operator=(const HotReloader&) = delete;
+
+	/**
+	 * @brief Reload a library when its file is replaced
+	 * @param libName - [in] library file name as passed to the loader, must
+	 * contain a directory
+	 * @return false if the directory cannot be watched
+	 */
+	bool Watch(const dyn_string& libName);
+
+	/**
+	 * @brief Get number of successful reloads
+	 */
+	size_t Reloads() const { return reloads.load(std::memory_order_relaxed); }
+
+}; // class HotReloader
+
+} // namespace DynLoader
+
+#endif // __HOTRELOADER_HPP__
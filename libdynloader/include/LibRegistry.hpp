@@ -0,0 +1,208 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIBREGISTRY_HPP__
+#define __LIBREGISTRY_HPP__
+
+#include <platform.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/* @brief DynLib forward declaration */
+struct DynLib;
+
+/**
+ * @brief Link-map namespace libraries are loaded into
+ * 0 is the namespace of the executable, see DynLoader::CreateNamespace().
+ */
+typedef uint32_t DynNamespace;
+
+/**
+ * @brief Canonical identity of a module file
+ * Device and inode on POSIX systems, the module handle on Windows. The
+ * same file loaded into different namespaces is a different module.
+ */
+struct DynLibId
+{
+	uint64_t device;
+	uint64_t inode;
+	DynNamespace space;
+
+	DynLibId() : device(0), inode(0), space(0)
+	{
+	}
+
+	bool operator==(const DynLibId& other) const
+	{
+		return device == other.device && inode == other.inode && space == other.space;
+	}
+};
+
+/* @brief Hash functor for DynLibId */
+struct DynLibIdHash
+{
+	size_t operator()(const DynLibId& id) const
+	{
+		// Inodes are dense per device, mix the device in so that equal
+		// inodes on different file systems do not collide.
+		return static_cast<size_t>((id.inode + id.space) ^ (id.device * 0x9e3779b97f4a7c15ULL));
+	}
+};
+
+/**
+ * @brief Name a library was requested under in a namespace
+ */
+struct DynLibKey
+{
+	DynNamespace space;
+	dyn_string name;
+
+	DynLibKey(DynNamespace space, const dyn_string& name) : space(space), name(name)
+	{
+	}
+
+	bool operator==(const DynLibKey& other) const
+	{
+		return space == other.space && name == other.name;
+	}
+};
+
+/* @brief Hash functor for DynLibKey */
+struct DynLibKeyHash
+{
+	size_t operator()(const DynLibKey& key) const
+	{
+		return std::hash<dyn_string>()(key.name) ^ (static_cast<size_t>(key.space) * 0x9e3779b97f4a7c15ULL);
+	}
+};
+
+/**
+ * @class LibRegistry LibRegistry.hpp <LibRegistry.hpp>
+ * @brief Hashed index of loaded libraries
+ *
+ * Libraries are keyed by their canonical identity. Every name a library
+ * was requested under is kept as an alias so repeated lookups by the same
+ * name are a single hash probe. The loader treats a published registry as
+ * immutable and applies changes to a copy.
+ */
+class API_EXPORT LibRegistry
+{
+private:
+	std::unordered_map<DynLibId, DynLib*, DynLibIdHash> byId;
+	std::unordered_map<DynLibKey, DynLib*, DynLibKeyHash> byName;
+
+public:
+	LibRegistry();
+
+	/* @brief Copies are used as new snapshots, disable assignment */
+	LibRegistry(const LibRegistry&) = default;
+	LibRegistry& operator=(const LibRegistry&) = delete;
+
+	/**
+	 * @brief Find library by requested name
+	 * @param space - [in] namespace the library was requested in
+	 * @param libName - [in] library name as passed by the caller
+	 * @return library, nullptr if the name is unknown
+	 */
+	DynLib* Find(DynNamespace space, const dyn_string& libName) const;
+
+	/**
+	 * @brief Find library by canonical identity
+	 * @param id - [in] library identity
+	 * @return library, nullptr if not registered
+	 */
+	DynLib* Find(const DynLibId& id) const;
+
+	/**
+	 * @brief Register a library under its identity and name
+	 * @param lib - [in] library, lib->id must be set
+	 */
+	void Insert(DynLib* lib);
+
+	/**
+	 * @brief Register an additional name for a library
+	 * @param alias - [in] name the library was requested under in its namespace
+	 * @param lib - [in] registered library
+	 */
+	void AddAlias(const dyn_string& alias, DynLib* lib);
+
+	/**
+	 * @brief Remove a library and all of its aliases
+	 * @param lib - [in] registered library
+	 */
+	void Remove(DynLib* lib);
+
+	/**
+	 * @brief Remove all libraries
+	 */
+	void Clear();
+
+	/**
+	 * @brief Get all registered libraries
+	 * @return list of libraries
+	 */
+	std::vector<DynLib*> Libraries() const;
+
+	/**
+	 * @brief Get number of registered libraries
+	 */
+	size_t Size() const { return byId.size(); }
+
+	/**
+	 * @brief Resolve identity of a library file before opening it
+	 * @param libName - [in] library file name
+	 * @param id - [out] library identity
+	 * @return true if the name is a path that could be resolved
+	 *
+	 * Bare names are looked up by the system loader through its search
+	 * path, so they can only be identified once opened.
+	 */
+	static bool IdentifyPath(const dyn_string& libName, DynLibId& id);
+
+	/**
+	 * @brief Resolve identity of an opened library
+	 * @param handle - [in] system library handle
+	 * @param id - [out] library identity
+	 * @return true on success
+	 */
+	static bool IdentifyHandle(DYN_HANDLE handle, DynLibId& id);
+
+}; // class LibRegistry
+
+} // namespace DynLoader
+
+#endif // __LIBREGISTRY_HPP__
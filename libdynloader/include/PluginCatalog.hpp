@@ -0,0 +1,159 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __PLUGINCATALOG_HPP__
+#define __PLUGINCATALOG_HPP__
+
+#include <platform.h>
+
+#include "ElfScanner.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/* @brief MappedFile forward declaration */
+class MappedFile;
+
+/**
+ * @class PluginCatalog PluginCatalog.hpp <PluginCatalog.hpp>
+ * @brief Memory mapped index of the classes provided by plugin files
+ *
+ * The catalog file holds every library with its size, modification time
+ * and inode, and the exported classes sorted by DynClassHash() of their
+ * names, so a lookup is a binary search in the mapping. A library is checked against the file
+ * system the first time one of its classes is looked up. Libraries that
+ * changed since the catalog was built are rescanned on their own, without
+ * loading them or touching the rest of the plugin tree.
+ *
+ * Catalog files are native to the byte order of the host that built them.
+ */
+class API_EXPORT PluginCatalog
+{
+private:
+	/* @brief On-disk records */
+	struct Header;
+	struct Library;
+	struct Class;
+
+	std::unique_ptr<MappedFile> file;
+	const Header* header;
+	const Library* libraries;
+	const Class* classes;
+	const char* strings;
+
+	/* @brief Per library check state, see IsCurrent() */
+	std::unique_ptr<std::atomic<unsigned char>[]> states;
+
+	/* @brief Classes of libraries that changed since the catalog was built */
+	std::mutex mutex;
+	ClassLibraryMap rescanned;
+
+	/**
+	 * @brief Get a string of the string table
+	 * @param offset - [in] string table offset
+	 * @param length - [in] string length
+	 * @return string, nullptr if outside the table
+	 */
+	const char* String(uint32_t offset, uint32_t length) const;
+
+	/**
+	 * @brief Find the record of a class
+	 * @param className - [in] class name
+	 * @return class record, nullptr if not in the catalog
+	 */
+	const Class* FindClass(const dyn_string& className) const;
+
+	/**
+	 * @brief Check a library against its file on first use
+	 * @param index - [in] library index
+	 * @return true if the library is unchanged since the catalog was built
+	 */
+	bool IsCurrent(uint32_t index);
+
+public:
+	/**
+	 * @brief Map a catalog file
+	 * @param catalogFile - [in] catalog file name
+	 * A missing or malformed catalog results in an empty catalog.
+	 */
+	explicit PluginCatalog(const dyn_string& catalogFile);
+	~PluginCatalog();
+
+	/* @brief Disable copy constructors */
+	PluginCatalog(const PluginCatalog&) = delete;
+	PluginCatalog& operator=(const PluginCatalog&) = delete;
+
+	/**
+	 * @brief Check whether a valid catalog file was mapped
+	 */
+	bool IsValid() const { return header != nullptr; }
+
+	/**
+	 * @brief Get number of catalogued libraries
+	 */
+	size_t LibraryCount() const;
+
+	/**
+	 * @brief Get number of catalogued classes
+	 */
+	size_t ClassCount() const;
+
+	/**
+	 * @brief Find the library providing a class
+	 * @param className - [in] class name
+	 * @param libName - [out] library file name
+	 * @return true if a library providing the class is known
+	 */
+	bool Find(const dyn_string& className, dyn_string& libName);
+
+	/**
+	 * @brief Build or update a catalog file for a plugin directory
+	 * @param catalogFile - [in] catalog file name, replaced atomically
+	 * @param directory - [in] plugin directory, stored in the library paths
+	 * as given
+	 * @param suffix - [in] file name suffix of the libraries to catalog
+	 * @return number of libraries that had to be scanned
+	 *
+	 * Entries of an existing catalog are reused for libraries whose size,
+	 * modification time and inode are unchanged.
+	 */
+	static size_t Build(const dyn_string& catalogFile, const dyn_string& directory,
+			const dyn_string& suffix = DYN_MODULE_SUFFIX);
+
+}; // class PluginCatalog
+
+} // namespace DynLoader
+
+#endif // __PLUGINCATALOG_HPP__
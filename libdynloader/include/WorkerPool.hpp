@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __WORKERPOOL_HPP__
+#define __WORKERPOOL_HPP__
+
+#include <platform.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @class WorkerPool WorkerPool.hpp <WorkerPool.hpp>
+ * @brief Fixed size pool of threads running submitted tasks
+ */
+class API_EXPORT WorkerPool
+{
+private:
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::condition_variable idle;
+	std::deque<std::function<void()> > tasks;
+	std::vector<std::thread> threads;
+	size_t running;
+	bool stopping;
+
+	/**
+	 * @brief Worker thread loop
+	 */
+	void Run();
+
+public:
+	/**
+	 * @brief Start the worker threads
+	 * @param threadCount - [in] number of threads, 0 for one per core
+	 */
+	explicit WorkerPool(unsigned threadCount = 0);
+
+	/**
+	 * @brief Finish queued tasks and join the worker threads
+	 */
+	~WorkerPool();
+
+	/* @brief Disable copy constructors */
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	/**
+	 * @brief Queue a task
+	 * @param task - [in] task, must not throw
+	 */
+	void Submit(std::function<void()> task);
+
+	/**
+	 * @brief Wait until all queued tasks have finished
+	 */
+	void Wait();
+
+	/**
+	 * @brief Get number of worker threads
+	 */
+	size_t Size() const { return threads.size(); }
+
+	/**
+	 * @brief Get the default number of worker threads
+	 * @return number of cores, at least 1
+	 */
+	static unsigned DefaultThreadCount();
+
+}; // class WorkerPool
+
+} // namespace DynLoader
+
+#endif // __WORKERPOOL_HPP__
@@ -221,6 +221,8 @@
 #  define DYN_SYMBOL void *
 #  define DYN_HANDLE HMODULE
 
+#  define DYN_MODULE_SUFFIX ".dll"
+
 #elif defined(unix) || defined(__unix__)
 /**
  * @brief POSIX platform
@@ -235,6 +237,8 @@
 #  define DYN_SYMBOL void *
 #  define DYN_HANDLE void *
 
+#  define DYN_MODULE_SUFFIX ".so"
+
 #  define INVALID_HANDLE_VALUE NULL // To keep things more consistent in init lists
 
 #endif
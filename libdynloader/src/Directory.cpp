@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <LoaderException.hpp>
+
+#include "Directory.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+#include <windows.h>
+#elif PLATFORM_POSIX
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @brief List files of a directory with a given suffix
+ * @param directory - [in] directory
+ * @param suffix - [in] file name suffix
+ * @return sorted list of paths
+ */
+std::vector<dyn_string> ListDirectory(const dyn_string& directory, const dyn_string& suffix)
+{
+	std::vector<dyn_string> files;
+	dyn_string prefix(directory);
+	if(!prefix.empty() && prefix[prefix.size() - 1] != '/' && prefix[prefix.size() - 1] != '\\')
+		prefix += '/';
+
+	auto matches = [&suffix](const dyn_string& name)
+	{
+		return name.size() > suffix.size() &&
+				name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+	WIN32_FIND_DATAA data;
+	HANDLE find = ::FindFirstFileA((prefix + "*").c_str(), &data);
+	if(find == INVALID_HANDLE_VALUE)
+		throw LoaderException("Unable to read directory `" + directory + "`");
+
+	do
+	{
+		if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && matches(data.cFileName))
+			files.push_back(prefix + data.cFileName);
+	}
+	while(::FindNextFileA(find, &data));
+
+	::FindClose(find);
+#elif PLATFORM_POSIX
+	DIR* dir = ::opendir(directory.c_str());
+	if(dir == nullptr)
+		throw LoaderException("Unable to read directory `" + directory + "`");
+
+	while(struct dirent* entry = ::readdir(dir))
+	{
+		if(entry->d_name[0] != '.' && matches(entry->d_name))
+			files.push_back(prefix + entry->d_name);
+	}
+
+	::closedir(dir);
+#endif
+
+	std::sort(files.begin(), files.end());
+
+	return files;
+}
+
+/**
+ * @brief Create a uniquely named file next to a file it will replace
+ * @param fileName - [in] file to be replaced
+ * @param tempFile - [out] name of the created file
+ * @return file opened for binary writing, nullptr on failure
+ *
+ * Processes writing the same file at the same time each get their own
+ * file, the last rename wins.
+ */
+FILE* CreateTempFile(const dyn_string& fileName, dyn_string& tempFile)
+{
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+	const size_t slash = fileName.find_last_of("/\\");
+	const dyn_string directory = slash != dyn_string::npos ? fileName.substr(0, slash) : dyn_string(".");
+
+	char name[MAX_PATH];
+	if(::GetTempFileNameA(directory.c_str(), "dyn", 0, name) == 0)
+		return nullptr;
+
+	FILE* out = std::fopen(name, "wb");
+	if(out == nullptr)
+	{
+		std::remove(name);
+		return nullptr;
+	}
+
+	tempFile = name;
+#elif PLATFORM_POSIX
+	const dyn_string pattern = fileName + ".XXXXXX";
+	std::vector<char> name(pattern.begin(), pattern.end());
+	name.push_back('\0');
+
+	const int fd = ::mkstemp(name.data());
+	if(fd < 0)
+		return nullptr;
+
+	// mkstemp() creates the file readable by its owner only
+	FILE* out = ::fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0 ? ::fdopen(fd, "wb") : nullptr;
+	if(out == nullptr)
+	{
+		::close(fd);
+		std::remove(name.data());
+		return nullptr;
+	}
+
+	tempFile = name.data();
+#endif
+
+	return out;
+}
+
+/**
+ * @brief Replace a file with a newly written one
+ * @param from - [in] new file
+ * @param to - [in] file to replace
+ * @return true on success
+ */
+bool ReplaceFile(const dyn_string& from, const dyn_string& to)
+{
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+	return ::MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+} // namespace DynLoader
@@ -0,0 +1,68 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __DIRECTORY_HPP__
+#define __DIRECTORY_HPP__
+
+#include <platform.h>
+
+#include <cstdio>
+#include <vector>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @brief List files of a directory with a given suffix
+ * @param directory - [in] directory
+ * @param suffix - [in] file name suffix
+ * @return sorted list of paths
+ */
+API_LOCAL std::vector<dyn_string> ListDirectory(const dyn_string& directory, const dyn_string& suffix);
+
+/**
+ * @brief Create a uniquely named file next to a file it will replace
+ * @param fileName - [in] file to be replaced
+ * @param tempFile - [out] name of the created file
+ * @return file opened for binary writing, nullptr on failure
+ */
+API_LOCAL FILE* CreateTempFile(const dyn_string& fileName, dyn_string& tempFile);
+
+/**
+ * @brief Replace a file with a newly written one
+ * @param from - [in] new file
+ * @param to - [in] file to replace
+ * @return true on success
+ */
+API_LOCAL bool ReplaceFile(const dyn_string& from, const dyn_string& to);
+
+} // namespace DynLoader
+
+#endif // __DIRECTORY_HPP__
@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <DynArena.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/* @brief Header of a large block, padded to keep the block aligned */
+struct alignas(std::max_align_t) DynArena::LargeBlock
+{
+	LargeBlock* prev;
+	LargeBlock* next;
+};
+
+DynArena::DynArena() : mutex(), chunks(), cursor(nullptr), remaining(0), freeLists(),
+		largeBlocks(nullptr), stats()
+{
+}
+
+/**
+ * @brief Free all memory of the arena
+ */
+DynArena::~DynArena()
+{
+	Release();
+}
+
+/**
+ * @brief Allocate memory
+ * @param size - [in] bytes
+ * @return memory, nullptr if exhausted
+ */
+void* DynArena::Allocate(size_t size) throw()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	void* memory = nullptr;
+
+	if(size <= MaxSmallSize)
+	{
+		const size_t sizeClass = size ? (size - 1) / Granularity : 0;
+		const size_t blockSize = (sizeClass + 1) * Granularity;
+
+		if(freeLists[sizeClass] != nullptr)
+		{
+			memory = freeLists[sizeClass];
+			freeLists[sizeClass] = *static_cast<void**>(memory);
+		}
+		else
+		{
+			if(remaining < blockSize)
+			{
+				unsigned char* chunk = static_cast<unsigned char*>(std::malloc(ChunkSize));
+				if(chunk == nullptr)
+					return nullptr;
+
+				// The tail of the previous chunk is abandoned, it is at most
+				// one block smaller than the largest size class
+				chunks.push_back(chunk);
+				cursor = chunk;
+				remaining = ChunkSize;
+				stats.reservedBytes += ChunkSize;
+			}
+
+			memory = cursor;
+			cursor += blockSize;
+			remaining -= blockSize;
+		}
+
+		stats.liveBytes += blockSize;
+	}
+	else
+	{
+		LargeBlock* block = static_cast<LargeBlock*>(std::malloc(sizeof(LargeBlock) + size));
+		if(block == nullptr)
+			return nullptr;
+
+		block->prev = nullptr;
+		block->next = largeBlocks;
+		if(largeBlocks != nullptr)
+			largeBlocks->prev = block;
+		largeBlocks = block;
+
+		memory = block + 1;
+		stats.liveBytes += size;
+		stats.reservedBytes += sizeof(LargeBlock) + size;
+	}
+
+	++stats.allocations;
+	stats.peakBytes = std::max(stats.peakBytes, stats.liveBytes);
+
+	return memory;
+}
+
+/**
+ * @brief Free memory
+ * @param memory - [in] memory returned by Allocate()
+ * @param size - [in] bytes passed to Allocate()
+ */
+void DynArena::Deallocate(void* memory, size_t size) throw()
+{
+	if(memory == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(size <= MaxSmallSize)
+	{
+		const size_t sizeClass = size ? (size - 1) / Granularity : 0;
+
+		*static_cast<void**>(memory) = freeLists[sizeClass];
+		freeLists[sizeClass] = memory;
+
+		stats.liveBytes -= (sizeClass + 1) * Granularity;
+	}
+	else
+	{
+		LargeBlock* block = static_cast<LargeBlock*>(memory) - 1;
+		if(block->prev != nullptr)
+			block->prev->next = block->next;
+		else
+			largeBlocks = block->next;
+		if(block->next != nullptr)
+			block->next->prev = block->prev;
+
+		std::free(block);
+
+		stats.liveBytes -= size;
+		stats.reservedBytes -= sizeof(LargeBlock) + size;
+	}
+
+	++stats.deallocations;
+}
+
+/**
+ * @brief Free all memory of the arena in one step
+ */
+void DynArena::Release()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for(auto chunk : chunks)
+		std::free(chunk);
+	chunks.clear();
+
+	while(largeBlocks != nullptr)
+	{
+		LargeBlock* next = largeBlocks->next;
+		std::free(largeBlocks);
+		largeBlocks = next;
+	}
+
+	cursor = nullptr;
+	remaining = 0;
+	std::fill(freeLists, freeLists + SizeClassCount, nullptr);
+
+	stats.liveBytes = 0;
+	stats.reservedBytes = 0;
+}
+
+/**
+ * @brief Get memory usage
+ */
+DynArenaStats DynArena::Stats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return stats;
+}
+
+} // namespace DynLoader
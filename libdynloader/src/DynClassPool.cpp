@@ -0,0 +1,200 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <DynClassPool.hpp>
+#include <LoaderException.hpp>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+namespace
+{
+
+/**
+ * @brief Get the distance between two slots
+ * @param info - [in] class description
+ * @return slot size rounded up to the class alignment
+ */
+size_t SlotStride(const DynClassInfo& info)
+{
+	const size_t alignment = info.alignment ? info.alignment : 1;
+
+	return (info.size + alignment - 1) / alignment * alignment;
+}
+
+} // anonymous namespace
+
+/**
+ * @brief Create a pool in caller provided memory
+ * @param info - [in] class description
+ * @param storage - [in] memory the instances are constructed in
+ * @param bytes - [in] size of the memory
+ */
+DynClassPool::DynClassPool(const DynClassInfo& info, void* storage, size_t bytes) :
+		info(info), buffer(static_cast<unsigned char*>(storage)), slots(nullptr),
+		stride(SlotStride(info)), capacity(0), ownsBuffer(false), mutex(), freeSlots(), instances()
+{
+	Init(bytes);
+}
+
+/**
+ * @brief Create a pool with its own memory
+ * @param info - [in] class description
+ * @param capacity - [in] number of instances
+ */
+DynClassPool::DynClassPool(const DynClassInfo& info, size_t capacity) :
+		info(info), buffer(new unsigned char[RequiredBytes(info, capacity)]), slots(nullptr),
+		stride(SlotStride(info)), capacity(0), ownsBuffer(true), mutex(), freeSlots(), instances()
+{
+	Init(RequiredBytes(info, capacity));
+}
+
+/**
+ * @brief Lay out the slots in a buffer
+ * @param bytes - [in] buffer size
+ */
+void DynClassPool::Init(size_t bytes)
+{
+	if(info.construct == nullptr || info.destruct == nullptr)
+	{
+		if(ownsBuffer)
+			delete[] buffer;
+		throw LoaderException(dyn_string("Class `") + info.name + "` has no placement constructor");
+	}
+
+	const size_t alignment = info.alignment ? info.alignment : 1;
+	const size_t padding = (alignment - reinterpret_cast<uintptr_t>(buffer) % alignment) % alignment;
+
+	slots = buffer + padding;
+	capacity = bytes > padding ? (bytes - padding) / stride : 0;
+
+	// Slot indices are kept as 32 bit values
+	if(capacity > UINT32_MAX)
+		capacity = UINT32_MAX;
+
+	freeSlots.reserve(capacity);
+	for(size_t i = capacity; i > 0; --i)
+		freeSlots.push_back(static_cast<uint32_t>(i - 1));
+	instances.assign(capacity, nullptr);
+}
+
+/**
+ * @brief Destroy remaining instances
+ */
+DynClassPool::~DynClassPool()
+{
+	for(size_t i = 0; i < capacity; ++i)
+	{
+		if(instances[i] != nullptr)
+			info.destruct(instances[i]);
+	}
+
+	if(ownsBuffer)
+		delete[] buffer;
+}
+
+/**
+ * @brief Construct an instance in a free slot
+ * @return instance, nullptr if the pool is exhausted or the constructor failed
+ */
+DynClass* DynClassPool::Construct()
+{
+	uint32_t slot;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if(freeSlots.empty())
+			return nullptr;
+
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+
+	// Constructors run outside the lock
+	DynClass* instance = info.construct(slots + slot * stride);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(instance == nullptr)
+	{
+		freeSlots.push_back(slot);
+		return nullptr;
+	}
+
+	instance->owner = this;
+	instances[slot] = instance;
+
+	return instance;
+}
+
+/**
+ * @brief Destroy an instance in place and free its slot
+ * @param instance - [in] instance constructed by this pool
+ */
+void DynClassPool::Release(DynClass* instance) throw()
+{
+	// The DynClass base may not be at the start of the slot, the slot is
+	// the one the pointer falls into
+	const size_t slot = static_cast<size_t>(reinterpret_cast<unsigned char*>(instance) - slots) / stride;
+
+	info.destruct(instance);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	instances[slot] = nullptr;
+	freeSlots.push_back(static_cast<uint32_t>(slot));
+}
+
+/**
+ * @brief Get number of free slots
+ */
+size_t DynClassPool::Available()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return freeSlots.size();
+}
+
+/**
+ * @brief Get the memory needed for a number of instances
+ * @param info - [in] class description
+ * @param count - [in] number of instances
+ * @return bytes, including slack to align the first slot
+ */
+size_t DynClassPool::RequiredBytes(const DynClassInfo& info, size_t count)
+{
+	const size_t alignment = info.alignment ? info.alignment : 1;
+
+	return SlotStride(info) * count + alignment - 1;
+}
+
+} // namespace DynLoader
@@ -26,20 +26,37 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+
 #include <platform.h>
 
 #include <DynClass.hpp>
 #include <DynLoader.hpp>
 #include <LoaderException.hpp>
+#include <PluginCatalog.hpp>
+#include <WorkerPool.hpp>
+
+#include "Probes.hpp"
+#include "Reclaimer.hpp"
+#include "SymbolBinder.hpp"
 
 #include <memory>
 #include <algorithm>
+#include <chrono>
 #include <functional>
 
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
 
 #ifdef PLATFORM_POSIX
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <gnu/lib-names.h>
+#endif
 #endif
 
 /**
@@ -48,170 +65,1812 @@
 namespace DynLoader
 {
 
-DynLoader::DynLoader() : lastError(), libs()
+namespace
+{
+
+/**
+ * @brief Find a class entry without taking locks
+ * @param table - [in] class table
+ * @param className - [in] class name
+ * @return class entry, nullptr if not resolved yet
+ */
+DynClassEntry* FindClassEntry(const DynClassTable& table, const dyn_string& className)
+{
+	auto it = table.find(DynClassHash(className));
+
+	return it != table.end() && it->second->name == className ? it->second : nullptr;
+}
+
+/**
+ * @brief Keep a library loaded while raw pointers into it are in use
+ * @param lib - [in] library, the caller must hold an epoch guard
+ */
+void Pin(DynLib& lib)
+{
+	if(!lib.pinned.load(std::memory_order_relaxed))
+		lib.pinned.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Check whether a library has constructed instances
+ * @param lib - [in] library, the caller must hold an epoch guard
+ * @return true if any class has an instance
+ */
+bool HasInstances(const DynLib& lib)
+{
+	for(auto& cls : *lib.classes.load(std::memory_order_acquire))
+	{
+		if(cls.second->instance.load(std::memory_order_relaxed) != nullptr)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Get the steady clock time used for library activity
+ * @return nanoseconds since an arbitrary epoch
+ */
+int64_t Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#if PLATFORM_POSIX
+/**
+ * @brief Segment sizes of a module, filled by dl_iterate_phdr()
+ */
+struct SegmentSizes
+{
+	const struct link_map* map;
+	DynLib* lib;
+};
+
+/**
+ * @brief Add up the loadable segments of the module looked for
+ */
+int AddSegments(struct dl_phdr_info* info, size_t, void* data)
+{
+	SegmentSizes* sizes = static_cast<SegmentSizes*>(data);
+	if(info->dlpi_addr != sizes->map->l_addr || info->dlpi_name == nullptr ||
+			std::strcmp(info->dlpi_name, sizes->map->l_name) != 0)
+		return 0;
+
+	for(ElfW(Half) i = 0; i < info->dlpi_phnum; ++i)
+	{
+		const ElfW(Phdr)& segment = info->dlpi_phdr[i];
+		if(segment.p_type != PT_LOAD)
+			continue;
+
+		if(segment.p_flags & PF_X)
+		{
+			sizes->lib->textBytes += segment.p_memsz;
+		}
+		else
+		{
+			sizes->lib->dataBytes += segment.p_filesz;
+			sizes->lib->bssBytes += segment.p_memsz - segment.p_filesz;
+		}
+	}
+
+	return 1;
+}
+#endif
+
+/**
+ * @brief Measure the loadable segments of a library
+ * @param lib - [in] opened library
+ */
+void MeasureSegments(DynLib& lib)
+{
+#if PLATFORM_POSIX
+	struct link_map* map = nullptr;
+	if(::dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) != 0 || map == nullptr || map->l_name == nullptr)
+		return;
+
+	SegmentSizes sizes = { map, &lib };
+	::dl_iterate_phdr(AddSegments, &sizes);
+#else
+	(void) lib;
+#endif
+}
+
+} // anonymous namespace
+
+DynLoader::DynLoader() : libs(new LibRegistry()), epoch(), writeMutex(),
+		openMutex(), opening(), asyncMutex(), asyncLoads(), asyncPool(),
+		catalogMutex(), catalog(), arenaMode(ArenaMode::Disabled), arenaMutex(), retiredArenas(),
+		detached(), reclaimer(nullptr), closeFailures(0), mappedBytes(0), memoryBudget(0), evictionPending(false),
+		optionsMutex(), loadOptions(), libraryOptions(), profiling(false), profileMutex(), profile(),
+		forkMutex(), forkHandlers(), namespaceMutex(), namespaces(), stats(),
+		publisherMutex(), publisher(nullptr), listeners(nullptr), listenerMutex(), nextListener(0),
+		perfMapMutex(), perfMap(nullptr)
 {
 }
 
 DynLoader::~DynLoader()
 {
+	// The publisher reads the registry until it is joined
+	StopPublishingStats();
+
+	// Finish pending asynchronous requests, evictions and the bindings they
+	// schedule before unloading, libraries torn down below must not
+	// schedule new ones
+	memoryBudget.store(0, std::memory_order_relaxed);
+	StopBackgroundThreads();
+
 	Reset();
+
+	// Libraries hand their arenas back while being torn down
+	delete reclaimer.exchange(nullptr);
+
+#if PLATFORM_POSIX
+	for(auto anchor : namespaces)
+		::dlclose(anchor);
+#endif
+
+	delete libs.exchange(nullptr);
+	catalog.reset();
+
+	for(auto arena : retiredArenas)
+		delete arena;
+
+	delete listeners.exchange(nullptr);
+
+	// Kept until the libraries above logged their unload
+	DisablePerfMap();
+}
+
+/**
+ * @brief Find library without taking locks
+ * @param space - [in] namespace
+ * @param libName - [in] library file name
+ * @return library, nullptr if not found
+ */
+DynLib* DynLoader::FindLib(DynNamespace space, const dyn_string& libName)
+{
+	return libs.load(std::memory_order_acquire)->Find(space, libName);
+}
+
+/**
+ * @brief Replace the published registry
+ * @param next - [in] new registry snapshot
+ *
+ * The previous snapshot is freed once no reader can see it anymore.
+ */
+void DynLoader::Publish(LibRegistry* next)
+{
+	LibRegistry* prev = libs.exchange(next);
+
+	epoch.Retire(prev);
+	epoch.Reclaim();
 }
 
 /**
  * @brief Retrieves an instance of a loaded library
+ * @param space - [in] namespace
  * @param libName - [in] library file name
  * @return lib - dynamic library
+ *
+ * Names that have been seen before resolve with a single hash probe. A new
+ * name that is a path to an already loaded module is matched by device and
+ * inode and remembered as an alias.
  */
-DynLib* DynLoader::GetLoadedLibrary(const dyn_string& libName)
+DynLib* DynLoader::GetLoadedLibrary(DynNamespace space, const dyn_string& libName)
 {
-	for (auto lib : libs)
 	{
-		if (lib->name == libName)
+		EpochDomain::Guard guard(epoch);
+
+		DynLib* lib = FindLib(space, libName);
+		if(lib != nullptr)
 			return lib;
 	}
 
-	return nullptr;
+	DynLibId id;
+	id.space = space;
+	if(!LibRegistry::IdentifyPath(libName, id))
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(writeMutex);
+
+	LibRegistry* current = libs.load(std::memory_order_relaxed);
+	DynLib* lib = current->Find(id);
+	if(lib != nullptr && current->Find(space, libName) == nullptr)
+	{
+		LibRegistry* next = new LibRegistry(*current);
+		next->AddAlias(libName, lib);
+		Publish(next);
+	}
+
+	return lib;
 }
 
 /**
  * @brief Open library
+ * @param space - [in] namespace
  * @param libName - [in] library file name
  * @return pointer to dynamic library, nullptr if not found or unable to 
  * create
  *
- * @todo Add path alteration for windows.
+ * Threads missing the same name at the same time share a single open and
+ * all receive its result or exception.
  */
-DynLib* DynLoader::OpenLib(const dyn_string& libName, bool resolveSymbols)
+DynLib* DynLoader::OpenLib(DynNamespace space, const dyn_string& libName)
 {
-	DynLib* lib = GetLoadedLibrary(libName);
+	DynLib* lib = GetLoadedLibrary(space, libName);
 	if (lib != nullptr)
 		return lib;
 
-	lib = new DynLib(libName, *this, resolveSymbols);
-	if (lib == nullptr)
-		return nullptr;
+	const DynLibKey key(space, libName);
+	std::promise<DynLib*> promise;
+	std::shared_future<DynLib*> pending;
+	bool leader = false;
+	{
+		std::lock_guard<std::mutex> lock(openMutex);
+
+		auto it = opening.find(key);
+		if(it != opening.end())
+		{
+			pending = it->second;
+		}
+		else
+		{
+			pending = promise.get_future().share();
+			opening.insert(std::make_pair(key, pending));
+			leader = true;
+		}
+	}
+
+	if(!leader)
+		return pending.get();
+
+	DYN_PROBE1(open_start, libName.c_str());
+
+	try
+	{
+		lib = OpenNewLib(space, libName);
+		promise.set_value(lib);
+	}
+	catch(...)
+	{
+		promise.set_exception(std::current_exception());
+
+		std::lock_guard<std::mutex> lock(openMutex);
+		opening.erase(key);
 
-	libs.push_back(lib);
+		DYN_PROBE2(open_done, libName.c_str(), lib);
+		throw;
+	}
+
+	std::lock_guard<std::mutex> lock(openMutex);
+	opening.erase(key);
+
+	DYN_PROBE2(open_done, libName.c_str(), lib);
 
 	return lib;
 }
 
 /**
- * @brief Returns a class instance from an instanced library
- * @param lib - [in] dynamic library instance
- * @param className - [in] class name
- * @return pointer to class instance
+ * @brief Open library and register it
+ * @param space - [in] namespace
+ * @param libName - [in] library file name
+ * @return pointer to dynamic library
+ *
+ * The system loader is called without holding any lock, so libraries can
+ * be opened in parallel. Only the registry update is serialized.
+ *
+ * @todo Add path alteration for windows.
  */
-DynClass* DynLoader::GetClassInstance(DynLib& lib, const dyn_string& className)
+DynLib* DynLoader::OpenNewLib(DynNamespace space, const dyn_string& libName)
 {
-	for(auto entry : lib.instances)
+	const DynLoadOptions options = GetLoadOptions(libName);
+	const long linkMap = GetLinkMap(space);
+
+	std::unique_ptr<DynLib> opened;
+	const std::chrono::steady_clock::time_point start = EventStart();
+	try
+	{
+		DynStatsCollector::Timer timer(stats, DynMetric::Open);
+		opened.reset(new DynLib(libName, *this, options, dyn_string(), space, linkMap));
+	}
+	catch(...)
 	{
-		if(entry->name == className)
-			return entry->instance;
+		if(start != std::chrono::steady_clock::time_point())
+		{
+			DynEvent event(DynEventType::Open, start, libName.c_str(), space, nullptr, nullptr, true);
+			Notify(event);
+		}
+		throw;
 	}
 
-	dyn_string builderName("Create" + className);
+	if(start != std::chrono::steady_clock::time_point())
+	{
+		DynEvent event(DynEventType::Open, start, libName.c_str(), space, nullptr, opened->handle);
+		Notify(event);
+	}
 
-	// POSIX guarantees that the size of a pointer to object is equal to 
-	// the size of a pointer to a function. On Windows NT systems this is also a safe 
-	// assumption.
-	std::function<DynClass*()> builder(std::bind(
-			reinterpret_cast<DynClass*(*)()>(GetSymbolByName(lib, builderName.c_str()))));
-	if(builder == nullptr)
-		throw LoaderException("Factory builder `" + builderName + 
-				"` for Class `" + className +
-				"` not found in " + lib.name);
+	LibRegistry::IdentifyHandle(opened->handle, opened->id);
+	opened->id.space = space;
+	MeasureSegments(*opened);
+	RecordCode(*opened, dyn_string());
+	IndexClasses(*opened);
+	InstallArena(*opened);
+	opened->lastUse.store(Now(), std::memory_order_relaxed);
 
-	// Create an instance of the class
-	auto instance = builder();
-	if(instance == nullptr)
-		throw LoaderException("Unable to create instance of class `" + className + "`");
-	
-	auto entry = new DynClassEntry(className, instance);
+	DynLib* candidate = opened.get();
+	DynLib* lib = PublishLib(libName, opened);
 
-	lib.instances.push_back(entry);
+	// Slots are resolved through the base namespace, leave the others to
+	// the system loader
+	if(lib == candidate && lib->options.binding == SymbolBinding::Lazy && lib->options.bindInBackground &&
+			lib->space == 0)
+		ScheduleBinding(*lib);
 
-	return instance;
+	ScheduleEviction();
+
+	return lib;
 }
 
 /**
- * @brief Get last error description
- * @return last error description
+ * @brief Register an opened library unless its module is already known
+ * @param libName - [in] library file name
+ * @param opened - [in] opened library, released if registered
+ * @return registered library
  */
-const dyn_string& DynLoader::GetLastError()
+DynLib* DynLoader::PublishLib(const dyn_string& libName, std::unique_ptr<DynLib>& opened)
 {
-	lastError.clear();
+	std::lock_guard<std::mutex> lock(writeMutex);
 
-#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
-	LPSTR lpMsgBuf = nullptr;
-	const DWORD res = ::FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER|
-			FORMAT_MESSAGE_FROM_SYSTEM|FORMAT_MESSAGE_IGNORE_INSERTS,
-			nullptr, ::GetLastError(), 
-			MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-			lpMsgBuf, 0, nullptr);
+	// Bare names are only identified once the system loader resolved them,
+	// and another thread may have opened the same module meanwhile. Drop
+	// the duplicate reference if the module is already known.
+	LibRegistry* next = new LibRegistry(*libs.load(std::memory_order_relaxed));
+	DynLib* existing = next->Find(opened->id);
+	if(existing != nullptr)
+	{
+		next->AddAlias(libName, existing);
+		Publish(next);
+		return existing;
+	}
 
-	if(res != 0)
+	next->Insert(opened.get());
+	opened->registered = true;
+	mappedBytes.fetch_add(opened->MappedBytes(), std::memory_order_relaxed);
+	Publish(next);
+
+	return opened.release();
+}
+
+/**
+ * @brief Index all classes listed by a module's class list
+ * @param lib - [in] library that has not been published yet
+ *
+ * One symbol lookup replaces the lookup of every Create function. Classes
+ * missing from the list are still resolved by name in GetClassEntry().
+ */
+void DynLoader::IndexClasses(DynLib& lib)
+{
+	auto moduleClasses = reinterpret_cast<DynModuleClasses>(GetModuleSymbol(lib, DYN_MODULE_CLASSES_SYMBOL));
+	if(moduleClasses == nullptr)
+		return;
+
+	DynClassTable* table = lib.classes.load(std::memory_order_relaxed);
+	for(const DynClassInfo* info = moduleClasses(); info != nullptr; info = info->next)
 	{
-		lastError.assign(lpMsgBuf);
-		(void) ::LocalFree(lpMsgBuf);
+		if(info->name == nullptr || info->builder == nullptr)
+			continue;
+
+		// The first of two colliding names wins, the other one is resolved
+		// by name and rejected in GetClassEntry()
+		if(table->find(info->hash) == table->end())
+			table->insert(std::make_pair(info->hash, new DynClassEntry(info->name, info->builder, info)));
 	}
-#elif PLATFORM_POSIX
-	const char* dlerr = ::dlerror();
-	if(dlerr != nullptr)
-		lastError.assign(dlerr);
-#endif
+}
 
-	return lastError;
+/**
+ * @brief Install an arena into a module exporting the allocator hook
+ * @param lib - [in] library that has not been published yet
+ *
+ * Static initializers of the module have run with the global heap, its
+ * factories have not run yet unless another loader reused the module.
+ * Instances remember their allocator, so both kinds are freed correctly.
+ */
+void DynLoader::InstallArena(DynLib& lib)
+{
+	const ArenaMode mode = arenaMode.load(std::memory_order_relaxed);
+	if(mode == ArenaMode::Disabled)
+		return;
+
+	auto installAllocator = reinterpret_cast<DynModuleInstallAllocator>(GetModuleSymbol(lib, DYN_MODULE_ALLOCATOR_SYMBOL));
+	if(installAllocator == nullptr)
+		return;
+
+	std::unique_ptr<DynArena> arena(new DynArena());
+
+	// A module shared with another loader keeps the allocator it has
+	if(!installAllocator(nullptr, arena.get()))
+		return;
+
+	lib.arena = arena.release();
+	lib.installAllocator = installAllocator;
+	lib.releaseArena = mode == ArenaMode::ReleaseOnClose;
 }
 
 /**
- * @brief Close library
- * @param lib - [in] dynamic library instance
- * @return void
+ * @brief Dispose of the arena of a closed library
+ * @param arena - [in] arena no longer installed in its module
+ * @param release - [in] free the arena even if memory is still live
+ *
+ * Objects of a module that stays mapped may still free into a tracked
+ * arena, so it is kept until the loader is destroyed.
  */
-void DynLoader::CloseLib(DynLib& lib)
+void DynLoader::RetireArena(DynArena* arena, bool release)
 {
-	libs.remove(&lib);
+	if(release || arena->Stats().liveBytes == 0)
+	{
+		delete arena;
+		return;
+	}
 
-	delete &lib;
+	std::lock_guard<std::mutex> lock(arenaMutex);
+	retiredArenas.push_back(arena);
 }
 
 /**
- * @brief Get symbol by name
- * @param symbolName - [in] symbol name
- * @return pointer to symbol, 0 if not found
+ * @brief Select the arenas installed into modules opened from now on
+ * @param mode - [in] arena mode
  */
-DYN_SYMBOL DynLoader::GetSymbolByName(DynLib& lib, const DYN_CHAR * symbolName)
+void DynLoader::SetArenaMode(ArenaMode mode)
 {
-	return
-#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
-		reinterpret_cast<void *>(::GetProcAddress(lib.handle, symbolName));
-#elif PLATFORM_POSIX
-		::dlsym(lib.handle, symbolName);
-#endif
+	arenaMode.store(mode, std::memory_order_relaxed);
 }
 
 /**
- * @brief Reset the dynamic loader
- * Free all libraries and set initial state
+ * @brief Get the memory usage of a library arena
+ * @param libName - [in] library file name
+ * @param stats - [out] arena usage
+ * @return false if the library is not loaded or has no arena
  */
-void DynLoader::Reset()
+bool DynLoader::GetArenaStats(const dyn_string& libName, DynArenaStats& stats)
 {
-	// Free all libraries
-	for(auto lib : libs)
-		delete lib;
+	EpochDomain::Guard guard(epoch);
 
-	libs.clear();
+	DynLib* lib = FindLib(0, libName);
+	if(lib == nullptr || lib->arena == nullptr)
+		return false;
+
+	stats = lib->arena->Stats();
+
+	return true;
 }
 
 /**
- * @brief Destroy the dynamic loader
- * Dynamic loader shutdown routine
+ * @brief Open library and get class instance
+ * @param space - [in] namespace
+ * @param libName - [in] library file name
+ * @param className - [in] class name
+ * @return pointer to class instance
  */
-void DynLoader::Destroy()
+DynClass* DynLoader::LoadClassInstance(DynNamespace space, const dyn_string& libName, const dyn_string& className)
 {
-	delete this;
+	EpochDomain::Guard guard(epoch);
+
+	DynLib* lib = OpenLib(space, libName);
+	if(lib == nullptr)
+		return nullptr;
+
+	Pin(*lib);
+
+	return GetClassInstance(*lib, className);
 }
 
-} // namespace DynLoader
+/**
+ * @brief Open library and get class instance by identifier
+ * @param space - [in] namespace
+ * @param libName - [in] library file name
+ * @param classId - [in] class identifier
+ * @return pointer to class instance
+ */
+DynClass* DynLoader::LoadClassInstance(DynNamespace space, const dyn_string& libName, const DynClassId& classId)
+{
+	EpochDomain::Guard guard(epoch);
+
+	DynLib* lib = OpenLib(space, libName);
+	if(lib == nullptr)
+		return nullptr;
+
+	Pin(*lib);
+
+	return GetClassInstance(*lib, classId);
+}
+
+/**
+ * @brief Find the library of a class in the catalog and get class instance
+ * @param className - [in] class name
+ * @return pointer to DynClass instance
+ */
+DynClass* DynLoader::LoadCatalogClassInstance(const dyn_string& className)
+{
+	std::shared_ptr<PluginCatalog> current;
+	{
+		std::lock_guard<std::mutex> lock(catalogMutex);
+		current = catalog;
+	}
+
+	if(!current)
+		throw LoaderException("No plugin catalog opened to find class `" + className + "`");
+
+	// A miss checks every catalogued file, epoch guards must not wait for it
+	dyn_string libName;
+	if(!current->Find(className, libName))
+		throw LoaderException("Class `" + className + "` not found in plugin catalog");
+
+	return LoadClassInstance(0, libName, className);
+}
+
+/**
+ * @brief Use a plugin catalog for lookups by class name
+ * @param catalogFile - [in] catalog file name
+ * @return false if the catalog could not be read
+ */
+bool DynLoader::OpenCatalog(const dyn_string& catalogFile)
+{
+	std::unique_ptr<PluginCatalog> next(new PluginCatalog(catalogFile));
+	if(!next->IsValid())
+		return false;
+
+	std::shared_ptr<PluginCatalog> prev(std::move(next));
+	{
+		std::lock_guard<std::mutex> lock(catalogMutex);
+		catalog.swap(prev);
+	}
+
+	return true;
+}
+
+/**
+ * @brief Open library and get class factory function
+ * @param space - [in] namespace
+ * @param libName - [in] library file name
+ * @param className - [in] class name
+ * @return factory function
+ */
+DynClassBuilder DynLoader::LoadClassBuilder(DynNamespace space, const dyn_string& libName, const dyn_string& className)
+{
+	EpochDomain::Guard guard(epoch);
+
+	DynLib* lib = OpenLib(space, libName);
+	if(lib == nullptr)
+		return nullptr;
+
+	Pin(*lib);
+
+	return GetClassBuilder(*lib, className);
+}
+
+/**
+ * @brief Get the description a module exports for a class
+ * @param libName - [in] library file name
+ * @param className - [in] class name
+ * @return class description, nullptr if the module has no class list
+ */
+const DynClassInfo* DynLoader::GetClassInfo(const dyn_string& libName, const dyn_string& className)
+{
+	EpochDomain::Guard guard(epoch);
+
+	DynLib* lib = OpenLib(0, libName);
+	if(lib == nullptr)
+		return nullptr;
+
+	Pin(*lib);
 
+	const DynClassEntry* found = FindClassEntry(*lib->classes.load(std::memory_order_acquire), className);
+	if(found != nullptr)
+		return found->info;
+
+	std::lock_guard<std::mutex> lock(lib->mutex);
+
+	return GetClassEntry(*lib, className).info;
+}
+
+/**
+ * @brief Create a pool constructing instances in caller provided memory
+ * @param libName - [in] library file name
+ * @param className - [in] class name
+ * @param storage - [in] memory the instances are constructed in
+ * @param bytes - [in] size of the memory
+ * @return pool
+ */
+std::unique_ptr<DynClassPool> DynLoader::CreatePool(const dyn_string& libName, const dyn_string& className,
+		void* storage, size_t bytes)
+{
+	const DynClassInfo* info = GetClassInfo(libName, className);
+	if(info == nullptr)
+		throw LoaderException("Class `" + className + "` in " + libName + " has no placement constructor");
+
+	return std::unique_ptr<DynClassPool>(new DynClassPool(*info, storage, bytes));
+}
+
+/**
+ * @brief Create a pool of instances in one contiguous allocation
+ * @param libName - [in] library file name
+ * @param className - [in] class name
+ * @param capacity - [in] number of instances
+ * @return pool
+ */
+std::unique_ptr<DynClassPool> DynLoader::CreatePool(const dyn_string& libName, const dyn_string& className,
+		size_t capacity)
+{
+	const DynClassInfo* info = GetClassInfo(libName, className);
+	if(info == nullptr)
+		throw LoaderException("Class `" + className + "` in " + libName + " has no placement constructor");
+
+	return std::unique_ptr<DynClassPool>(new DynClassPool(*info, capacity));
+}
+
+/**
+ * @brief Find an existing class instance without taking locks
+ * @param libName - [in] library file name
+ * @param className - [in] class name
+ * @return pointer to class instance, nullptr if not created yet
+ */
+DynClass* DynLoader::FindClassInstance(const dyn_string& libName, const dyn_string& className)
+{
+	EpochDomain::Guard guard(epoch);
+
+	DynLib* lib = FindLib(0, libName);
+	if(lib == nullptr)
+		return nullptr;
+
+	const DynClassEntry* found = FindClassEntry(*lib->classes.load(std::memory_order_acquire), className);
+	if(found == nullptr)
+		return nullptr;
+
+	DynClass* instance = found->instance.load(std::memory_order_acquire);
+	if(instance != nullptr)
+		Pin(*lib);
+
+	return instance;
+}
+
+/**
+ * @brief Open library, get class instance and reference the library
+ * @param space - [in] namespace
+ * @param libName - [in] library file name
+ * @param className - [in] class name
+ * @param lib - [out] referenced library
+ * @return pointer to class instance
+ *
+ * The reference is taken under the epoch guard the library was found
+ * with, so it cannot be closed in between.
+ */
+DynClass* DynLoader::AcquireClassInstance(DynNamespace space, const dyn_string& libName, const dyn_string& className,
+		DynLib*& lib)
+{
+	EpochDomain::Guard guard(epoch);
+
+	DynLib* opened = OpenLib(space, libName);
+	if(opened == nullptr)
+		throw LoaderException("Could not open `" + libName + "`");
+
+	DynClass* instance = GetClassInstance(*opened, className);
+
+	opened->refs.fetch_add(1, std::memory_order_relaxed);
+	opened->lastUse.store(Now(), std::memory_order_relaxed);
+	lib = opened;
+
+	return instance;
+}
+
+/**
+ * @brief Asynchronous instance request shared by concurrent callers
+ */
+struct DynLoader::AsyncLoad
+{
+	std::vector<std::pair<InstanceCallback, Executor> > waiters;
+
+	AsyncLoad() : waiters()
+	{
+	}
+};
+
+/**
+ * @brief Get class instance without blocking the caller
+ * @param libName - [in] library file name
+ * @param className - [in] class name
+ * @param callback - [in] completion callback
+ * @param executor - [in] runs the callback, may be empty
+ *
+ * The first request for a class queues the load on the loader pool,
+ * later requests for the same class only add their callback to it.
+ * Callbacks must not throw.
+ */
+void DynLoader::LoadClassInstanceAsync(const dyn_string& libName, const dyn_string& className,
+		InstanceCallback callback, Executor executor)
+{
+	DynClass* instance = FindClassInstance(libName, className);
+	if(instance != nullptr)
+	{
+		if(executor)
+			executor(std::bind(callback, instance, std::exception_ptr()));
+		else
+			callback(instance, std::exception_ptr());
+		return;
+	}
+
+	dyn_string key(libName);
+	key += '\0';
+	key += className;
+
+	std::lock_guard<std::mutex> lock(asyncMutex);
+
+	auto it = asyncLoads.find(key);
+	if(it != asyncLoads.end())
+	{
+		it->second->waiters.push_back(std::make_pair(callback, executor));
+		return;
+	}
+
+	std::shared_ptr<AsyncLoad> load(new AsyncLoad());
+	load->waiters.push_back(std::make_pair(callback, executor));
+	asyncLoads.insert(std::make_pair(key, load));
+
+	if(!asyncPool)
+		asyncPool.reset(new WorkerPool());
+
+	asyncPool->Submit([this, libName, className, key]()
+	{
+		DynClass* instance = nullptr;
+		std::exception_ptr error;
+
+		try
+		{
+			instance = LoadClassInstance(0, libName, className);
+		}
+		catch(...)
+		{
+			error = std::current_exception();
+		}
+
+		std::shared_ptr<AsyncLoad> load;
+		{
+			std::lock_guard<std::mutex> lock(asyncMutex);
+
+			auto it = asyncLoads.find(key);
+			load = it->second;
+			asyncLoads.erase(it);
+		}
+
+		for(auto& waiter : load->waiters)
+		{
+			try
+			{
+				if(waiter.second)
+					waiter.second(std::bind(waiter.first, instance, error));
+				else
+					waiter.first(instance, error);
+			}
+			catch(...)
+			{
+				;;
+			}
+		}
+	});
+}
+
+/**
+ * @brief Returns a class instance from an instanced library
+ * @param lib - [in] dynamic library instance
+ * @param className - [in] class name
+ * @return pointer to class instance
+ */
+DynClass* DynLoader::GetClassInstance(DynLib& lib, const dyn_string& className)
+{
+	DynStatsCollector::Timer timer(stats, DynMetric::InstanceHit);
+	DYN_PROBE2(instance_start, lib.name.c_str(), className.c_str());
+
+	const DynClassEntry* found = FindClassEntry(*lib.classes.load(std::memory_order_acquire), className);
+	if(found != nullptr)
+	{
+		DynClass* instance = found->instance.load(std::memory_order_acquire);
+		if(instance != nullptr)
+		{
+			DYN_PROBE4(instance_done, lib.name.c_str(), className.c_str(), instance, 0);
+			return instance;
+		}
+	}
+
+	timer.SetMetric(DynMetric::InstanceMiss);
+
+	DynClassEntry* entry = nullptr;
+	{
+		// The library lock only covers the table update, constructors
+		// run under the lock of their own entry.
+		std::lock_guard<std::mutex> lock(lib.mutex);
+		entry = &GetClassEntry(lib, className);
+	}
+
+	DynClass* instance = GetEntryInstance(lib, *entry);
+	DYN_PROBE4(instance_done, lib.name.c_str(), className.c_str(), instance, 1);
+
+	if(profiling.load(std::memory_order_relaxed))
+		RecordProfile(lib, *entry, true);
+
+	return instance;
+}
+
+/**
+ * @brief Get class instance by identifier
+ * @param lib - [in] dynamic library instance
+ * @param classId - [in] class identifier
+ * @return pointer to class instance
+ *
+ * Once the instance exists this is a single probe with the precomputed
+ * hash plus a name comparison, since another class may share the hash.
+ * Misses and collisions fall back to the lookup by name.
+ */
+DynClass* DynLoader::GetClassInstance(DynLib& lib, const DynClassId& classId)
+{
+	{
+		DynStatsCollector::Timer timer(stats, DynMetric::InstanceHit);
+
+		const DynClassTable* table = lib.classes.load(std::memory_order_acquire);
+		auto it = table->find(classId.hash);
+		if(it != table->end() && it->second->name == classId.name)
+		{
+			DynClass* instance = it->second->instance.load(std::memory_order_acquire);
+			if(instance != nullptr)
+				return instance;
+		}
+
+		// Recorded by the lookup by name
+		timer.Cancel();
+	}
+
+	return GetClassInstance(lib, dyn_string(classId.name));
+}
+
+/**
+ * @brief Returns the shared instance of a class, constructing it once
+ * @param entry - [in] class entry
+ * @return pointer to class instance
+ *
+ * A failed construction leaves the entry empty, so the next caller
+ * retries.
+ */
+DynClass* DynLoader::GetEntryInstance(DynLib& lib, DynClassEntry& entry)
+{
+	DynClass* instance = entry.instance.load(std::memory_order_acquire);
+	if(instance != nullptr)
+		return instance;
+
+	std::lock_guard<std::mutex> lock(entry.mutex);
+
+	instance = entry.instance.load(std::memory_order_relaxed);
+	if(instance != nullptr)
+		return instance;
+
+	// Create an instance of the class
+	const std::chrono::steady_clock::time_point start = EventStart();
+	{
+		DynStatsCollector::Timer timer(stats, DynMetric::Construct);
+		instance = entry.builder();
+	}
+
+	DYN_PROBE3(create, lib.name.c_str(), entry.name.c_str(), instance);
+	if(start != std::chrono::steady_clock::time_point())
+	{
+		DynEvent event(DynEventType::Create, start, lib.file.c_str(), lib.space, entry.name.c_str(),
+				instance, instance == nullptr);
+		Notify(event);
+	}
+
+	if(instance == nullptr)
+		throw LoaderException("Unable to create instance of class `" + entry.name + "`");
+
+	entry.instance.store(instance, std::memory_order_release);
+
+	return instance;
+}
+
+/**
+ * @brief Returns the factory function of a class
+ * @param lib - [in] dynamic library instance
+ * @param className - [in] class name
+ * @return factory function
+ */
+DynClassBuilder DynLoader::GetClassBuilder(DynLib& lib, const dyn_string& className)
+{
+	DynClassEntry* entry = FindClassEntry(*lib.classes.load(std::memory_order_acquire), className);
+	if(entry == nullptr || entry->builder == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(lib.mutex);
+		entry = &GetClassEntry(lib, className);
+	}
+
+	if(profiling.load(std::memory_order_relaxed))
+		RecordProfile(lib, *entry, false);
+
+	return entry->builder;
+}
+
+/**
+ * @brief Returns the class entry of a library, resolving the factory
+ * @param lib - [in] dynamic library instance
+ * @param className - [in] class name
+ * @return class entry
+ */
+DynClassEntry& DynLoader::GetClassEntry(DynLib& lib, const dyn_string& className)
+{
+	const uint64_t hash = DynClassHash(className);
+
+	DynClassTable* table = lib.classes.load(std::memory_order_relaxed);
+	auto it = table->find(hash);
+	if(it != table->end())
+	{
+		if(it->second->name != className)
+			throw LoaderException("Class `" + className + "` collides with class `" +
+					it->second->name + "` in " + lib.name);
+
+		return *it->second;
+	}
+
+	dyn_string builderName("Create" + className);
+
+	// POSIX guarantees that the size of a pointer to object is equal to 
+	// the size of a pointer to a function. On Windows NT systems this is also a safe 
+	// assumption.
+	auto builder = reinterpret_cast<DynClassBuilder>(GetSymbolByName(lib, builderName.c_str()));
+	if(builder == nullptr)
+		throw LoaderException("Factory builder `" + builderName + 
+				"` for Class `" + className +
+				"` not found in " + lib.name);
+
+	auto entry = new DynClassEntry(className, builder);
+
+	// Readers may be walking the current table, publish an extended copy
+	std::unique_ptr<DynClassTable> next(new DynClassTable(*table));
+	next->insert(std::make_pair(hash, entry));
+
+	lib.classes.store(next.release(), std::memory_order_release);
+	epoch.Retire(table);
+
+	return *entry;
+}
+
+/**
+ * @brief Get last error description of the calling thread
+ * @return last error description
+ */
+const dyn_string& DynLoader::GetLastError()
+{
+	static thread_local dyn_string lastError;
+
+	lastError.clear();
+
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+	LPSTR lpMsgBuf = nullptr;
+	const DWORD res = ::FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER|
+			FORMAT_MESSAGE_FROM_SYSTEM|FORMAT_MESSAGE_IGNORE_INSERTS,
+			nullptr, ::GetLastError(), 
+			MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+			lpMsgBuf, 0, nullptr);
+
+	if(res != 0)
+	{
+		lastError.assign(lpMsgBuf);
+		(void) ::LocalFree(lpMsgBuf);
+	}
+#elif PLATFORM_POSIX
+	const char* dlerr = ::dlerror();
+	if(dlerr != nullptr)
+		lastError.assign(dlerr);
+#endif
+
+	return lastError;
+}
+
+/**
+ * @brief Remove a library from the registry
+ * @param lib - [in] registered library
+ *
+ * The library keeps the reference of the registry, it is dropped by the
+ * caller once readers that found the library have left.
+ */
+void DynLoader::Unlink(DynLib& lib)
+{
+	LibRegistry* next = new LibRegistry(*libs.load(std::memory_order_relaxed));
+	next->Remove(&lib);
+	Publish(next);
+
+	lib.registered = false;
+	mappedBytes.fetch_sub(lib.MappedBytes(), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Drop one reference of each library, closing those left unused
+ * @param released - [in] libraries
+ */
+void DynLoader::DropReferences(const std::vector<DynLib*>& released)
+{
+	std::vector<DynLib*> unused;
+	for(auto lib : released)
+	{
+		if(lib->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			unused.push_back(lib);
+	}
+
+	if(unused.empty())
+		return;
+
+	// Handle releases racing with the last one may still read the library
+	epoch.Synchronize();
+
+	for(auto lib : unused)
+		Dispose(lib);
+}
+
+/**
+ * @brief Tear down a library no reader can reach anymore
+ * @param lib - [in] unused library
+ */
+void DynLoader::Dispose(DynLib* lib)
+{
+	Reclaimer* current = reclaimer.load(std::memory_order_acquire);
+	if(current != nullptr)
+		current->Submit(lib);
+	else
+		delete lib;
+}
+
+/**
+ * @brief Tear down unloaded libraries on a background thread
+ * @param queueLimit - [in] maximum number of libraries waiting for teardown
+ */
+void DynLoader::EnableBackgroundReclaim(size_t queueLimit)
+{
+	std::lock_guard<std::mutex> lock(writeMutex);
+
+	Reclaimer* current = reclaimer.load(std::memory_order_relaxed);
+	if(current != nullptr)
+		current->SetLimit(queueLimit);
+	else
+		reclaimer.store(new Reclaimer(queueLimit), std::memory_order_release);
+}
+
+/**
+ * @brief Wait until all unloaded libraries have been torn down
+ */
+void DynLoader::FlushReclaim()
+{
+	Reclaimer* current = reclaimer.load(std::memory_order_acquire);
+	if(current != nullptr)
+		current->Flush();
+}
+
+/**
+ * @brief Get the counters of the background reclaimer
+ * @return counters
+ */
+ReclaimStats DynLoader::GetReclaimStats()
+{
+	Reclaimer* current = reclaimer.load(std::memory_order_acquire);
+
+	return current != nullptr ? current->Stats() : ReclaimStats();
+}
+
+/**
+ * @brief Get the number of libraries the system loader failed to close
+ * @return failed closes
+ */
+uint64_t DynLoader::GetCloseFailures() const
+{
+	return closeFailures.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Get the latency histograms of the loader operations
+ * @return metrics snapshot
+ */
+DynStats DynLoader::GetStats()
+{
+	return stats.Snapshot();
+}
+
+/**
+ * @brief Turn recording of the latency histograms on or off
+ * @param on - [in] record latencies
+ */
+void DynLoader::SetStatsEnabled(bool on)
+{
+	stats.SetEnabled(on);
+}
+
+/**
+ * @brief Destroy the shared instance of a class of an unloaded library
+ * @param lib - [in] library being torn down
+ * @param entry - [in] class entry with an instance
+ */
+void DynLoader::DestroyInstance(DynLib& lib, DynClassEntry& entry)
+{
+	DynClass* instance = entry.instance.load(std::memory_order_relaxed);
+	const std::chrono::steady_clock::time_point start = EventStart();
+
+	DYN_PROBE3(destroy_start, lib.name.c_str(), entry.name.c_str(), instance);
+	{
+		DynStatsCollector::Timer timer(stats, DynMetric::Destroy);
+		instance->Destroy();
+	}
+	DYN_PROBE2(destroy_done, lib.name.c_str(), entry.name.c_str());
+
+	if(start != std::chrono::steady_clock::time_point())
+	{
+		DynEvent event(DynEventType::Destroy, start, lib.file.c_str(), lib.space, entry.name.c_str(), instance);
+		Notify(event);
+	}
+}
+
+/**
+ * @brief Close the system handle of a library being torn down
+ * @param lib - [in] library
+ * @return true on success
+ */
+bool DynLoader::CloseHandle(DynLib& lib)
+{
+	const std::chrono::steady_clock::time_point start = EventStart();
+	bool closed = false;
+
+	DYN_PROBE2(close_start, lib.name.c_str(), lib.handle);
+	{
+		DynStatsCollector::Timer timer(stats, DynMetric::Close);
+		closed =
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+				(::FreeLibrary(lib.handle) != FALSE);
+#elif PLATFORM_POSIX
+				(::dlclose(lib.handle) == 0);
+#endif
+	}
+	DYN_PROBE2(close_done, lib.name.c_str(), closed);
+
+	if(!closed)
+		closeFailures.fetch_add(1, std::memory_order_relaxed);
+
+	RecordUnload(lib);
+
+#if PLATFORM_POSIX
+	// The descriptor path names the module until it is unmapped
+	if(closed && lib.descriptor >= 0)
+	{
+		::close(lib.descriptor);
+		lib.descriptor = -1;
+	}
+#endif
+
+	if(start != std::chrono::steady_clock::time_point())
+	{
+		DynEvent event(DynEventType::Close, start, lib.file.c_str(), lib.space, nullptr, lib.handle, !closed);
+		Notify(event);
+	}
+
+	return closed;
+}
+
+/**
+ * @brief Close library once its handles are released
+ * @param lib - [in] unlinked library
+ * @return void
+ *
+ * Waits for concurrent readers to leave before the reference of the
+ * registry is dropped, so it must not be called while holding an epoch
+ * guard.
+ */
+void DynLoader::CloseLib(DynLib& lib)
+{
+	epoch.Synchronize();
+
+	DropReferences(std::vector<DynLib*>(1, &lib));
+}
+
+/**
+ * @brief Release a handle reference
+ * @param lib - [in] library referenced by the handle
+ *
+ * When only the reference of the registry is left and no raw pointers
+ * were handed out, the library is idle. Idle libraries are closed right
+ * away without a memory budget, otherwise they stay loaded until evicted.
+ */
+void DynLoader::ReleaseReference(DynLib* lib)
+{
+	const bool caching = memoryBudget.load(std::memory_order_relaxed) != 0;
+
+	size_t prev = 0;
+	bool unlinked = false;
+	{
+		// Keeps the library alive while it is inspected below
+		EpochDomain::Guard guard(epoch);
+
+		prev = lib->refs.fetch_sub(1, std::memory_order_acq_rel);
+		if(prev == 2)
+			lib->lastUse.store(Now(), std::memory_order_relaxed);
+
+		if(prev == 2 && !caching && !lib->pinned.load(std::memory_order_relaxed))
+		{
+			std::lock_guard<std::mutex> lock(writeMutex);
+
+			// A new handle may have been taken meanwhile
+			if(lib->registered && lib->refs.load(std::memory_order_relaxed) == 1)
+			{
+				Unlink(*lib);
+				unlinked = true;
+			}
+		}
+	}
+
+	if(prev == 1)
+	{
+		// Unlinked before, wait for releases racing with this one
+		epoch.Synchronize();
+		Dispose(lib);
+		return;
+	}
+
+	if(unlinked)
+		CloseIdle(std::vector<DynLib*>(1, lib));
+	else if(prev == 2 && caching)
+		ScheduleEviction();
+}
+
+/**
+ * @brief Close unlinked idle libraries, keeping those pinned meanwhile
+ * @param idle - [in] libraries unlinked for being idle
+ *
+ * Raw lookups that found a library before it was unlinked have pinned it
+ * once the readers left, such libraries are registered again.
+ */
+void DynLoader::CloseIdle(const std::vector<DynLib*>& idle)
+{
+	epoch.Synchronize();
+
+	std::vector<DynLib*> released;
+	for(auto lib : idle)
+	{
+		if(!lib->pinned.load(std::memory_order_relaxed))
+		{
+			released.push_back(lib);
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(writeMutex);
+
+		LibRegistry* current = libs.load(std::memory_order_relaxed);
+		if(current->Find(lib->id) == nullptr)
+		{
+			LibRegistry* next = new LibRegistry(*current);
+			next->Insert(lib);
+			lib->registered = true;
+			mappedBytes.fetch_add(lib->MappedBytes(), std::memory_order_relaxed);
+			Publish(next);
+		}
+		else
+		{
+			// The module was opened again meanwhile
+			detached.push_back(lib);
+		}
+	}
+
+	DropReferences(released);
+}
+
+/**
+ * @brief Evict idle libraries on a loader thread if over the budget
+ *
+ * At most one eviction is pending at a time.
+ */
+void DynLoader::ScheduleEviction()
+{
+	const size_t budget = memoryBudget.load(std::memory_order_relaxed);
+	if(budget == 0 || mappedBytes.load(std::memory_order_relaxed) <= budget)
+		return;
+
+	if(evictionPending.exchange(true, std::memory_order_acq_rel))
+		return;
+
+	RunInBackground([this]()
+	{
+		evictionPending.store(false, std::memory_order_release);
+
+		try
+		{
+			EvictIdle();
+		}
+		catch(...)
+		{
+			;;
+		}
+	});
+}
+
+/**
+ * @brief Run a task on a loader thread
+ * @param task - [in] task, must not throw
+ */
+void DynLoader::RunInBackground(std::function<void()> task)
+{
+	std::lock_guard<std::mutex> lock(asyncMutex);
+
+	if(!asyncPool)
+		asyncPool.reset(new WorkerPool());
+
+	asyncPool->Submit(std::move(task));
+}
+
+/**
+ * @brief Bind the remaining references of a lazily bound library
+ * @param lib - [in] registered library
+ *
+ * The library is looked up again on the loader thread, it may have been
+ * unloaded in between.
+ */
+void DynLoader::ScheduleBinding(DynLib& lib)
+{
+	const dyn_string libName = lib.name;
+	const DynNamespace space = lib.space;
+	DYN_HANDLE handle = lib.handle;
+
+	RunInBackground([this, libName, space, handle]()
+	{
+		EpochDomain::Guard guard(epoch);
+
+		DynLib* current = FindLib(space, libName);
+		if(current == nullptr || current->handle != handle)
+			return;
+
+		current->boundInBackground.fetch_add(BindLazySymbols(handle, current->options.deepBind),
+				std::memory_order_relaxed);
+	});
+}
+
+/**
+ * @brief Get the options a library is opened with
+ * @param libName - [in] library file name
+ * @return load options
+ */
+DynLoadOptions DynLoader::GetLoadOptions(const dyn_string& libName)
+{
+	std::lock_guard<std::mutex> lock(optionsMutex);
+
+	auto it = libraryOptions.find(libName);
+
+	return it != libraryOptions.end() ? it->second : loadOptions;
+}
+
+/**
+ * @brief Get the system loader's id of a namespace
+ * @param space - [in] namespace
+ * @return link-map list id, 0 for the base namespace
+ */
+long DynLoader::GetLinkMap(DynNamespace space)
+{
+	if(space == 0)
+		return 0;
+
+	std::lock_guard<std::mutex> lock(namespaceMutex);
+
+	if(space > namespaces.size())
+		throw LoaderException("Unknown namespace " + std::to_string(space));
+
+#ifdef LM_ID_NEWLM
+	Lmid_t linkMap = LM_ID_BASE;
+	if(::dlinfo(namespaces[space - 1], RTLD_DI_LMID, &linkMap) != 0)
+		throw LoaderException("Unable to query namespace: Error `" + GetLastError() + "`");
+
+	return static_cast<long>(linkMap);
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @brief Create a link-map namespace, e.g. for a tenant
+ * @return namespace
+ *
+ * The system loader drops a namespace with its last module and reuses its
+ * id, so a C library copy is kept open in it until the loader is destroyed.
+ */
+DynNamespace DynLoader::CreateNamespace()
+{
+#if defined(LM_ID_NEWLM) && defined(LIBC_SO)
+	DYN_HANDLE anchor = ::dlmopen(LM_ID_NEWLM, LIBC_SO, RTLD_NOW | RTLD_LOCAL);
+	if(anchor == nullptr)
+		throw LoaderException("Unable to create namespace: Error `" + GetLastError() + "`");
+
+	std::lock_guard<std::mutex> lock(namespaceMutex);
+
+	namespaces.push_back(anchor);
+
+	return static_cast<DynNamespace>(namespaces.size());
+#else
+	throw LoaderException("Library namespaces are not supported on this platform");
+#endif
+}
+
+/**
+ * @brief Set the options libraries are opened with
+ * @param options - [in] load options of libraries without own options
+ */
+void DynLoader::SetLoadOptions(const DynLoadOptions& options)
+{
+	std::lock_guard<std::mutex> lock(optionsMutex);
+	loadOptions = options;
+}
+
+/**
+ * @brief Set the options a library is opened with
+ * @param libName - [in] library file name
+ * @param options - [in] load options
+ */
+void DynLoader::SetLoadOptions(const dyn_string& libName, const DynLoadOptions& options)
+{
+	std::lock_guard<std::mutex> lock(optionsMutex);
+	libraryOptions[libName] = options;
+}
+
+/**
+ * @brief Keep idle libraries loaded within a memory budget
+ * @param bytes - [in] mapped size limit, SIZE_MAX for no limit, 0 to close
+ * idle libraries right away
+ */
+void DynLoader::SetMemoryBudget(size_t bytes)
+{
+	memoryBudget.store(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Unload least recently used idle libraries down to the budget
+ * @return number of unloaded libraries
+ */
+size_t DynLoader::EvictIdle()
+{
+	std::vector<DynLib*> evicted;
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+
+		const size_t budget = memoryBudget.load(std::memory_order_relaxed);
+		if(budget == 0 || mappedBytes.load(std::memory_order_relaxed) <= budget)
+			return 0;
+
+		// Instances outlive their handles, evicting would destroy them
+		std::vector<DynLib*> idle;
+		{
+			EpochDomain::Guard guard(epoch);
+
+			for(auto lib : libs.load(std::memory_order_relaxed)->Libraries())
+			{
+				if(!lib->pinned.load(std::memory_order_relaxed) && lib->refs.load(std::memory_order_relaxed) == 1 &&
+						!HasInstances(*lib))
+					idle.push_back(lib);
+			}
+		}
+
+		std::sort(idle.begin(), idle.end(), [](const DynLib* a, const DynLib* b)
+		{
+			return a->lastUse.load(std::memory_order_relaxed) < b->lastUse.load(std::memory_order_relaxed);
+		});
+
+		for(auto lib : idle)
+		{
+			if(mappedBytes.load(std::memory_order_relaxed) <= budget)
+				break;
+
+			Unlink(*lib);
+			evicted.push_back(lib);
+		}
+	}
+
+	if(!evicted.empty())
+		CloseIdle(evicted);
+
+	return evicted.size();
+}
+
+/**
+ * @brief Get memory use and activity of all loaded libraries
+ * @return one entry per library
+ */
+std::vector<LibraryUsage> DynLoader::GetLibraryUsage()
+{
+	const int64_t now = Now();
+
+	EpochDomain::Guard guard(epoch);
+
+	std::vector<LibraryUsage> usage;
+	for(auto lib : libs.load(std::memory_order_acquire)->Libraries())
+	{
+		LibraryUsage entry;
+		entry.textBytes = lib->textBytes;
+		entry.dataBytes = lib->dataBytes;
+		entry.bssBytes = lib->bssBytes;
+		entry.name = lib->name;
+		entry.space = lib->space;
+		entry.handles = lib->refs.load(std::memory_order_relaxed) - 1;
+		entry.boundInBackground = lib->boundInBackground.load(std::memory_order_relaxed);
+		entry.pinned = lib->pinned.load(std::memory_order_relaxed);
+		entry.idle = std::chrono::nanoseconds(now - lib->lastUse.load(std::memory_order_relaxed));
+
+		for(auto& cls : *lib->classes.load(std::memory_order_acquire))
+		{
+			if(cls.second->instance.load(std::memory_order_relaxed) != nullptr)
+				++entry.instances;
+		}
+
+		usage.push_back(entry);
+	}
+
+	return usage;
+}
+
+/**
+ * @brief Open the current file of a library under a distinct name
+ * @param space - [in] namespace
+ * @param libName - [in] library file name
+ * @return opened library, not registered yet
+ *
+ * The system loader returns the loaded module for a known file name, so
+ * the file is opened through a descriptor path. The descriptor stays open
+ * until the module is closed, a later reload can't get the same path
+ * while this one is loaded. Its device and inode tell the new file apart
+ * from the loaded one.
+ */
+std::unique_ptr<DynLib> DynLoader::OpenReplacement(DynNamespace space, const dyn_string& libName)
+{
+#if PLATFORM_POSIX
+	const int fd = ::open(libName.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		throw LoaderException("Could not open `" + libName + "` for reloading");
+
+	struct stat st;
+	if(::fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		throw LoaderException("Could not open `" + libName + "` for reloading");
+	}
+
+	std::unique_ptr<DynLib> opened;
+	try
+	{
+		opened.reset(new DynLib(libName, *this, GetLoadOptions(libName), "/proc/self/fd/" + std::to_string(fd),
+				space, GetLinkMap(space)));
+	}
+	catch(...)
+	{
+		::close(fd);
+		throw;
+	}
+
+	opened->descriptor = fd;
+	RecordCode(*opened, opened->file);
+
+	opened->id.device = static_cast<uint64_t>(st.st_dev);
+	opened->id.inode = static_cast<uint64_t>(st.st_ino);
+	opened->id.space = space;
+
+	return opened;
+#else
+	throw LoaderException("Reloading `" + libName + "` is not supported on this platform");
+#endif
+}
+
+/**
+ * @brief Load the current file of a library alongside the loaded one
+ * @param space - [in] namespace
+ * @param libName - [in] library file name
+ * @return false if the library is not loaded
+ *
+ * The replacement is opened, indexed and given its arena before it is
+ * published, requests keep using the old module until the registry is
+ * swapped.
+ */
+bool DynLoader::ReloadLib(DynNamespace space, const dyn_string& libName)
+{
+	{
+		EpochDomain::Guard guard(epoch);
+
+		if(FindLib(space, libName) == nullptr)
+			return false;
+	}
+
+	std::unique_ptr<DynLib> opened(OpenReplacement(space, libName));
+
+	MeasureSegments(*opened);
+	IndexClasses(*opened);
+	InstallArena(*opened);
+	opened->lastUse.store(Now(), std::memory_order_relaxed);
+
+	DynLib* old = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+
+		LibRegistry* current = libs.load(std::memory_order_relaxed);
+		old = current->Find(space, libName);
+		if(old == nullptr)
+			return false;
+
+		if(opened->id == old->id)
+			throw LoaderException("`" + libName + "` was modified in place and cannot be reloaded");
+
+		std::vector<dyn_string> aliases(old->aliases);
+
+		LibRegistry* next = new LibRegistry(*current);
+		next->Remove(old);
+		next->Insert(opened.get());
+		for(auto& alias : aliases)
+			next->AddAlias(alias, opened.get());
+
+		old->registered = false;
+		mappedBytes.fetch_sub(old->MappedBytes(), std::memory_order_relaxed);
+
+		opened->registered = true;
+		mappedBytes.fetch_add(opened->MappedBytes(), std::memory_order_relaxed);
+
+		Publish(next);
+		opened.release();
+	}
+
+	// Wait for requests still using the old module
+	epoch.Synchronize();
+
+	if(old->pinned.load(std::memory_order_relaxed))
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+		detached.push_back(old);
+	}
+	else
+	{
+		DropReferences(std::vector<DynLib*>(1, old));
+	}
+
+	ScheduleEviction();
+
+	return true;
+}
+
+/**
+ * @brief Unload a library copy of a namespace
+ * @param space - [in] namespace
+ * @param libName - [in] library file name
+ * @return false if the library is not loaded
+ */
+bool DynLoader::UnloadLib(DynNamespace space, const dyn_string& libName)
+{
+	DynLib* lib = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+
+		LibRegistry* current = libs.load(std::memory_order_relaxed);
+		lib = current->Find(space, libName);
+
+		DynLibId id;
+		id.space = space;
+		if(lib == nullptr && LibRegistry::IdentifyPath(libName, id))
+			lib = current->Find(id);
+
+		if(lib == nullptr)
+			return false;
+
+		Unlink(*lib);
+	}
+
+	CloseLib(*lib);
+
+	return true;
+}
+
+/**
+ * @brief Get symbol by name
+ * @param symbolName - [in] symbol name
+ * @return pointer to symbol, 0 if not found
+ */
+DYN_SYMBOL DynLoader::GetSymbolByName(DynLib& lib, const DYN_CHAR * symbolName)
+{
+	const std::chrono::steady_clock::time_point start = EventStart();
+	DYN_SYMBOL symbol = nullptr;
+	{
+		DynStatsCollector::Timer timer(stats, DynMetric::Symbol);
+
+		symbol =
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+			reinterpret_cast<void *>(::GetProcAddress(lib.handle, symbolName));
+#elif PLATFORM_POSIX
+			::dlsym(lib.handle, symbolName);
+#endif
+	}
+
+	DYN_PROBE3(resolve, lib.name.c_str(), symbolName, symbol);
+	if(start != std::chrono::steady_clock::time_point())
+	{
+		DynEvent event(DynEventType::Resolve, start, lib.file.c_str(), lib.space, symbolName, symbol,
+				symbol == nullptr);
+		Notify(event);
+	}
+
+	return symbol;
+}
+
+/**
+ * @brief Get a symbol defined by the module itself
+ * @param lib - [in] library
+ * @param symbolName - [in] symbol name
+ * @return pointer to symbol, nullptr if not found or only defined by a
+ * dependency of the module
+ *
+ * Lookups through a handle also search the module's dependencies, which
+ * may export the same optional entry points.
+ */
+DYN_SYMBOL DynLoader::GetModuleSymbol(DynLib& lib, const DYN_CHAR* symbolName)
+{
+	DYN_SYMBOL symbol = GetSymbolByName(lib, symbolName);
+
+#if PLATFORM_POSIX
+	struct link_map* map = nullptr;
+	Dl_info info;
+	if(symbol == nullptr || ::dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) != 0 || map == nullptr ||
+			::dladdr(symbol, &info) == 0 || info.dli_fname == nullptr || map->l_name == nullptr ||
+			std::strcmp(info.dli_fname, map->l_name) != 0)
+		return nullptr;
+#endif
+
+	return symbol;
+}
+
+/**
+ * @brief Reset the dynamic loader
+ * Free all libraries and set initial state
+ */
+void DynLoader::Reset()
+{
+	std::vector<DynLib*> loaded;
+
+	{
+		std::lock_guard<std::mutex> lock(writeMutex);
+
+		LibRegistry* current = libs.load(std::memory_order_relaxed);
+		loaded = current->Libraries();
+		for(auto lib : loaded)
+		{
+			lib->registered = false;
+			mappedBytes.fetch_sub(lib->MappedBytes(), std::memory_order_relaxed);
+		}
+
+		if(!loaded.empty())
+		{
+			LibRegistry* next = new LibRegistry(*current);
+			next->Clear();
+			Publish(next);
+		}
+
+		loaded.insert(loaded.end(), detached.begin(), detached.end());
+		detached.clear();
+	}
+
+	if(loaded.empty())
+		return;
+
+	// Wait for readers still holding the old registry
+	epoch.Synchronize();
+
+	// Free all libraries without handles, the others are freed with
+	// their last handle
+	DropReferences(loaded);
+}
+
+/**
+ * @brief Destroy the dynamic loader
+ * Dynamic loader shutdown routine
+ */
+void DynLoader::Destroy()
+{
+	delete this;
+}
+
+} // namespace DynLoader
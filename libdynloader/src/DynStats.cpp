@@ -0,0 +1,352 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <DynStats.hpp>
+
+#include <algorithm>
+#include <cstdio>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+namespace
+{
+
+/* @brief Source of unique collector serial numbers */
+std::atomic<uint64_t> collectorSerial(0);
+
+/* @brief Last shard used by this thread */
+struct LocalCache
+{
+	uint64_t serial;
+	void* shard;
+};
+
+thread_local LocalCache localCache = { 0, nullptr };
+
+/**
+ * @brief Append formatted text
+ */
+template<typename... Args>
+void Append(dyn_string& text, const char* format, Args... args)
+{
+	char line[256];
+	const int length = std::snprintf(line, sizeof(line), format, args...);
+	if(length > 0)
+		text.append(line, std::min(static_cast<size_t>(length), sizeof(line) - 1));
+}
+
+} // anonymous namespace
+
+const size_t DynHistogram::Buckets;
+const unsigned DynStatsCollector::SampleInterval;
+
+DynHistogram::DynHistogram() : count(0), samples(0), total(0), max(0), buckets()
+{
+}
+
+/**
+ * @brief Get the bucket of a duration
+ * @param duration - [in] duration
+ * @return bucket index
+ */
+size_t DynHistogram::Bucket(std::chrono::nanoseconds duration)
+{
+	uint64_t ns = duration.count() > 1 ? static_cast<uint64_t>(duration.count()) : 1;
+
+#if defined(__GNUC__)
+	const size_t bucket = 63 - static_cast<size_t>(__builtin_clzll(ns));
+#else
+	size_t bucket = 0;
+	while(ns > 1)
+	{
+		ns >>= 1;
+		++bucket;
+	}
+#endif
+
+	return std::min(bucket, Buckets - 1);
+}
+
+/**
+ * @brief Get the mean duration of the samples
+ * @return mean duration, zero if empty
+ */
+std::chrono::nanoseconds DynHistogram::Mean() const
+{
+	return samples != 0 ? total / static_cast<int64_t>(samples) : std::chrono::nanoseconds(0);
+}
+
+/**
+ * @brief Get an upper bound of a percentile
+ * @param percent - [in] percentile, between 0 and 100
+ * @return upper bound of the bucket holding the percentile, at most the
+ * maximum, zero if empty
+ */
+std::chrono::nanoseconds DynHistogram::Percentile(double percent) const
+{
+	if(samples == 0)
+		return std::chrono::nanoseconds(0);
+
+	const double rank = percent / 100.0 * static_cast<double>(samples);
+	uint64_t seen = 0;
+	for(size_t i = 0; i < Buckets - 1; ++i)
+	{
+		seen += buckets[i];
+		if(seen != 0 && static_cast<double>(seen) >= rank)
+			return std::min(std::chrono::nanoseconds(int64_t(2) << i), max);
+	}
+
+	return max;
+}
+
+DynStats::DynStats() : metrics(), threads(0)
+{
+}
+
+/**
+ * @brief Get the name of a metric used by the dumps
+ * @param metric - [in] metric
+ * @return metric name
+ */
+const char* DynStats::MetricName(DynMetric metric)
+{
+	switch(metric)
+	{
+	case DynMetric::Open:
+		return "open";
+	case DynMetric::Symbol:
+		return "symbol";
+	case DynMetric::InstanceHit:
+		return "instance_hit";
+	case DynMetric::InstanceMiss:
+		return "instance_miss";
+	case DynMetric::Construct:
+		return "construct";
+	case DynMetric::Destroy:
+		return "destroy";
+	case DynMetric::Close:
+		return "close";
+	}
+
+	return "unknown";
+}
+
+/**
+ * @brief Dump as a JSON object, one member per metric
+ * @return JSON text
+ *
+ * Durations are in nanoseconds, buckets are listed up to the last
+ * non-empty one.
+ */
+dyn_string DynStats::ToJson() const
+{
+	dyn_string json;
+	Append(json, "{\"threads\":%zu", threads);
+
+	for(size_t m = 0; m < DynMetricCount; ++m)
+	{
+		const DynHistogram& histogram = metrics[m];
+		Append(json, ",\"%s\":{\"count\":%llu,\"samples\":%llu,\"total_ns\":%lld,\"max_ns\":%lld,"
+				"\"p50_ns\":%lld,\"p99_ns\":%lld,\"buckets\":[",
+				MetricName(static_cast<DynMetric>(m)),
+				static_cast<unsigned long long>(histogram.count),
+				static_cast<unsigned long long>(histogram.samples),
+				static_cast<long long>(histogram.total.count()),
+				static_cast<long long>(histogram.max.count()),
+				static_cast<long long>(histogram.Percentile(50).count()),
+				static_cast<long long>(histogram.Percentile(99).count()));
+
+		size_t used = DynHistogram::Buckets;
+		while(used > 0 && histogram.buckets[used - 1] == 0)
+			--used;
+
+		for(size_t i = 0; i < used; ++i)
+			Append(json, i == 0 ? "%llu" : ",%llu", static_cast<unsigned long long>(histogram.buckets[i]));
+
+		json += "]}";
+	}
+
+	json += "}";
+
+	return json;
+}
+
+/**
+ * @brief Dump as a table, one line per metric
+ * @return text
+ */
+dyn_string DynStats::ToText() const
+{
+	dyn_string text;
+	Append(text, "%-14s %10s %12s %12s %12s %12s\n", "metric", "count", "mean ns", "p50 ns", "p99 ns", "max ns");
+
+	for(size_t m = 0; m < DynMetricCount; ++m)
+	{
+		const DynHistogram& histogram = metrics[m];
+		Append(text, "%-14s %10llu %12lld %12lld %12lld %12lld\n",
+				MetricName(static_cast<DynMetric>(m)),
+				static_cast<unsigned long long>(histogram.count),
+				static_cast<long long>(histogram.Mean().count()),
+				static_cast<long long>(histogram.Percentile(50).count()),
+				static_cast<long long>(histogram.Percentile(99).count()),
+				static_cast<long long>(histogram.max.count()));
+	}
+
+	return text;
+}
+
+DynStatsCollector::DynStatsCollector() :
+		enabled(true), shards(nullptr), serial(++collectorSerial)
+{
+}
+
+DynStatsCollector::~DynStatsCollector()
+{
+	Shard* shard = shards.load();
+	while(shard != nullptr)
+	{
+		Shard* next = shard->next;
+		delete shard;
+		shard = next;
+	}
+}
+
+/**
+ * @brief Get the shard of the calling thread
+ * @return shard
+ *
+ * Shards are never released while the collector lives. A thread that
+ * exits leaves its counts behind and a later thread with the same id
+ * adds to them.
+ */
+DynStatsCollector::Shard* DynStatsCollector::LocalShard()
+{
+	if(localCache.serial == serial)
+		return static_cast<Shard*>(localCache.shard);
+
+	const std::thread::id self = std::this_thread::get_id();
+
+	Shard* shard = shards.load(std::memory_order_acquire);
+	while(shard != nullptr && shard->owner != self)
+		shard = shard->next;
+
+	if(shard == nullptr)
+	{
+		shard = new Shard();
+		Shard* head = shards.load(std::memory_order_relaxed);
+		do
+		{
+			shard->next = head;
+		}
+		while(!shards.compare_exchange_weak(head, shard,
+				std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	localCache.serial = serial;
+	localCache.shard = shard;
+
+	return shard;
+}
+
+/**
+ * @brief Turn recording on or off
+ * @param on - [in] record durations
+ */
+void DynStatsCollector::SetEnabled(bool on)
+{
+	enabled.store(on, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Record a duration
+ * @param metric - [in] metric
+ * @param duration - [in] duration
+ */
+void DynStatsCollector::Record(DynMetric metric, std::chrono::nanoseconds duration)
+{
+	Record(*LocalShard(), metric, duration);
+}
+
+/**
+ * @brief Record a duration
+ * @param shard - [in] shard of the calling thread
+ * @param metric - [in] metric
+ * @param duration - [in] duration
+ *
+ * Only the owning thread writes a shard, plain loads and stores suffice.
+ */
+void DynStatsCollector::Record(Shard& shard, DynMetric metric, std::chrono::nanoseconds duration)
+{
+	Shard::Histogram& histogram = shard.metrics[static_cast<size_t>(metric)];
+	const uint64_t ns = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+
+	histogram.count.store(histogram.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	histogram.samples.store(histogram.samples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	histogram.total.store(histogram.total.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+	if(ns > histogram.max.load(std::memory_order_relaxed))
+		histogram.max.store(ns, std::memory_order_relaxed);
+
+	std::atomic<uint64_t>& bucket = histogram.buckets[DynHistogram::Bucket(duration)];
+	bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Add up the histograms of all threads
+ * @return metrics snapshot
+ */
+DynStats DynStatsCollector::Snapshot() const
+{
+	DynStats stats;
+
+	for(Shard* shard = shards.load(std::memory_order_acquire); shard != nullptr; shard = shard->next)
+	{
+		++stats.threads;
+
+		for(size_t m = 0; m < DynMetricCount; ++m)
+		{
+			const Shard::Histogram& source = shard->metrics[m];
+			DynHistogram& target = stats.metrics[m];
+
+			target.count += source.count.load(std::memory_order_relaxed);
+			target.samples += source.samples.load(std::memory_order_relaxed);
+			target.total += std::chrono::nanoseconds(source.total.load(std::memory_order_relaxed));
+			target.max = std::max(target.max, std::chrono::nanoseconds(source.max.load(std::memory_order_relaxed)));
+			for(size_t i = 0; i < DynHistogram::Buckets; ++i)
+				target.buckets[i] += source.buckets[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	return stats;
+}
+
+} // namespace DynLoader
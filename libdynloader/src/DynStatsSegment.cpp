@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <DynStatsSegment.hpp>
+#include <LoaderException.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+
+#if PLATFORM_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+namespace
+{
+
+const char SegmentMagic[8] = { 'D', 'Y', 'N', 'S', 'T', 'A', 'T', 'S' };
+const uint32_t SegmentVersion = 1;
+
+} // anonymous namespace
+
+/**
+ * @brief Create or map a segment
+ * @param name - [in] shared memory object name
+ * @param access - [in] create the segment or map an existing one
+ *
+ * A published segment replaces an older one of the same name.
+ */
+DynStatsSegment::DynStatsSegment(const dyn_string& name, DynSegmentAccess access) :
+		layout(nullptr), name(name), access(access), creator(0)
+{
+#if PLATFORM_POSIX
+	const bool publish = access == DynSegmentAccess::Publish;
+
+	const int fd = ::shm_open(name.c_str(), publish ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+	if(fd < 0)
+		throw LoaderException("Unable to open stats segment `" + name + "`: " + std::strerror(errno));
+
+	struct stat info;
+	const bool sized = publish ? ::ftruncate(fd, sizeof(DynSegmentLayout)) == 0 :
+			::fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(DynSegmentLayout);
+
+	void* mapping = sized ? ::mmap(nullptr, sizeof(DynSegmentLayout), publish ? PROT_READ | PROT_WRITE : PROT_READ,
+			MAP_SHARED, fd, 0) : MAP_FAILED;
+	const int error = errno;
+	::close(fd);
+
+	if(mapping == MAP_FAILED)
+	{
+		if(publish)
+			::shm_unlink(name.c_str());
+
+		throw LoaderException("Unable to map stats segment `" + name + "`: " +
+				(sized ? std::strerror(error) : "wrong size"));
+	}
+
+	layout = static_cast<DynSegmentLayout*>(mapping);
+
+	if(publish)
+	{
+		// New pages are zeroed, the data is empty until the first Write()
+		creator = static_cast<long>(::getpid());
+		new(&layout->sequence) std::atomic<uint64_t>(0);
+		layout->version = SegmentVersion;
+		layout->size = sizeof(DynSegmentData);
+		std::memcpy(layout->magic, SegmentMagic, sizeof(SegmentMagic));
+	}
+	else if(std::memcmp(layout->magic, SegmentMagic, sizeof(SegmentMagic)) != 0 ||
+			layout->version != SegmentVersion || layout->size != sizeof(DynSegmentData))
+	{
+		::munmap(layout, sizeof(DynSegmentLayout));
+		throw LoaderException("`" + name + "` is not a stats segment of this version");
+	}
+#else
+	throw LoaderException("Stats segments are not supported on this platform");
+#endif
+}
+
+/**
+ * @brief Unmap the segment, the creating process also removes it
+ *
+ * Forked children inherit the mapping but leave the segment to the parent.
+ */
+DynStatsSegment::~DynStatsSegment()
+{
+#if PLATFORM_POSIX
+	::munmap(layout, sizeof(DynSegmentLayout));
+
+	if(access == DynSegmentAccess::Publish && creator == static_cast<long>(::getpid()))
+		::shm_unlink(name.c_str());
+#endif
+}
+
+/**
+ * @brief Get the segment name a process publishes to by default
+ * @param pid - [in] process id
+ * @return shared memory object name
+ */
+dyn_string DynStatsSegment::DefaultName(long pid)
+{
+	return "/dynloader." + std::to_string(pid);
+}
+
+/**
+ * @brief Replace the data of a published segment
+ * @param data - [in] new contents
+ *
+ * Must only be called by one thread at a time.
+ */
+void DynStatsSegment::Write(const DynSegmentData& data)
+{
+	if(access != DynSegmentAccess::Publish)
+		throw LoaderException("Stats segment `" + name + "` is read-only");
+
+	const uint64_t sequence = layout->sequence.load(std::memory_order_relaxed);
+	layout->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	std::memcpy(&layout->data, &data, sizeof(data));
+
+	layout->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+/**
+ * @brief Copy a consistent version of the data
+ * @param data - [out] contents
+ * @param retries - [in] attempts while the writer is busy
+ * @return false if every attempt overlapped an update
+ */
+bool DynStatsSegment::Read(DynSegmentData& data, unsigned retries) const
+{
+	for(unsigned attempt = 0; attempt <= retries; ++attempt)
+	{
+		const uint64_t before = layout->sequence.load(std::memory_order_acquire);
+		if(before & 1)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::memcpy(&data, &layout->data, sizeof(data));
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if(layout->sequence.load(std::memory_order_relaxed) == before)
+			return true;
+	}
+
+	return false;
+}
+
+} // namespace DynLoader
@@ -0,0 +1,595 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <ElfScanner.hpp>
+
+#include "Directory.hpp"
+#include "MappedFile.hpp"
+
+#include <cstring>
+
+#if PLATFORM_POSIX
+#include <elf.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+#if PLATFORM_POSIX
+
+namespace
+{
+
+/* @brief Symbol prefix of the factories emitted by EXPORT_DYNCLASS */
+const char FactoryPrefix[] = "Create";
+const size_t FactoryPrefixLength = sizeof(FactoryPrefix) - 1;
+
+/* @brief ELF structures of 32 bit modules */
+struct Elf32
+{
+	typedef Elf32_Ehdr Ehdr;
+	typedef Elf32_Shdr Shdr;
+	typedef Elf32_Phdr Phdr;
+	typedef Elf32_Sym Sym;
+	typedef Elf32_Dyn Dyn;
+	typedef Elf32_Addr Addr;
+};
+
+/* @brief ELF structures of 64 bit modules */
+struct Elf64
+{
+	typedef Elf64_Ehdr Ehdr;
+	typedef Elf64_Shdr Shdr;
+	typedef Elf64_Phdr Phdr;
+	typedef Elf64_Sym Sym;
+	typedef Elf64_Dyn Dyn;
+	typedef Elf64_Addr Addr;
+};
+
+/**
+ * @brief Map a virtual address of a module back to the file
+ * @param phdrs - [in] program headers
+ * @param count - [in] number of program headers
+ * @param address - [in] virtual address
+ * @param offset - [out] file offset
+ * @return false if the address is not backed by the file
+ */
+template<typename Elf>
+bool FileOffset(const typename Elf::Phdr* phdrs, unsigned count, uint64_t address, uint64_t& offset)
+{
+	for(unsigned i = 0; i < count; ++i)
+	{
+		const typename Elf::Phdr& phdr = phdrs[i];
+		if(phdr.p_type == PT_LOAD && address >= phdr.p_vaddr && address - phdr.p_vaddr < phdr.p_filesz)
+		{
+			offset = phdr.p_offset + (address - phdr.p_vaddr);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Visit the factories of a dynamic symbol table
+ * @param file - [in] mapped module
+ * @param symOffset - [in] file offset of the symbol table
+ * @param symCount - [in] number of symbols
+ * @param strOffset - [in] file offset of the string table
+ * @param strSize - [in] size of the string table
+ * @param visitor - [in] callback for every exported class
+ * @return false if the tables are outside the file
+ */
+template<typename Elf>
+bool VisitSymbols(const MappedFile& file, uint64_t symOffset, uint64_t symCount,
+		uint64_t strOffset, uint64_t strSize, const ElfScanner::ExportVisitor& visitor)
+{
+	const typename Elf::Sym* syms = file.template At<typename Elf::Sym>(symOffset, symCount);
+	const char* strings = file.template At<char>(strOffset, strSize);
+	if(syms == nullptr || strings == nullptr)
+		return false;
+
+	// Symbol 0 is always the undefined symbol
+	for(uint64_t i = 1; i < symCount; ++i)
+	{
+		const typename Elf::Sym& sym = syms[i];
+
+		// The info and visibility encodings are the same for both classes
+		if(sym.st_shndx == SHN_UNDEF || ELF64_ST_TYPE(sym.st_info) != STT_FUNC ||
+				ELF64_ST_VISIBILITY(sym.st_other) != STV_DEFAULT)
+			continue;
+
+		const unsigned bind = ELF64_ST_BIND(sym.st_info);
+		if((bind != STB_GLOBAL && bind != STB_WEAK) || sym.st_name >= strSize)
+			continue;
+
+		const char* name = strings + sym.st_name;
+		const size_t length = ::strnlen(name, static_cast<size_t>(strSize - sym.st_name));
+		if(length <= FactoryPrefixLength || length == strSize - sym.st_name ||
+				std::memcmp(name, FactoryPrefix, FactoryPrefixLength) != 0)
+			continue;
+
+		visitor(name + FactoryPrefixLength, length - FactoryPrefixLength);
+	}
+
+	return true;
+}
+
+/**
+ * @brief Visit the factories using the section headers
+ * @param file - [in] mapped module
+ * @param visitor - [in] callback for every exported class
+ * @return false if the module has no usable .dynsym section
+ */
+template<typename Elf>
+bool ScanSections(const MappedFile& file, const ElfScanner::ExportVisitor& visitor)
+{
+	const typename Elf::Ehdr* ehdr = file.template At<typename Elf::Ehdr>(0);
+	if(ehdr->e_shoff == 0 || ehdr->e_shnum == 0 || ehdr->e_shentsize != sizeof(typename Elf::Shdr))
+		return false;
+
+	const typename Elf::Shdr* shdrs = file.template At<typename Elf::Shdr>(ehdr->e_shoff, ehdr->e_shnum);
+	if(shdrs == nullptr)
+		return false;
+
+	for(unsigned i = 0; i < ehdr->e_shnum; ++i)
+	{
+		const typename Elf::Shdr& dynsym = shdrs[i];
+		if(dynsym.sh_type != SHT_DYNSYM || dynsym.sh_entsize != sizeof(typename Elf::Sym) ||
+				dynsym.sh_link >= ehdr->e_shnum)
+			continue;
+
+		const typename Elf::Shdr& dynstr = shdrs[dynsym.sh_link];
+
+		return VisitSymbols<Elf>(file, dynsym.sh_offset, dynsym.sh_size / dynsym.sh_entsize,
+				dynstr.sh_offset, dynstr.sh_size, visitor);
+	}
+
+	return false;
+}
+
+/**
+ * @brief Count the dynamic symbols from a .gnu.hash table
+ * @param file - [in] mapped module
+ * @param offset - [in] file offset of the hash table
+ * @param count - [out] number of symbols
+ * @return false if the table is outside the file
+ *
+ * Only the symbols up to the last one in a hash chain are listed, the
+ * undefined symbols before symoffset are counted but never exported.
+ */
+template<typename Elf>
+bool CountGnuHashSymbols(const MappedFile& file, uint64_t offset, uint64_t& count)
+{
+	const uint32_t* header = file.template At<uint32_t>(offset, 4);
+	if(header == nullptr)
+		return false;
+
+	const uint32_t bucketCount = header[0];
+	const uint32_t symOffset = header[1];
+	const uint64_t bloomSize = header[2];
+
+	const uint64_t bucketOffset = offset + 4 * sizeof(uint32_t) + bloomSize * sizeof(typename Elf::Addr);
+	const uint32_t* buckets = file.template At<uint32_t>(bucketOffset, bucketCount);
+	if(buckets == nullptr)
+		return false;
+
+	uint32_t last = 0;
+	for(uint32_t i = 0; i < bucketCount; ++i)
+	{
+		if(buckets[i] > last)
+			last = buckets[i];
+	}
+
+	if(last < symOffset)
+	{
+		count = symOffset;
+		return true;
+	}
+
+	// Walk the chain of the highest bucket up to its terminating entry
+	const uint64_t chainOffset = bucketOffset + uint64_t(bucketCount) * sizeof(uint32_t);
+	for(;;)
+	{
+		const uint32_t* chain = file.template At<uint32_t>(chainOffset + uint64_t(last - symOffset) * sizeof(uint32_t));
+		if(chain == nullptr)
+			return false;
+		if(*chain & 1)
+			break;
+		++last;
+	}
+
+	count = uint64_t(last) + 1;
+
+	return true;
+}
+
+/**
+ * @brief Visit the factories using the dynamic segment
+ * @param file - [in] mapped module
+ * @param visitor - [in] callback for every exported class
+ * @return false if the module has no usable dynamic segment
+ *
+ * This is what the system loader itself reads, it also works for modules
+ * whose section headers were stripped.
+ */
+template<typename Elf>
+bool ScanDynamic(const MappedFile& file, const ElfScanner::ExportVisitor& visitor)
+{
+	const typename Elf::Ehdr* ehdr = file.template At<typename Elf::Ehdr>(0);
+	if(ehdr->e_phentsize != sizeof(typename Elf::Phdr))
+		return false;
+
+	const typename Elf::Phdr* phdrs = file.template At<typename Elf::Phdr>(ehdr->e_phoff, ehdr->e_phnum);
+	if(phdrs == nullptr)
+		return false;
+
+	auto toOffset = [phdrs, ehdr](uint64_t address, uint64_t& offset)
+	{
+		return FileOffset<Elf>(phdrs, ehdr->e_phnum, address, offset);
+	};
+
+	for(unsigned i = 0; i < ehdr->e_phnum; ++i)
+	{
+		if(phdrs[i].p_type != PT_DYNAMIC)
+			continue;
+
+		const uint64_t dynCount = phdrs[i].p_filesz / sizeof(typename Elf::Dyn);
+		const typename Elf::Dyn* dyn = file.template At<typename Elf::Dyn>(phdrs[i].p_offset, dynCount);
+		if(dyn == nullptr)
+			return false;
+
+		uint64_t symtab = 0, strtab = 0, strSize = 0, hash = 0, gnuHash = 0;
+		for(uint64_t j = 0; j < dynCount && dyn[j].d_tag != DT_NULL; ++j)
+		{
+			switch(dyn[j].d_tag)
+			{
+			case DT_SYMTAB: symtab = dyn[j].d_un.d_ptr; break;
+			case DT_STRTAB: strtab = dyn[j].d_un.d_ptr; break;
+			case DT_STRSZ: strSize = dyn[j].d_un.d_val; break;
+			case DT_HASH: hash = dyn[j].d_un.d_ptr; break;
+			case DT_GNU_HASH: gnuHash = dyn[j].d_un.d_ptr; break;
+			default: break;
+			}
+		}
+
+		uint64_t symOffset = 0, strOffset = 0, hashOffset = 0, symCount = 0;
+		if(!toOffset(symtab, symOffset) || !toOffset(strtab, strOffset))
+			return false;
+
+		if(gnuHash != 0 && toOffset(gnuHash, hashOffset))
+		{
+			if(!CountGnuHashSymbols<Elf>(file, hashOffset, symCount))
+				return false;
+		}
+		else if(hash != 0 && toOffset(hash, hashOffset))
+		{
+			// nchain of the SysV hash table equals the number of symbols
+			const uint32_t* header = file.template At<uint32_t>(hashOffset, 2);
+			if(header == nullptr)
+				return false;
+			symCount = header[1];
+		}
+		else
+			return false;
+
+		return VisitSymbols<Elf>(file, symOffset, symCount, strOffset, strSize, visitor);
+	}
+
+	return false;
+}
+
+/**
+ * @brief Read the dependencies and the soname of a mapped module
+ * @param file - [in] mapped module
+ * @param needed - [out] names of the needed libraries are appended
+ * @param soname - [out] soname, empty if the module has none
+ * @return false if the module has no usable dynamic segment
+ */
+template<typename Elf>
+bool ReadDependencies(const MappedFile& file, std::vector<dyn_string>& needed, dyn_string& soname)
+{
+	const typename Elf::Ehdr* ehdr = file.template At<typename Elf::Ehdr>(0);
+	if(ehdr == nullptr || ehdr->e_type != ET_DYN || ehdr->e_phentsize != sizeof(typename Elf::Phdr))
+		return false;
+
+	const typename Elf::Phdr* phdrs = file.template At<typename Elf::Phdr>(ehdr->e_phoff, ehdr->e_phnum);
+	if(phdrs == nullptr)
+		return false;
+
+	for(unsigned i = 0; i < ehdr->e_phnum; ++i)
+	{
+		if(phdrs[i].p_type != PT_DYNAMIC)
+			continue;
+
+		const uint64_t dynCount = phdrs[i].p_filesz / sizeof(typename Elf::Dyn);
+		const typename Elf::Dyn* dyn = file.template At<typename Elf::Dyn>(phdrs[i].p_offset, dynCount);
+		if(dyn == nullptr)
+			return false;
+
+		uint64_t strtab = 0, strSize = 0, strOffset = 0;
+		for(uint64_t j = 0; j < dynCount && dyn[j].d_tag != DT_NULL; ++j)
+		{
+			if(dyn[j].d_tag == DT_STRTAB)
+				strtab = dyn[j].d_un.d_ptr;
+			else if(dyn[j].d_tag == DT_STRSZ)
+				strSize = dyn[j].d_un.d_val;
+		}
+
+		const char* strings = nullptr;
+		if(FileOffset<Elf>(phdrs, ehdr->e_phnum, strtab, strOffset))
+			strings = file.template At<char>(strOffset, strSize);
+		if(strings == nullptr)
+			return false;
+
+		// Names are offsets into the string table
+		for(uint64_t j = 0; j < dynCount && dyn[j].d_tag != DT_NULL; ++j)
+		{
+			if((dyn[j].d_tag != DT_NEEDED && dyn[j].d_tag != DT_SONAME) || dyn[j].d_un.d_val >= strSize)
+				continue;
+
+			const char* name = strings + dyn[j].d_un.d_val;
+			const dyn_string value(name, ::strnlen(name, static_cast<size_t>(strSize - dyn[j].d_un.d_val)));
+			if(dyn[j].d_tag == DT_NEEDED)
+				needed.push_back(value);
+			else
+				soname = value;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Visit the factories of a mapped module
+ * @param file - [in] mapped module
+ * @param visitor - [in] callback for every exported class
+ * @return false if the module is not a shared object
+ */
+template<typename Elf>
+bool ScanImage(const MappedFile& file, const ElfScanner::ExportVisitor& visitor)
+{
+	const typename Elf::Ehdr* ehdr = file.template At<typename Elf::Ehdr>(0);
+	if(ehdr == nullptr || ehdr->e_type != ET_DYN)
+		return false;
+
+	return ScanSections<Elf>(file, visitor) || ScanDynamic<Elf>(file, visitor);
+}
+
+/**
+ * @brief Visit the functions of a mapped module
+ * @param file - [in] mapped module
+ * @param visitor - [in] callback for every function
+ * @return false if the module has no symbol table
+ *
+ * The full .symtab is used when the module was not stripped, it also
+ * names the local functions. Otherwise only the .dynsym is left.
+ */
+template<typename Elf>
+bool VisitFunctions(const MappedFile& file, const ElfScanner::FunctionVisitor& visitor)
+{
+	const typename Elf::Ehdr* ehdr = file.template At<typename Elf::Ehdr>(0);
+	if(ehdr == nullptr || ehdr->e_type != ET_DYN || ehdr->e_shoff == 0 ||
+			ehdr->e_shentsize != sizeof(typename Elf::Shdr))
+		return false;
+
+	const typename Elf::Shdr* shdrs = file.template At<typename Elf::Shdr>(ehdr->e_shoff, ehdr->e_shnum);
+	if(shdrs == nullptr)
+		return false;
+
+	const typename Elf::Shdr* symtab = nullptr;
+	for(unsigned i = 0; i < ehdr->e_shnum; ++i)
+	{
+		const typename Elf::Shdr& shdr = shdrs[i];
+		if((shdr.sh_type != SHT_SYMTAB && shdr.sh_type != SHT_DYNSYM) ||
+				shdr.sh_entsize != sizeof(typename Elf::Sym) || shdr.sh_link >= ehdr->e_shnum)
+			continue;
+
+		if(symtab == nullptr || shdr.sh_type == SHT_SYMTAB)
+			symtab = &shdr;
+	}
+
+	if(symtab == nullptr)
+		return false;
+
+	const typename Elf::Shdr& strtab = shdrs[symtab->sh_link];
+	const uint64_t symCount = symtab->sh_size / symtab->sh_entsize;
+	const typename Elf::Sym* syms = file.template At<typename Elf::Sym>(symtab->sh_offset, symCount);
+	const char* strings = file.template At<char>(strtab.sh_offset, strtab.sh_size);
+	if(syms == nullptr || strings == nullptr)
+		return false;
+
+	for(uint64_t i = 1; i < symCount; ++i)
+	{
+		const typename Elf::Sym& sym = syms[i];
+		if(sym.st_shndx == SHN_UNDEF || sym.st_shndx >= SHN_LORESERVE || sym.st_size == 0 ||
+				ELF64_ST_TYPE(sym.st_info) != STT_FUNC || sym.st_name >= strtab.sh_size)
+			continue;
+
+		const char* name = strings + sym.st_name;
+		const size_t length = ::strnlen(name, static_cast<size_t>(strtab.sh_size - sym.st_name));
+		if(length == 0 || length == strtab.sh_size - sym.st_name)
+			continue;
+
+		visitor(name, length, sym.st_value, sym.st_size);
+	}
+
+	return true;
+}
+
+/**
+ * @brief Get the class of an ELF file in the byte order of the host
+ * @param file - [in] mapped file
+ * @return ELFCLASS32 or ELFCLASS64, ELFCLASSNONE if it is neither
+ */
+unsigned char ElfClass(const MappedFile& file)
+{
+	const unsigned char* ident = file.IsValid() ? file.At<unsigned char>(0, EI_NIDENT) : nullptr;
+	if(ident == nullptr || std::memcmp(ident, ELFMAG, SELFMAG) != 0)
+		return ELFCLASSNONE;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if(ident[EI_DATA] != ELFDATA2LSB)
+		return ELFCLASSNONE;
+#else
+	if(ident[EI_DATA] != ELFDATA2MSB)
+		return ELFCLASSNONE;
+#endif
+
+	return ident[EI_CLASS] == ELFCLASS64 || ident[EI_CLASS] == ELFCLASS32 ? ident[EI_CLASS] : ELFCLASSNONE;
+}
+
+} // anonymous namespace
+
+#endif // PLATFORM_POSIX
+
+/**
+ * @brief Visit the classes exported by a module
+ * @param libName - [in] library file name
+ * @param visitor - [in] callback for every exported class
+ * @return false if the file could not be read or is not a loadable ELF module
+ */
+bool ElfScanner::ScanExports(const dyn_string& libName, const ExportVisitor& visitor)
+{
+#if PLATFORM_POSIX
+	MappedFile file(libName);
+
+	const unsigned char elfClass = ElfClass(file);
+	if(elfClass == ELFCLASS64)
+		return ScanImage<Elf64>(file, visitor);
+	if(elfClass == ELFCLASS32)
+		return ScanImage<Elf32>(file, visitor);
+
+	return false;
+#else
+	(void) libName;
+	(void) visitor;
+	return false;
+#endif
+}
+
+/**
+ * @brief Get the libraries a module depends on
+ * @param libName - [in] library file name
+ * @param needed - [out] names of the needed libraries are appended
+ * @param soname - [out] soname of the module, empty if it has none
+ * @return false if the file could not be read or is not a loadable ELF module
+ */
+bool ElfScanner::ScanDependencies(const dyn_string& libName, std::vector<dyn_string>& needed, dyn_string& soname)
+{
+	soname.clear();
+
+#if PLATFORM_POSIX
+	MappedFile file(libName);
+
+	const unsigned char elfClass = ElfClass(file);
+	if(elfClass == ELFCLASS64)
+		return ReadDependencies<Elf64>(file, needed, soname);
+	if(elfClass == ELFCLASS32)
+		return ReadDependencies<Elf32>(file, needed, soname);
+
+	return false;
+#else
+	(void) libName;
+	(void) needed;
+	return false;
+#endif
+}
+
+/**
+ * @brief Visit the functions defined by a module
+ * @param libName - [in] library file name
+ * @param visitor - [in] callback for every function
+ * @return false if the file could not be read or has no symbol table
+ */
+bool ElfScanner::ScanFunctions(const dyn_string& libName, const FunctionVisitor& visitor)
+{
+#if PLATFORM_POSIX
+	MappedFile file(libName);
+
+	const unsigned char elfClass = ElfClass(file);
+	if(elfClass == ELFCLASS64)
+		return VisitFunctions<Elf64>(file, visitor);
+	if(elfClass == ELFCLASS32)
+		return VisitFunctions<Elf32>(file, visitor);
+
+	return false;
+#else
+	(void) libName;
+	(void) visitor;
+	return false;
+#endif
+}
+
+/**
+ * @brief Get the classes exported by a module
+ * @param libName - [in] library file name
+ * @param classNames - [out] exported class names are appended
+ * @return false if the file could not be read or is not a loadable ELF module
+ */
+bool ElfScanner::ScanLibrary(const dyn_string& libName, std::vector<dyn_string>& classNames)
+{
+	return ScanExports(libName, [&classNames](const char* className, size_t length)
+	{
+		classNames.push_back(dyn_string(className, length));
+	});
+}
+
+/**
+ * @brief Map the classes of all modules in a directory to their files
+ * @param directory - [in] plugin directory
+ * @param classes - [out] class name to library file map
+ * @param suffix - [in] file name suffix of the libraries to scan
+ * @return number of modules scanned
+ */
+size_t ElfScanner::ScanDirectory(const dyn_string& directory, ClassLibraryMap& classes,
+		const dyn_string& suffix)
+{
+	size_t scanned = 0;
+
+	for(auto& libName : ListDirectory(directory, suffix))
+	{
+		const bool found = ScanExports(libName, [&classes, &libName](const char* className, size_t length)
+		{
+			classes.insert(std::make_pair(dyn_string(className, length), libName));
+		});
+
+		if(found)
+			++scanned;
+	}
+
+	return scanned;
+}
+
+} // namespace DynLoader
@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <platform.h>
+
+#include <EpochDomain.hpp>
+
+#include <algorithm>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+namespace
+{
+
+/* @brief Source of unique domain serial numbers */
+std::atomic<uint64_t> domainSerial(0);
+
+/* @brief Last reader slot used by this thread */
+struct LocalCache
+{
+	uint64_t serial;
+	void* record;
+};
+
+thread_local LocalCache localCache = { 0, nullptr };
+
+} // anonymous namespace
+
+EpochDomain::EpochDomain() :
+		globalEpoch(1), records(nullptr), serial(++domainSerial),
+		retiredMutex(), retired()
+{
+}
+
+EpochDomain::~EpochDomain()
+{
+	for(auto& item : retired)
+		item.deleter(item.object);
+	retired.clear();
+
+	Record* record = records.load();
+	while(record != nullptr)
+	{
+		Record* next = record->next;
+		delete record;
+		record = next;
+	}
+}
+
+/**
+ * @brief Get the reader slot of the calling thread
+ * @return reader slot
+ *
+ * Slots are never released while the domain lives. A thread that exits
+ * leaves its slot idle and a later thread with the same id reuses it.
+ */
+EpochDomain::Record* EpochDomain::LocalRecord()
+{
+	if(localCache.serial == serial)
+		return static_cast<Record*>(localCache.record);
+
+	const std::thread::id self = std::this_thread::get_id();
+
+	Record* record = records.load(std::memory_order_acquire);
+	while(record != nullptr && record->owner != self)
+		record = record->next;
+
+	if(record == nullptr)
+	{
+		record = new Record();
+		Record* head = records.load(std::memory_order_relaxed);
+		do
+		{
+			record->next = head;
+		}
+		while(!records.compare_exchange_weak(head, record,
+				std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	localCache.serial = serial;
+	localCache.record = record;
+
+	return record;
+}
+
+/**
+ * @brief Enter a read-side critical section
+ * @param domain - [in] epoch domain
+ */
+EpochDomain::Guard::Guard(EpochDomain& domain) :
+		domain(domain), record(domain.LocalRecord())
+{
+	if(record->depth++ == 0)
+	{
+		// Sequentially consistent so that writers scanning the slots after
+		// replacing a pointer either see this reader or are seen by it.
+		record->epoch.store(domain.globalEpoch.load());
+	}
+}
+
+/**
+ * @brief Leave a read-side critical section
+ */
+EpochDomain::Guard::~Guard()
+{
+	if(--record->depth == 0)
+		record->epoch.store(0, std::memory_order_release);
+}
+
+/**
+ * @brief Get the oldest epoch a reader may still be in
+ * @return oldest active epoch, the current epoch if there are no readers
+ */
+uint64_t EpochDomain::MinActiveEpoch() const
+{
+	uint64_t min = globalEpoch.load();
+
+	for(Record* record = records.load(std::memory_order_acquire);
+			record != nullptr; record = record->next)
+	{
+		const uint64_t epoch = record->epoch.load();
+		if(epoch != 0 && epoch < min)
+			min = epoch;
+	}
+
+	return min;
+}
+
+/**
+ * @brief Free an object once all current readers have left
+ * @param object - [in] object no longer reachable by new readers
+ * @param deleter - [in] function releasing the object
+ */
+void EpochDomain::Retire(void* object, void (*deleter)(void*))
+{
+	if(object == nullptr)
+		return;
+
+	// Readers that entered up to this epoch may still hold the object,
+	// new readers start in a later epoch and cannot reach it.
+	const uint64_t epoch = globalEpoch.fetch_add(1);
+
+	std::lock_guard<std::mutex> lock(retiredMutex);
+	Retired item = { object, deleter, epoch };
+	retired.push_back(item);
+}
+
+/**
+ * @brief Free retired objects that no reader can see anymore
+ */
+void EpochDomain::Reclaim()
+{
+	std::vector<Retired> expired;
+
+	{
+		std::lock_guard<std::mutex> lock(retiredMutex);
+		if(retired.empty())
+			return;
+
+		const uint64_t min = MinActiveEpoch();
+
+		auto it = std::partition(retired.begin(), retired.end(),
+				[min](const Retired& item) { return item.epoch >= min; });
+		expired.assign(it, retired.end());
+		retired.erase(it, retired.end());
+	}
+
+	for(auto& item : expired)
+		item.deleter(item.object);
+}
+
+/**
+ * @brief Wait until all readers that entered before the call have left
+ */
+void EpochDomain::Synchronize()
+{
+	const uint64_t target = globalEpoch.fetch_add(1) + 1;
+
+	for(Record* record = records.load(std::memory_order_acquire);
+			record != nullptr; record = record->next)
+	{
+		uint64_t epoch = record->epoch.load();
+		while(epoch != 0 && epoch < target)
+		{
+			std::this_thread::yield();
+			epoch = record->epoch.load();
+		}
+	}
+
+	Reclaim();
+}
+
+} // namespace DynLoader
@@ -0,0 +1,131 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <DynLoader.hpp>
+
+#include <algorithm>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @brief Pass an event to the listeners
+ * @param event - [in] event, its duration is taken from its start until now
+ *
+ * Exceptions thrown by listeners are dropped, events are also sent while
+ * libraries are torn down.
+ */
+void DynLoader::Notify(DynEvent& event)
+{
+	event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - event.time);
+
+	EpochDomain::Guard guard(epoch);
+
+	const ListenerList* current = listeners.load(std::memory_order_acquire);
+	if(current == nullptr)
+		return;
+
+	for(auto& listener : *current)
+	{
+		try
+		{
+			listener.second(event);
+		}
+		catch(...)
+		{
+		}
+	}
+}
+
+/**
+ * @brief Register a listener for library and class lifecycle events
+ * @param listener - [in] listener
+ * @return id to remove the listener with
+ */
+size_t DynLoader::AddListener(EventListener listener)
+{
+	std::lock_guard<std::mutex> lock(listenerMutex);
+
+	ListenerList* current = listeners.load(std::memory_order_relaxed);
+	ListenerList* next = current != nullptr ? new ListenerList(*current) : new ListenerList();
+
+	const size_t id = ++nextListener;
+	next->push_back(std::make_pair(id, std::move(listener)));
+
+	listeners.store(next, std::memory_order_release);
+	if(current != nullptr)
+		epoch.Retire(current);
+
+	return id;
+}
+
+/**
+ * @brief Remove a listener
+ * @param id - [in] id returned by AddListener()
+ * @return false if no listener has this id
+ *
+ * The last listener removed clears the list, so the operations stop
+ * taking timestamps.
+ */
+bool DynLoader::RemoveListener(size_t id)
+{
+	{
+		std::lock_guard<std::mutex> lock(listenerMutex);
+
+		ListenerList* current = listeners.load(std::memory_order_relaxed);
+		if(current == nullptr)
+			return false;
+
+		auto it = std::find_if(current->begin(), current->end(),
+				[id](const std::pair<size_t, EventListener>& listener) { return listener.first == id; });
+		if(it == current->end())
+			return false;
+
+		ListenerList* next = nullptr;
+		if(current->size() > 1)
+		{
+			next = new ListenerList(current->begin(), it);
+			next->insert(next->end(), it + 1, current->end());
+		}
+
+		listeners.store(next, std::memory_order_release);
+		epoch.Retire(current);
+	}
+
+	// Calls in progress still see the old list
+	epoch.Synchronize();
+
+	return true;
+}
+
+} // namespace DynLoader
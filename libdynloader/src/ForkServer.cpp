@@ -0,0 +1,286 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <DynLoader.hpp>
+#include <LoaderException.hpp>
+#include <WorkerPool.hpp>
+
+#include "Reclaimer.hpp"
+#include "StatsPublisher.hpp"
+#include "SymbolBinder.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#if PLATFORM_POSIX
+#include <dlfcn.h>
+#include <link.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+namespace
+{
+
+#if PLATFORM_POSIX
+/**
+ * @brief Module whose segments are faulted in, see TouchSegments()
+ */
+struct TouchedModule
+{
+	const struct link_map* map;
+	size_t pageSize;
+	size_t bytes;
+};
+
+/**
+ * @brief Read one byte of every page of the module looked for
+ */
+int TouchPages(struct dl_phdr_info* info, size_t, void* data)
+{
+	TouchedModule* module = static_cast<TouchedModule*>(data);
+	if(info->dlpi_addr != module->map->l_addr || info->dlpi_name == nullptr ||
+			std::strcmp(info->dlpi_name, module->map->l_name) != 0)
+		return 0;
+
+	for(ElfW(Half) i = 0; i < info->dlpi_phnum; ++i)
+	{
+		const ElfW(Phdr)& segment = info->dlpi_phdr[i];
+		if(segment.p_type != PT_LOAD || !(segment.p_flags & PF_R))
+			continue;
+
+		const uintptr_t begin = (info->dlpi_addr + segment.p_vaddr) & ~(uintptr_t(module->pageSize) - 1);
+		const uintptr_t end = info->dlpi_addr + segment.p_vaddr + segment.p_memsz;
+		for(uintptr_t page = begin; page < end; page += module->pageSize)
+			(void) *reinterpret_cast<const volatile unsigned char*>(page);
+
+		module->bytes += end - begin;
+	}
+
+	return 1;
+}
+#endif
+
+/**
+ * @brief Fault in the loadable segments of a library
+ * @param lib - [in] opened library
+ * @return bytes faulted in
+ */
+size_t TouchSegments(DynLib& lib)
+{
+#if PLATFORM_POSIX
+	struct link_map* map = nullptr;
+	if(::dlinfo(lib.handle, RTLD_DI_LINKMAP, &map) != 0 || map == nullptr || map->l_name == nullptr)
+		return 0;
+
+	TouchedModule module = { map, static_cast<size_t>(::sysconf(_SC_PAGESIZE)), 0 };
+	::dl_iterate_phdr(TouchPages, &module);
+
+	return module.bytes;
+#else
+	(void) lib;
+	return 0;
+#endif
+}
+
+} // anonymous namespace
+
+/**
+ * @brief Finish the work of the loader's own threads and join them
+ */
+void DynLoader::StopBackgroundThreads()
+{
+	// Tasks may schedule further tasks, which start a new pool
+	for(;;)
+	{
+		std::unique_ptr<WorkerPool> pool;
+		{
+			std::lock_guard<std::mutex> lock(asyncMutex);
+			pool = std::move(asyncPool);
+		}
+
+		if(!pool)
+			break;
+	}
+
+	Reclaimer* current = reclaimer.load(std::memory_order_acquire);
+	if(current != nullptr)
+		current->Stop();
+
+	// The publisher holds an epoch guard while collecting
+	std::lock_guard<std::mutex> lock(publisherMutex);
+	if(publisher != nullptr)
+		publisher->Stop();
+}
+
+/**
+ * @brief Start the threads stopped by StopBackgroundThreads() again
+ * @param publish - [in] also start the stats publisher
+ */
+void DynLoader::StartBackgroundThreads(bool publish)
+{
+	Reclaimer* current = reclaimer.load(std::memory_order_acquire);
+	if(current != nullptr)
+		current->Start();
+
+	std::lock_guard<std::mutex> lock(publisherMutex);
+	if(publish && publisher != nullptr)
+		publisher->Start();
+}
+
+/**
+ * @brief Call the registered and the module fork handlers
+ * @param phase - [in] fork phase
+ *
+ * Module handlers are called under an epoch guard, they must not unload
+ * libraries.
+ */
+void DynLoader::RunForkHandlers(DynForkPhase phase)
+{
+	std::vector<ForkHandler> handlers;
+	{
+		std::lock_guard<std::mutex> lock(forkMutex);
+		handlers = forkHandlers;
+	}
+
+	if(phase == DynForkPhase::Prepare)
+	{
+		for(auto it = handlers.rbegin(); it != handlers.rend(); ++it)
+			(*it)(phase);
+	}
+
+	{
+		EpochDomain::Guard guard(epoch);
+
+		for(auto lib : libs.load(std::memory_order_acquire)->Libraries())
+		{
+			DYN_SYMBOL symbol = GetModuleSymbol(*lib, DYN_MODULE_FORK_SYMBOL);
+			if(symbol != nullptr)
+				reinterpret_cast<DynModuleFork>(symbol)(phase);
+		}
+	}
+
+	if(phase != DynForkPhase::Prepare)
+	{
+		for(auto& handler : handlers)
+			handler(phase);
+	}
+}
+
+/**
+ * @brief Register a handler called around ForkWorker()
+ * @param handler - [in] fork handler
+ */
+void DynLoader::AddForkHandler(ForkHandler handler)
+{
+	std::lock_guard<std::mutex> lock(forkMutex);
+	forkHandlers.push_back(std::move(handler));
+}
+
+/**
+ * @brief Make the loaded libraries ready to be shared with forked workers
+ * @return work done
+ *
+ * A slot bound lazily is written in the worker that first calls through
+ * it, which copies the page in every worker. Binding it in the parent
+ * keeps the page shared.
+ */
+ForkPreparation DynLoader::PrepareFork()
+{
+	StopBackgroundThreads();
+
+	ForkPreparation prepared;
+	{
+		EpochDomain::Guard guard(epoch);
+
+		for(auto lib : libs.load(std::memory_order_acquire)->Libraries())
+		{
+			// Slots are resolved through the base namespace
+			if(lib->options.binding == SymbolBinding::Lazy && lib->space == 0)
+			{
+				const size_t bound = BindLazySymbols(lib->handle, lib->options.deepBind);
+				lib->boundInBackground.fetch_add(bound, std::memory_order_relaxed);
+				prepared.boundSymbols += bound;
+			}
+
+			prepared.touchedBytes += TouchSegments(*lib);
+			++prepared.libraries;
+		}
+	}
+
+	StartBackgroundThreads(true);
+
+	return prepared;
+}
+
+/**
+ * @brief Fork a worker process sharing the loaded libraries
+ * @return process id of the worker in the parent, 0 in the worker
+ */
+int DynLoader::ForkWorker()
+{
+#if PLATFORM_POSIX
+	StopBackgroundThreads();
+
+	RunForkHandlers(DynForkPhase::Prepare);
+
+	pid_t pid = -1;
+	int error = 0;
+	{
+		// No registry update may be half done in the worker
+		std::lock_guard<std::mutex> openLock(openMutex);
+		std::lock_guard<std::mutex> writeLock(writeMutex);
+
+		pid = ::fork();
+		error = errno;
+	}
+
+	// The worker leaves the stats segment to the parent
+	StartBackgroundThreads(pid != 0);
+
+	if(pid == 0)
+		ForkPerfMap();
+
+	RunForkHandlers(pid == 0 ? DynForkPhase::Child : DynForkPhase::Parent);
+
+	if(pid < 0)
+		throw LoaderException("Unable to fork worker: " + dyn_string(std::strerror(error)));
+
+	return static_cast<int>(pid);
+#else
+	throw LoaderException("Forking workers is not supported on this platform");
+#endif
+}
+
+} // namespace DynLoader
@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <HotReloader.hpp>
+#include <DynLoader.hpp>
+
+#include <algorithm>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @brief Start watching
+ * @param loader - [in] loader the libraries are loaded with
+ * @param callback - [in] receives the outcome of every reload
+ */
+HotReloader::HotReloader(DynLoader& loader, ReloadCallback callback) :
+		loader(loader), callback(callback), notifyFd(-1), wakeFds(), mutex(), watched(),
+		reloads(0), thread()
+{
+	wakeFds[0] = wakeFds[1] = -1;
+
+#if defined(__linux__)
+	notifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(notifyFd < 0)
+		return;
+
+	if(::pipe2(wakeFds, O_CLOEXEC) != 0)
+	{
+		::close(notifyFd);
+		notifyFd = -1;
+		return;
+	}
+
+	thread = std::thread(&HotReloader::Run, this);
+#endif
+}
+
+/**
+ * @brief Stop watching and join the watcher thread
+ */
+HotReloader::~HotReloader()
+{
+#if defined(__linux__)
+	if(thread.joinable())
+	{
+		const char stop = 0;
+		while(::write(wakeFds[1], &stop, 1) < 0 && errno == EINTR)
+			;
+
+		thread.join();
+	}
+
+	for(int fd : { notifyFd, wakeFds[0], wakeFds[1] })
+	{
+		if(fd >= 0)
+			::close(fd);
+	}
+#endif
+}
+
+/**
+ * @brief Reload a library when its file is replaced
+ * @param libName - [in] library file name as passed to the loader
+ * @return false if the directory cannot be watched
+ *
+ * The directory is watched rather than the file, a file replaced by
+ * renaming is a new inode the old watch would not see.
+ */
+bool HotReloader::Watch(const dyn_string& libName)
+{
+#if defined(__linux__)
+	if(notifyFd < 0)
+		return false;
+
+	const size_t slash = libName.rfind('/');
+	if(slash == dyn_string::npos || slash + 1 == libName.size())
+		return false;
+
+	const dyn_string directory = slash == 0 ? dyn_string("/") : libName.substr(0, slash);
+
+	const int wd = ::inotify_add_watch(notifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if(wd < 0)
+		return false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	watched.push_back(Watched(wd, libName.substr(slash + 1), libName));
+
+	return true;
+#else
+	(void) libName;
+	return false;
+#endif
+}
+
+/**
+ * @brief Reload a library and report the outcome
+ * @param libName - [in] library file name
+ */
+void HotReloader::Reload(const dyn_string& libName)
+{
+	std::exception_ptr error;
+
+	try
+	{
+		if(loader.ReloadLib(libName))
+			reloads.fetch_add(1, std::memory_order_relaxed);
+	}
+	catch(...)
+	{
+		error = std::current_exception();
+	}
+
+	if(callback)
+		callback(libName, error);
+}
+
+/**
+ * @brief Watcher thread loop
+ */
+void HotReloader::Run()
+{
+#if defined(__linux__)
+	alignas(struct inotify_event) char buffer[4096];
+
+	for(;;)
+	{
+		struct pollfd fds[2] = { { notifyFd, POLLIN, 0 }, { wakeFds[0], POLLIN, 0 } };
+		if(::poll(fds, 2, -1) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return;
+		}
+
+		if(fds[1].revents != 0)
+			return;
+
+		const ssize_t length = ::read(notifyFd, buffer, sizeof(buffer));
+		if(length <= 0)
+			continue;
+
+		// Several events for one file within a read cause a single reload
+		std::vector<dyn_string> changed;
+		for(ssize_t offset = 0; offset < length; )
+		{
+			const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+			offset += static_cast<ssize_t>(sizeof(struct inotify_event) + event->len);
+
+			if(event->len == 0)
+				continue;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			for(auto& entry : watched)
+			{
+				if(entry.directory == event->wd && entry.fileName == event->name &&
+						std::find(changed.begin(), changed.end(), entry.libName) == changed.end())
+					changed.push_back(entry.libName);
+			}
+		}
+
+		for(auto& libName : changed)
+			Reload(libName);
+	}
+#endif
+}
+
+} // namespace DynLoader
@@ -0,0 +1,202 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <LibRegistry.hpp>
+#include <DynLoader.hpp>
+
+#ifdef PLATFORM_POSIX
+#include <dlfcn.h>
+#include <link.h>
+#include <sys/stat.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+LibRegistry::LibRegistry() : byId(), byName()
+{
+}
+
+/**
+ * @brief Find library by requested name
+ * @param space - [in] namespace the library was requested in
+ * @param libName - [in] library name as passed by the caller
+ * @return library, nullptr if the name is unknown
+ */
+DynLib* LibRegistry::Find(DynNamespace space, const dyn_string& libName) const
+{
+	auto it = byName.find(DynLibKey(space, libName));
+
+	return it != byName.end() ? it->second : nullptr;
+}
+
+/**
+ * @brief Find library by canonical identity
+ * @param id - [in] library identity
+ * @return library, nullptr if not registered
+ */
+DynLib* LibRegistry::Find(const DynLibId& id) const
+{
+	auto it = byId.find(id);
+
+	return it != byId.end() ? it->second : nullptr;
+}
+
+/**
+ * @brief Register a library under its identity and name
+ * @param lib - [in] library, lib->id must be set
+ */
+void LibRegistry::Insert(DynLib* lib)
+{
+	byId[lib->id] = lib;
+	AddAlias(lib->name, lib);
+}
+
+/**
+ * @brief Register an additional name for a library
+ * @param alias - [in] name the library was requested under in its namespace
+ * @param lib - [in] registered library
+ */
+void LibRegistry::AddAlias(const dyn_string& alias, DynLib* lib)
+{
+	if(byName.insert(std::make_pair(DynLibKey(lib->space, alias), lib)).second)
+		lib->aliases.push_back(alias);
+}
+
+/**
+ * @brief Remove a library and all of its aliases
+ * @param lib - [in] registered library
+ */
+void LibRegistry::Remove(DynLib* lib)
+{
+	for(auto& alias : lib->aliases)
+		byName.erase(DynLibKey(lib->space, alias));
+	lib->aliases.clear();
+
+	auto it = byId.find(lib->id);
+	if(it != byId.end() && it->second == lib)
+		byId.erase(it);
+}
+
+/**
+ * @brief Remove all libraries
+ */
+void LibRegistry::Clear()
+{
+	for(auto& entry : byId)
+		entry.second->aliases.clear();
+
+	byId.clear();
+	byName.clear();
+}
+
+/**
+ * @brief Get all registered libraries
+ * @return list of libraries
+ */
+std::vector<DynLib*> LibRegistry::Libraries() const
+{
+	std::vector<DynLib*> libs;
+	libs.reserve(byId.size());
+
+	for(auto& entry : byId)
+		libs.push_back(entry.second);
+
+	return libs;
+}
+
+/**
+ * @brief Resolve identity of a library file before opening it
+ * @param libName - [in] library file name
+ * @param id - [out] library identity
+ * @return true if the name is a path that could be resolved
+ */
+bool LibRegistry::IdentifyPath(const dyn_string& libName, DynLibId& id)
+{
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+	// Module handles are the only stable identity on Windows
+	(void) libName;
+	(void) id;
+	return false;
+#elif PLATFORM_POSIX
+	if(libName.find('/') == dyn_string::npos)
+		return false;
+
+	struct stat st;
+	if(::stat(libName.c_str(), &st) != 0)
+		return false;
+
+	id.device = static_cast<uint64_t>(st.st_dev);
+	id.inode = static_cast<uint64_t>(st.st_ino);
+
+	return true;
+#endif
+}
+
+/**
+ * @brief Resolve identity of an opened library
+ * @param handle - [in] system library handle
+ * @param id - [out] library identity
+ * @return true on success
+ */
+bool LibRegistry::IdentifyHandle(DYN_HANDLE handle, DynLibId& id)
+{
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+	id.device = 0;
+	id.inode = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+
+	return handle != nullptr;
+#elif PLATFORM_POSIX
+	struct link_map* map = nullptr;
+	if(::dlinfo(handle, RTLD_DI_LINKMAP, &map) == 0 && map != nullptr &&
+			map->l_name != nullptr && map->l_name[0] != '\0')
+	{
+		struct stat st;
+		if(::stat(map->l_name, &st) == 0)
+		{
+			id.device = static_cast<uint64_t>(st.st_dev);
+			id.inode = static_cast<uint64_t>(st.st_ino);
+
+			return true;
+		}
+	}
+
+	// The system loader returns the same handle for the same module, so
+	// the handle itself is a usable identity when the file is gone.
+	id.device = 0;
+	id.inode = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+
+	return handle != nullptr;
+#endif
+}
+
+} // namespace DynLoader
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include "MappedFile.hpp"
+
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+#include <windows.h>
+#elif PLATFORM_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @brief Map a file
+ * @param fileName - [in] file name
+ */
+MappedFile::MappedFile(const dyn_string& fileName) : data(nullptr), size(0)
+{
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+	HANDLE file = ::CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+			nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize;
+	if(::GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+	{
+		HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(mapping != nullptr)
+		{
+			// The view keeps the mapping alive after its handle is closed
+			void* view = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			if(view != nullptr)
+			{
+				data = static_cast<const unsigned char*>(view);
+				size = static_cast<size_t>(fileSize.QuadPart);
+			}
+			::CloseHandle(mapping);
+		}
+	}
+
+	::CloseHandle(file);
+#elif PLATFORM_POSIX
+	const int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return;
+
+	struct stat st;
+	if(::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		void* map = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if(map != MAP_FAILED)
+		{
+			data = static_cast<const unsigned char*>(map);
+			size = static_cast<size_t>(st.st_size);
+		}
+	}
+
+	::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	if(data == nullptr)
+		return;
+
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+	::UnmapViewOfFile(data);
+#elif PLATFORM_POSIX
+	::munmap(const_cast<unsigned char*>(data), size);
+#endif
+}
+
+} // namespace DynLoader
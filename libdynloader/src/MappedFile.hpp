@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MAPPEDFILE_HPP__
+#define __MAPPEDFILE_HPP__
+
+#include <platform.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @class MappedFile
+ * @brief Read-only mapping of a whole file
+ */
+class API_LOCAL MappedFile
+{
+private:
+	const unsigned char* data;
+	size_t size;
+
+public:
+	/**
+	 * @brief Map a file
+	 * @param fileName - [in] file name
+	 * An empty or unreadable file results in an invalid mapping.
+	 */
+	explicit MappedFile(const dyn_string& fileName);
+	~MappedFile();
+
+	/* @brief Disable copy constructors */
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/**
+	 * @brief Get a bounds checked view of an array in the file
+	 * @param offset - [in] file offset of the first element
+	 * @param count - [in] number of elements
+	 * @return first element, nullptr if the range is outside the file or misaligned
+	 */
+	template<typename T>
+	const T* At(uint64_t offset, uint64_t count = 1) const
+	{
+		if(offset > size || offset % alignof(T) != 0 || count > (size - offset) / sizeof(T))
+			return nullptr;
+
+		return reinterpret_cast<const T*>(data + offset);
+	}
+
+	/**
+	 * @brief Check whether the file could be mapped
+	 */
+	bool IsValid() const { return data != nullptr; }
+
+	/**
+	 * @brief Get size of the mapping
+	 */
+	size_t Size() const { return size; }
+
+}; // class MappedFile
+
+} // namespace DynLoader
+
+#endif // __MAPPEDFILE_HPP__
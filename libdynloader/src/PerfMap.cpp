@@ -0,0 +1,453 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <DynLoader.hpp>
+#include <ElfScanner.hpp>
+#include <LoaderException.hpp>
+
+#include "PerfMap.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#if PLATFORM_POSIX
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+namespace
+{
+
+#if PLATFORM_POSIX
+/* @brief Process whose record files were created, they are truncated once */
+std::atomic<long> truncatedPid(0);
+
+/**
+ * @brief Executable segments of a module, filled by dl_iterate_phdr()
+ */
+struct CodeSegments
+{
+	const struct link_map* map;
+	std::vector<PerfMap::Segment>* code;
+};
+
+/**
+ * @brief Collect the executable segments of the module looked for
+ */
+int AddCode(struct dl_phdr_info* info, size_t, void* data)
+{
+	CodeSegments* segments = static_cast<CodeSegments*>(data);
+	if(info->dlpi_addr != segments->map->l_addr || info->dlpi_name == nullptr ||
+			std::strcmp(info->dlpi_name, segments->map->l_name) != 0)
+		return 0;
+
+	for(ElfW(Half) i = 0; i < info->dlpi_phnum; ++i)
+	{
+		const ElfW(Phdr)& segment = info->dlpi_phdr[i];
+		if(segment.p_type == PT_LOAD && (segment.p_flags & PF_X))
+			segments->code->push_back(PerfMap::Segment(info->dlpi_addr + segment.p_vaddr, segment.p_memsz));
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Append text to a record file with a single write
+ * @param fd - [in] file opened for appending
+ * @param text - [in] complete lines
+ */
+void Append(int fd, const dyn_string& text)
+{
+	const char* data = text.data();
+	size_t left = text.size();
+
+	while(left > 0)
+	{
+		const ssize_t written = ::write(fd, data, left);
+		if(written < 0 && errno == EINTR)
+			continue;
+		if(written <= 0)
+			return;
+
+		data += written;
+		left -= static_cast<size_t>(written);
+	}
+}
+
+/**
+ * @brief Append the content of a file to a record file
+ * @param fileName - [in] copied file
+ * @param fd - [in] file opened for appending
+ */
+void CopyFile(const dyn_string& fileName, int fd)
+{
+	const int source = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+	if(source < 0)
+		return;
+
+	char buffer[4096];
+	for(;;)
+	{
+		const ssize_t bytes = ::read(source, buffer, sizeof(buffer));
+		if(bytes < 0 && errno == EINTR)
+			continue;
+		if(bytes <= 0)
+			break;
+
+		Append(fd, dyn_string(buffer, static_cast<size_t>(bytes)));
+	}
+
+	::close(source);
+}
+#endif
+
+} // anonymous namespace
+
+/**
+ * @brief Create the record files
+ * @param directory - [in] directory of the record files
+ */
+PerfMap::PerfMap(const dyn_string& directory) :
+		directory(directory), pid(0), mapName(), logName(), mapFile(-1), logFile(-1), modules()
+{
+	Open();
+}
+
+/**
+ * @brief Close the record files, they are kept for the samplers
+ */
+PerfMap::~PerfMap()
+{
+	Close();
+}
+
+/**
+ * @brief Open the record files of the calling process
+ */
+void PerfMap::Open()
+{
+#if PLATFORM_POSIX
+	pid = static_cast<long>(::getpid());
+	mapName = directory + "/perf-" + std::to_string(pid) + ".map";
+	logName = directory + "/dynloader-" + std::to_string(pid) + ".log";
+
+	// Files left by an earlier process with the same id describe another
+	// address space, loaders enabled later in this process append
+	const int truncate = truncatedPid.exchange(pid) != pid ? O_TRUNC : 0;
+	const int flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | truncate;
+
+	mapFile = ::open(mapName.c_str(), flags, 0644);
+	if(mapFile < 0)
+		throw LoaderException("Unable to create perf map `" + mapName + "`: " + std::strerror(errno));
+
+	logFile = ::open(logName.c_str(), flags, 0644);
+	if(logFile < 0)
+	{
+		const int error = errno;
+		Close();
+		throw LoaderException("Unable to create load log `" + logName + "`: " + std::strerror(error));
+	}
+#else
+	throw LoaderException("Perf maps are not supported on this platform");
+#endif
+}
+
+/**
+ * @brief Close the record files
+ */
+void PerfMap::Close()
+{
+#if PLATFORM_POSIX
+	if(mapFile >= 0)
+		::close(mapFile);
+	if(logFile >= 0)
+		::close(logFile);
+#endif
+
+	mapFile = -1;
+	logFile = -1;
+}
+
+/**
+ * @brief Append segment lines to the log
+ * @param module - [in] recorded module
+ * @param what - [in] "load" or "unload"
+ */
+void PerfMap::LogSegments(const Module& module, const char* what)
+{
+#if PLATFORM_POSIX
+	struct timespec now;
+	::clock_gettime(CLOCK_MONOTONIC, &now);
+	const uint64_t ns = uint64_t(now.tv_sec) * 1000000000ull + uint64_t(now.tv_nsec);
+
+	dyn_string lines;
+	for(auto& segment : module.code)
+	{
+		char line[96];
+		std::snprintf(line, sizeof(line), "%" PRIu64 " %s %" PRIxPTR " %zx ", ns, what, segment.start, segment.size);
+		lines += line;
+		lines += module.file;
+		lines += '\n';
+	}
+
+	Append(logFile, lines);
+#else
+	(void) module;
+	(void) what;
+#endif
+}
+
+/**
+ * @brief Record the functions of a loaded module
+ * @param owner - [in] library holding the handle
+ * @param handle - [in] system handle of the module
+ * @param fileName - [in] file name shown in the records
+ * @param scanName - [in] file the symbols are read from, empty for the
+ * path the system loader opened
+ */
+void PerfMap::Load(const void* owner, DYN_HANDLE handle, const dyn_string& fileName, const dyn_string& scanName)
+{
+#if PLATFORM_POSIX
+	auto known = modules.find(handle);
+	if(known != modules.end())
+	{
+		std::vector<const void*>& owners = known->second.owners;
+		if(std::find(owners.begin(), owners.end(), owner) == owners.end())
+			owners.push_back(owner);
+		return;
+	}
+
+	struct link_map* map = nullptr;
+	if(::dlinfo(handle, RTLD_DI_LINKMAP, &map) != 0 || map == nullptr || map->l_name == nullptr)
+		return;
+
+	Module module;
+	module.file = fileName;
+	module.owners.push_back(owner);
+
+	CodeSegments segments = { map, &module.code };
+	::dl_iterate_phdr(AddCode, &segments);
+
+	const size_t slash = fileName.rfind('/');
+	const dyn_string label = "[" + fileName.substr(slash == dyn_string::npos ? 0 : slash + 1) + "]";
+
+	// A descriptor named in the link map may have been reused by now
+	dyn_string symbolFile = scanName;
+	if(symbolFile.empty() && std::strncmp(map->l_name, "/proc/", 6) != 0)
+		symbolFile = map->l_name;
+
+	dyn_string records;
+	const uintptr_t base = map->l_addr;
+	const std::vector<Segment>& code = module.code;
+
+	if(!symbolFile.empty())
+	{
+		ElfScanner::ScanFunctions(symbolFile, [&](const char* name, size_t length, uint64_t address, uint64_t size)
+		{
+			const uintptr_t start = base + static_cast<uintptr_t>(address);
+			auto inside = [start](const Segment& segment) { return start - segment.start < segment.size; };
+			if(std::none_of(code.begin(), code.end(), inside))
+				return;
+
+			char range[48];
+			std::snprintf(range, sizeof(range), "%" PRIxPTR " %" PRIx64 " ", start, size);
+			records += range;
+			records.append(name, length);
+			records += ' ';
+			records += label;
+			records += '\n';
+		});
+	}
+
+	// Stripped modules are at least attributed as a whole
+	if(records.empty())
+	{
+		for(auto& segment : code)
+		{
+			char range[48];
+			std::snprintf(range, sizeof(range), "%" PRIxPTR " %zx ", segment.start, segment.size);
+			records += range;
+			records += label;
+			records += '\n';
+		}
+	}
+
+	Append(mapFile, records);
+	LogSegments(module, "load");
+
+	modules.insert(std::make_pair(handle, std::move(module)));
+#else
+	(void) owner;
+	(void) handle;
+	(void) fileName;
+	(void) scanName;
+#endif
+}
+
+/**
+ * @brief Record that a library closed its handle of a module
+ * @param owner - [in] library passed to Load()
+ * @param handle - [in] closed handle
+ */
+void PerfMap::Unload(const void* owner, DYN_HANDLE handle)
+{
+	auto known = modules.find(handle);
+	if(known == modules.end())
+		return;
+
+	std::vector<const void*>& owners = known->second.owners;
+	owners.erase(std::remove(owners.begin(), owners.end(), owner), owners.end());
+	if(!owners.empty())
+		return;
+
+	LogSegments(known->second, "unload");
+	modules.erase(known);
+}
+
+/**
+ * @brief Continue in the record files of a forked process
+ */
+void PerfMap::Fork()
+{
+#if PLATFORM_POSIX
+	if(pid == static_cast<long>(::getpid()))
+		return;
+
+	const dyn_string parentMap = mapName;
+	const dyn_string parentLog = logName;
+
+	Close();
+	Open();
+
+	CopyFile(parentMap, mapFile);
+	CopyFile(parentLog, logFile);
+#endif
+}
+
+/**
+ * @brief Record the code of an opened library in the perf map
+ * @param lib - [in] opened library
+ * @param scanName - [in] file the symbols are read from, empty for the
+ * path the system loader opened
+ */
+void DynLoader::RecordCode(const DynLib& lib, const dyn_string& scanName)
+{
+	std::lock_guard<std::mutex> lock(perfMapMutex);
+
+	if(perfMap != nullptr)
+		perfMap->Load(&lib, lib.handle, lib.name, scanName);
+}
+
+/**
+ * @brief Record that a library closed its system handle
+ * @param lib - [in] closed library
+ */
+void DynLoader::RecordUnload(const DynLib& lib)
+{
+	std::lock_guard<std::mutex> lock(perfMapMutex);
+
+	if(perfMap != nullptr)
+		perfMap->Unload(&lib, lib.handle);
+}
+
+/**
+ * @brief Move the perf map to the files of a forked worker
+ *
+ * The worker stops recording if its files cannot be created.
+ */
+void DynLoader::ForkPerfMap()
+{
+	std::lock_guard<std::mutex> lock(perfMapMutex);
+
+	if(perfMap == nullptr)
+		return;
+
+	try
+	{
+		perfMap->Fork();
+	}
+	catch(const LoaderException&)
+	{
+		delete perfMap;
+		perfMap = nullptr;
+	}
+}
+
+/**
+ * @brief Record the code of the libraries for samplers such as perf
+ * @param directory - [in] directory of the record files
+ * @return path of the perf map
+ */
+dyn_string DynLoader::EnablePerfMap(const dyn_string& directory)
+{
+	std::unique_ptr<PerfMap> started(new PerfMap(directory));
+	const dyn_string name = started->Name();
+
+	std::lock_guard<std::mutex> lock(perfMapMutex);
+
+	delete perfMap;
+	perfMap = started.release();
+
+	// Libraries opened meanwhile wait for the lock and are only recorded once
+	EpochDomain::Guard guard(epoch);
+
+	for(auto lib : libs.load(std::memory_order_acquire)->Libraries())
+		perfMap->Load(lib, lib->handle, lib->name, dyn_string());
+
+	return name;
+}
+
+/**
+ * @brief Stop recording, the record files are kept
+ */
+void DynLoader::DisablePerfMap()
+{
+	PerfMap* previous = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(perfMapMutex);
+		std::swap(previous, perfMap);
+	}
+	delete previous;
+}
+
+} // namespace DynLoader
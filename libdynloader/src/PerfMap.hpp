@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __PERFMAP_HPP__
+#define __PERFMAP_HPP__
+
+#include <platform.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @class PerfMap
+ * @brief Records the code of loaded modules for perf map readers
+ *
+ * Every function of a module is appended to perf-<pid>.map when the module
+ * is loaded, as "<start> <size> <symbol> [<module>]" in hex, so readers of
+ * the map such as the bcc profilers can name samples in a module that was
+ * closed since. perf report does not use it for file-backed code. Readers
+ * only fall back to the map for addresses they cannot resolve through a
+ * mapped file, and a later module may be loaded at the same addresses. The
+ * executable segments are therefore also logged with their load and
+ * unload times to dynloader-<pid>.log, as
+ * "<monotonic ns> load|unload <start> <size> <file>".
+ *
+ * The class is not synchronized.
+ */
+class API_LOCAL PerfMap
+{
+public:
+	/* @brief Executable segment of a module */
+	struct Segment
+	{
+		uintptr_t start;
+		size_t size;
+
+		Segment(uintptr_t start, size_t size) : start(start), size(size) {}
+	};
+
+private:
+	/* @brief Module recorded in the map */
+	struct Module
+	{
+		dyn_string file;
+		std::vector<Segment> code;
+		/* @brief Libraries holding a handle of the module */
+		std::vector<const void*> owners;
+
+		Module() : file(), code(), owners() {}
+	};
+
+	dyn_string directory;
+	long pid;
+	dyn_string mapName;
+	dyn_string logName;
+	int mapFile;
+	int logFile;
+	std::unordered_map<DYN_HANDLE, Module> modules;
+
+	/**
+	 * @brief Open the record files of the calling process
+	 */
+	void Open();
+
+	/**
+	 * @brief Close the record files
+	 */
+	void Close();
+
+	/**
+	 * @brief Append segment lines to the log
+	 * @param module - [in] recorded module
+	 * @param what - [in] "load" or "unload"
+	 */
+	void LogSegments(const Module& module, const char* what);
+
+public:
+	/**
+	 * @brief Create the record files
+	 * @param directory - [in] directory of the record files
+	 * Throws LoaderException if a file cannot be created.
+	 */
+	explicit PerfMap(const dyn_string& directory);
+
+	/**
+	 * @brief Close the record files, they are kept for the samplers
+	 */
+	~PerfMap();
+
+	/* @brief Disable copy constructors */
+	PerfMap(const PerfMap&) = delete;
+	PerfMap& operator=(const PerfMap&) = delete;
+
+	/**
+	 * @brief Record the functions of a loaded module
+	 * @param owner - [in] library holding the handle
+	 * @param handle - [in] system handle of the module
+	 * @param fileName - [in] file name shown in the records
+	 * @param scanName - [in] file the symbols are read from, empty for
+	 * the path the system loader opened
+	 *
+	 * Modules opened through /proc/self/fd can only be scanned while the
+	 * descriptor is open, otherwise their segments are recorded unnamed.
+	 * A module already recorded for another library only gains an owner.
+	 */
+	void Load(const void* owner, DYN_HANDLE handle, const dyn_string& fileName, const dyn_string& scanName);
+
+	/**
+	 * @brief Record that a library closed its handle of a module
+	 * @param owner - [in] library passed to Load()
+	 * @param handle - [in] closed handle
+	 *
+	 * The module is logged as unloaded once its last owner closed it.
+	 */
+	void Unload(const void* owner, DYN_HANDLE handle);
+
+	/**
+	 * @brief Continue in the record files of a forked process
+	 *
+	 * The records of the parent are copied, the forked process shares its
+	 * address space history.
+	 */
+	void Fork();
+
+	/**
+	 * @brief Get the path of the perf map
+	 */
+	const dyn_string& Name() const { return mapName; }
+
+}; // class PerfMap
+
+} // namespace DynLoader
+
+#endif // __PERFMAP_HPP__
@@ -0,0 +1,458 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <PluginCatalog.hpp>
+#include <DynClass.hpp>
+#include <LoaderException.hpp>
+
+#include "Directory.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <sys/stat.h>
+
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+#include <windows.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+namespace
+{
+
+/* @brief Catalog file signature and format version */
+const char CatalogMagic[8] = { 'D', 'Y', 'N', 'C', 'A', 'T', 'L', 'G' };
+const uint32_t CatalogVersion = 1;
+
+/* @brief Library check states */
+enum : unsigned char
+{
+	Unchecked = 0,
+	Current = 1,
+	Changed = 2
+};
+
+} // anonymous namespace
+
+/* @brief Catalog file header, followed by the library, class and string tables */
+struct PluginCatalog::Header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t libraryCount;
+	uint32_t classCount;
+	uint32_t stringSize;
+};
+
+/* @brief Catalogued library and the file state it was scanned in */
+struct PluginCatalog::Library
+{
+	uint64_t size;
+	int64_t modified;
+	uint64_t device;
+	uint64_t inode;
+	uint32_t path;
+	uint32_t pathLength;
+};
+
+/* @brief Catalogued class, the table is sorted by hash and name */
+struct PluginCatalog::Class
+{
+	uint64_t hash;
+	uint32_t name;
+	uint32_t nameLength;
+	uint32_t library;
+	uint32_t reserved;
+};
+
+namespace
+{
+
+/**
+ * @brief Get the current state of a library file
+ * @param path - [in] library file name
+ * @param size - [out] file size
+ * @param modified - [out] modification time in nanoseconds
+ * @param device - [out] device of the file
+ * @param inode - [out] inode of the file
+ * @return false if the file does not exist
+ */
+bool StatLibrary(const dyn_string& path, uint64_t& size, int64_t& modified,
+		uint64_t& device, uint64_t& inode)
+{
+	struct stat st;
+	if(::stat(path.c_str(), &st) != 0)
+		return false;
+
+	size = static_cast<uint64_t>(st.st_size);
+#if defined(__linux__)
+	modified = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+	modified = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#endif
+	device = static_cast<uint64_t>(st.st_dev);
+	inode = static_cast<uint64_t>(st.st_ino);
+
+	return true;
+}
+
+} // anonymous namespace
+
+/**
+ * @brief Map a catalog file
+ * @param catalogFile - [in] catalog file name
+ */
+PluginCatalog::PluginCatalog(const dyn_string& catalogFile) : file(new MappedFile(catalogFile)),
+		header(nullptr), libraries(nullptr), classes(nullptr), strings(nullptr), states(),
+		mutex(), rescanned()
+{
+	const Header* candidate = file->At<Header>(0);
+	if(candidate == nullptr || std::memcmp(candidate->magic, CatalogMagic, sizeof(CatalogMagic)) != 0 ||
+			candidate->version != CatalogVersion)
+		return;
+
+	uint64_t offset = sizeof(Header);
+	libraries = file->At<Library>(offset, candidate->libraryCount);
+	offset += uint64_t(candidate->libraryCount) * sizeof(Library);
+	classes = file->At<Class>(offset, candidate->classCount);
+	offset += uint64_t(candidate->classCount) * sizeof(Class);
+	strings = file->At<char>(offset, candidate->stringSize);
+
+	if(libraries == nullptr || classes == nullptr || strings == nullptr)
+		return;
+
+	states.reset(new std::atomic<unsigned char>[candidate->libraryCount]);
+	for(uint32_t i = 0; i < candidate->libraryCount; ++i)
+		states[i].store(Unchecked, std::memory_order_relaxed);
+
+	header = candidate;
+}
+
+PluginCatalog::~PluginCatalog()
+{
+}
+
+/**
+ * @brief Get number of catalogued libraries
+ */
+size_t PluginCatalog::LibraryCount() const
+{
+	return header ? header->libraryCount : 0;
+}
+
+/**
+ * @brief Get number of catalogued classes
+ */
+size_t PluginCatalog::ClassCount() const
+{
+	return header ? header->classCount : 0;
+}
+
+/**
+ * @brief Get a string of the string table
+ * @param offset - [in] string table offset
+ * @param length - [in] string length
+ * @return string, nullptr if outside the table
+ */
+const char* PluginCatalog::String(uint32_t offset, uint32_t length) const
+{
+	if(offset > header->stringSize || length > header->stringSize - offset)
+		return nullptr;
+
+	return strings + offset;
+}
+
+/**
+ * @brief Find the record of a class
+ * @param className - [in] class name
+ * @return class record, nullptr if not in the catalog
+ */
+const PluginCatalog::Class* PluginCatalog::FindClass(const dyn_string& className) const
+{
+	if(header == nullptr)
+		return nullptr;
+
+	const uint64_t hash = DynClassHash(className);
+	const Class* end = classes + header->classCount;
+
+	const Class* it = std::lower_bound(classes, end, hash,
+			[](const Class& entry, uint64_t value) { return entry.hash < value; });
+
+	for(; it != end && it->hash == hash; ++it)
+	{
+		const char* name = String(it->name, it->nameLength);
+		if(name != nullptr && it->library < header->libraryCount &&
+				className.compare(0, dyn_string::npos, name, it->nameLength) == 0)
+			return it;
+	}
+
+	return nullptr;
+}
+
+/**
+ * @brief Check a library against its file on first use
+ * @param index - [in] library index
+ * @return true if the library is unchanged since the catalog was built
+ *
+ * A changed library is scanned again and its current classes are
+ * remembered in place of the catalogued ones.
+ */
+bool PluginCatalog::IsCurrent(uint32_t index)
+{
+	const unsigned char state = states[index].load(std::memory_order_acquire);
+	if(state != Unchecked)
+		return state == Current;
+
+	const Library& library = libraries[index];
+	const char* path = String(library.path, library.pathLength);
+	if(path == nullptr)
+	{
+		states[index].store(Changed, std::memory_order_release);
+		return false;
+	}
+
+	const dyn_string libName(path, library.pathLength);
+
+	uint64_t size = 0, device = 0, inode = 0;
+	int64_t modified = 0;
+	const bool exists = StatLibrary(libName, size, modified, device, inode);
+
+	if(exists && size == library.size && modified == library.modified &&
+			device == library.device && inode == library.inode)
+	{
+		states[index].store(Current, std::memory_order_release);
+		return true;
+	}
+
+	std::vector<dyn_string> classNames;
+	if(exists)
+		ElfScanner::ScanLibrary(libName, classNames);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(states[index].load(std::memory_order_relaxed) == Unchecked)
+	{
+		for(auto& className : classNames)
+			rescanned.insert(std::make_pair(className, libName));
+
+		states[index].store(Changed, std::memory_order_release);
+	}
+
+	return false;
+}
+
+/**
+ * @brief Find the library providing a class
+ * @param className - [in] class name
+ * @param libName - [out] library file name
+ * @return true if a library providing the class is known
+ *
+ * A class that is not catalogued under an unchanged library may have moved
+ * to another one, so every library not yet checked is checked once.
+ */
+bool PluginCatalog::Find(const dyn_string& className, dyn_string& libName)
+{
+	if(header == nullptr)
+		return false;
+
+	const Class* entry = FindClass(className);
+	if(entry != nullptr && IsCurrent(entry->library))
+	{
+		const Library& library = libraries[entry->library];
+		const char* path = String(library.path, library.pathLength);
+
+		libName.assign(path, library.pathLength);
+		return true;
+	}
+
+	for(uint32_t i = 0; i < header->libraryCount; ++i)
+		IsCurrent(i);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = rescanned.find(className);
+	if(it == rescanned.end())
+		return false;
+
+	libName = it->second;
+	return true;
+}
+
+/**
+ * @brief Build or update a catalog file for a plugin directory
+ * @param catalogFile - [in] catalog file name, replaced atomically
+ * @param directory - [in] plugin directory
+ * @param suffix - [in] file name suffix of the libraries to catalog
+ * @return number of libraries that had to be scanned
+ */
+size_t PluginCatalog::Build(const dyn_string& catalogFile, const dyn_string& directory,
+		const dyn_string& suffix)
+{
+	std::vector<Library> newLibraries;
+	std::vector<Class> newClasses;
+	dyn_string newStrings;
+	size_t scanned = 0;
+
+	auto addString = [&newStrings](const char* text, size_t length)
+	{
+		const uint32_t offset = static_cast<uint32_t>(newStrings.size());
+		newStrings.append(text, length);
+
+		return offset;
+	};
+
+	{
+		PluginCatalog previous(catalogFile);
+
+		// Classes of the previous catalog grouped by library path
+		std::unordered_map<dyn_string, std::vector<const Class*> > previousClasses;
+		std::unordered_map<dyn_string, const Library*> previousLibraries;
+		if(previous.IsValid())
+		{
+			for(uint32_t i = 0; i < previous.header->libraryCount; ++i)
+			{
+				const Library& library = previous.libraries[i];
+				const char* path = previous.String(library.path, library.pathLength);
+				if(path != nullptr)
+					previousLibraries[dyn_string(path, library.pathLength)] = &library;
+			}
+
+			for(uint32_t i = 0; i < previous.header->classCount; ++i)
+			{
+				const Class& entry = previous.classes[i];
+				if(entry.library >= previous.header->libraryCount)
+					continue;
+
+				const Library& library = previous.libraries[entry.library];
+				const char* path = previous.String(library.path, library.pathLength);
+				if(path != nullptr)
+					previousClasses[dyn_string(path, library.pathLength)].push_back(&entry);
+			}
+		}
+
+		std::unordered_map<dyn_string, uint32_t> seen;
+
+		for(auto& libName : ListDirectory(directory, suffix))
+		{
+			Library library;
+			std::memset(&library, 0, sizeof(library));
+			if(!StatLibrary(libName, library.size, library.modified, library.device, library.inode))
+				continue;
+
+			std::vector<dyn_string> classNames;
+
+			auto known = previousLibraries.find(libName);
+			if(known != previousLibraries.end() && known->second->size == library.size &&
+					known->second->modified == library.modified &&
+					known->second->device == library.device && known->second->inode == library.inode)
+			{
+				for(const Class* entry : previousClasses[libName])
+				{
+					const char* name = previous.String(entry->name, entry->nameLength);
+					if(name != nullptr)
+						classNames.push_back(dyn_string(name, entry->nameLength));
+				}
+			}
+			else
+			{
+				++scanned;
+				if(!ElfScanner::ScanLibrary(libName, classNames))
+					continue;
+			}
+
+			const uint32_t index = static_cast<uint32_t>(newLibraries.size());
+			library.path = addString(libName.data(), libName.size());
+			library.pathLength = static_cast<uint32_t>(libName.size());
+			newLibraries.push_back(library);
+
+			for(auto& className : classNames)
+			{
+				// The first library in name order provides a class
+				if(!seen.insert(std::make_pair(className, index)).second)
+					continue;
+
+				Class entry;
+				std::memset(&entry, 0, sizeof(entry));
+				entry.hash = DynClassHash(className);
+				entry.name = addString(className.data(), className.size());
+				entry.nameLength = static_cast<uint32_t>(className.size());
+				entry.library = index;
+				newClasses.push_back(entry);
+			}
+		}
+	}
+
+	std::sort(newClasses.begin(), newClasses.end(), [&newStrings](const Class& a, const Class& b)
+	{
+		if(a.hash != b.hash)
+			return a.hash < b.hash;
+
+		return newStrings.compare(a.name, a.nameLength, newStrings, b.name, b.nameLength) < 0;
+	});
+
+	Header header;
+	std::memcpy(header.magic, CatalogMagic, sizeof(CatalogMagic));
+	header.version = CatalogVersion;
+	header.libraryCount = static_cast<uint32_t>(newLibraries.size());
+	header.classCount = static_cast<uint32_t>(newClasses.size());
+	header.stringSize = static_cast<uint32_t>(newStrings.size());
+
+	// Concurrent builds each write their own file, the last one replaces
+	// the catalog
+	dyn_string tempFile;
+	FILE* out = CreateTempFile(catalogFile, tempFile);
+	if(out == nullptr)
+		throw LoaderException("Unable to write catalog `" + catalogFile + "`");
+
+	bool written = std::fwrite(&header, sizeof(header), 1, out) == 1;
+	if(written && !newLibraries.empty())
+		written = std::fwrite(newLibraries.data(), sizeof(Library), newLibraries.size(), out) == newLibraries.size();
+	if(written && !newClasses.empty())
+		written = std::fwrite(newClasses.data(), sizeof(Class), newClasses.size(), out) == newClasses.size();
+	if(written && !newStrings.empty())
+		written = std::fwrite(newStrings.data(), 1, newStrings.size(), out) == newStrings.size();
+
+	if(std::fclose(out) != 0 || !written || !ReplaceFile(tempFile, catalogFile))
+	{
+		std::remove(tempFile.c_str());
+		throw LoaderException("Unable to write catalog `" + catalogFile + "`");
+	}
+
+	return scanned;
+}
+
+} // namespace DynLoader
@@ -0,0 +1,542 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <platform.h>
+
+#include <DynLoader.hpp>
+#include <ElfScanner.hpp>
+#include <LoaderException.hpp>
+#include <WorkerPool.hpp>
+
+#include "Directory.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+#if PLATFORM_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+#include <windows.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+namespace
+{
+
+/**
+ * @brief Ask the kernel to start reading a file in the background
+ * @param fileName - [in] file name
+ */
+void ReadAhead(const dyn_string& fileName)
+{
+#if PLATFORM_POSIX
+	// Bare names are resolved through the loader search path
+	if(fileName.find('/') == dyn_string::npos)
+		return;
+
+	const int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return;
+
+#if defined(POSIX_FADV_WILLNEED)
+	(void) ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+	::close(fd);
+#else
+	(void) fileName;
+#endif
+}
+
+/* @brief Profile file signature and format version */
+const char ProfileMagic[8] = { 'D', 'Y', 'N', 'P', 'R', 'O', 'F', 'L' };
+const uint32_t ProfileVersion = 1;
+
+/* @brief Profile file header, followed by the library, class and string tables */
+struct ProfileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t libraryCount;
+	uint32_t classCount;
+	uint32_t stringSize;
+};
+
+/* @brief Profiled library, in order of first use */
+struct ProfileLibrary
+{
+	uint32_t name;
+	uint32_t nameLength;
+};
+
+/* @brief Profiled class, in order of first use */
+struct ProfileClass
+{
+	uint32_t library;
+	uint32_t name;
+	uint32_t nameLength;
+	uint32_t instantiated;
+};
+
+/* @brief Class of a profiled library and whether to instantiate it */
+typedef std::vector<std::pair<dyn_string, bool> > ProfiledClasses;
+
+/**
+ * @brief Read a profile file
+ * @param profileFile - [in] profile file name
+ * @param libNames - [out] library names in profile order
+ * @param classes - [out] classes per library in profile order
+ * @return false if the file is missing or malformed
+ */
+bool ReadProfile(const dyn_string& profileFile, std::vector<dyn_string>& libNames,
+		std::vector<ProfiledClasses>& classes)
+{
+	MappedFile file(profileFile);
+
+	const ProfileHeader* header = file.At<ProfileHeader>(0);
+	if(header == nullptr || std::memcmp(header->magic, ProfileMagic, sizeof(ProfileMagic)) != 0 ||
+			header->version != ProfileVersion)
+		return false;
+
+	uint64_t offset = sizeof(ProfileHeader);
+	const ProfileLibrary* libraries = file.At<ProfileLibrary>(offset, header->libraryCount);
+	offset += uint64_t(header->libraryCount) * sizeof(ProfileLibrary);
+	const ProfileClass* profiled = file.At<ProfileClass>(offset, header->classCount);
+	offset += uint64_t(header->classCount) * sizeof(ProfileClass);
+	const char* strings = file.At<char>(offset, header->stringSize);
+	if(libraries == nullptr || profiled == nullptr || strings == nullptr)
+		return false;
+
+	auto inStrings = [header](uint32_t name, uint32_t length)
+	{
+		return name <= header->stringSize && length <= header->stringSize - name;
+	};
+
+	for(uint32_t i = 0; i < header->libraryCount; ++i)
+	{
+		if(!inStrings(libraries[i].name, libraries[i].nameLength))
+			return false;
+		libNames.push_back(dyn_string(strings + libraries[i].name, libraries[i].nameLength));
+	}
+
+	classes.resize(libNames.size());
+	for(uint32_t i = 0; i < header->classCount; ++i)
+	{
+		if(profiled[i].library >= header->libraryCount || !inStrings(profiled[i].name, profiled[i].nameLength))
+			return false;
+		classes[profiled[i].library].push_back(std::make_pair(
+				dyn_string(strings + profiled[i].name, profiled[i].nameLength), profiled[i].instantiated != 0));
+	}
+
+	return true;
+}
+
+/**
+ * @brief Check whether a library provides a needed library name
+ * @param fileName - [in] library file name
+ * @param soname - [in] soname of the library
+ * @param needed - [in] name another library links against
+ */
+bool Provides(const dyn_string& fileName, const dyn_string& soname, const dyn_string& needed)
+{
+	if(needed == fileName || (!soname.empty() && needed == soname))
+		return true;
+
+	const size_t slash = fileName.find_last_of('/');
+
+	return slash != dyn_string::npos && fileName.compare(slash + 1, dyn_string::npos, needed) == 0;
+}
+
+} // anonymous namespace
+
+/**
+ * @brief Load a set of libraries ahead of use
+ * @param libNames - [in] library file names
+ * @param workers - [in] number of loader threads, 0 for one per core
+ * @return per library timings and errors
+ *
+ * The system loader serializes the final linking step of concurrent
+ * opens, the pool mainly overlaps file I/O and page faults.
+ */
+PreloadResult DynLoader::Preload(const std::vector<dyn_string>& libNames, unsigned workers)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const Clock::time_point start = Clock::now();
+
+	PreloadResult result;
+	result.libraries.resize(libNames.size());
+
+	for(auto& libName : libNames)
+		ReadAhead(libName);
+
+	if(workers == 0)
+		workers = WorkerPool::DefaultThreadCount();
+	workers = static_cast<unsigned>(std::min<size_t>(workers, std::max<size_t>(libNames.size(), 1)));
+
+	{
+		WorkerPool pool(workers);
+
+		for(size_t i = 0; i < libNames.size(); ++i)
+		{
+			pool.Submit([this, &libNames, &result, i]()
+			{
+				PreloadEntry& entry = result.libraries[i];
+				entry.name = libNames[i];
+
+				const Clock::time_point opening = Clock::now();
+				try
+				{
+					EpochDomain::Guard guard(epoch);
+					entry.loaded = OpenLib(0, entry.name) != nullptr;
+				}
+				catch(const LoaderException& ex)
+				{
+					entry.error = ex.what();
+
+					const dyn_string& reason = GetLastError();
+					if(!reason.empty())
+						entry.error += ": " + reason;
+				}
+				catch(const std::exception& ex)
+				{
+					entry.error = ex.what();
+				}
+				entry.openTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - opening);
+			});
+		}
+
+		pool.Wait();
+	}
+
+	for(auto& entry : result.libraries)
+	{
+		if(entry.loaded)
+			++result.loaded;
+		else
+			++result.failed;
+	}
+
+	result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+
+	return result;
+}
+
+/**
+ * @brief Load all libraries of a directory ahead of use
+ * @param directory - [in] plugin directory
+ * @param suffix - [in] file name suffix of the libraries to load
+ * @param workers - [in] number of loader threads, 0 for one per core
+ * @return per library timings and errors
+ */
+PreloadResult DynLoader::PreloadDirectory(const dyn_string& directory,
+		const dyn_string& suffix, unsigned workers)
+{
+	return Preload(ListDirectory(directory, suffix), workers);
+}
+
+/**
+ * @brief Record the first use of a class while profiling
+ * @param lib - [in] library of the class
+ * @param entry - [in] class entry
+ * @param instantiated - [in] the shared instance was created
+ *
+ * Every use is recorded once per class entry, later ones only read its
+ * flags. Copies in other namespaces are recorded under their file name,
+ * namespaces do not outlive the process.
+ */
+void DynLoader::RecordProfile(const DynLib& lib, DynClassEntry& entry, bool instantiated)
+{
+	const unsigned use = instantiated ? 2u : 1u;
+	if((entry.profiled.load(std::memory_order_relaxed) & use) != 0 ||
+			(entry.profiled.fetch_or(use, std::memory_order_relaxed) & use) != 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(profileMutex);
+
+	for(auto& record : profile)
+	{
+		if(record.libName == lib.name && record.className == entry.name)
+		{
+			record.instantiated = record.instantiated || instantiated;
+			return;
+		}
+	}
+
+	profile.push_back(ProfileRecord(lib.name, entry.name, instantiated));
+}
+
+/**
+ * @brief Record which classes the process uses
+ * @param enabled - [in] start or stop recording
+ */
+void DynLoader::SetProfiling(bool enabled)
+{
+	profiling.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Write the recorded classes to a profile file
+ * @param profileFile - [in] profile file name, replaced atomically
+ * @return number of recorded classes
+ */
+size_t DynLoader::SaveProfile(const dyn_string& profileFile)
+{
+	std::vector<ProfileRecord> records;
+	{
+		std::lock_guard<std::mutex> lock(profileMutex);
+		records = profile;
+	}
+
+	std::vector<ProfileLibrary> libraries;
+	std::vector<ProfileClass> classes;
+	dyn_string strings;
+	std::unordered_map<dyn_string, uint32_t> libraryIndex;
+
+	for(auto& record : records)
+	{
+		auto it = libraryIndex.find(record.libName);
+		if(it == libraryIndex.end())
+		{
+			ProfileLibrary library;
+			library.name = static_cast<uint32_t>(strings.size());
+			library.nameLength = static_cast<uint32_t>(record.libName.size());
+			strings += record.libName;
+
+			it = libraryIndex.insert(std::make_pair(record.libName, static_cast<uint32_t>(libraries.size()))).first;
+			libraries.push_back(library);
+		}
+
+		ProfileClass profiled;
+		profiled.library = it->second;
+		profiled.name = static_cast<uint32_t>(strings.size());
+		profiled.nameLength = static_cast<uint32_t>(record.className.size());
+		profiled.instantiated = record.instantiated ? 1 : 0;
+		strings += record.className;
+
+		classes.push_back(profiled);
+	}
+
+	ProfileHeader header;
+	std::memcpy(header.magic, ProfileMagic, sizeof(ProfileMagic));
+	header.version = ProfileVersion;
+	header.libraryCount = static_cast<uint32_t>(libraries.size());
+	header.classCount = static_cast<uint32_t>(classes.size());
+	header.stringSize = static_cast<uint32_t>(strings.size());
+
+	dyn_string tempFile;
+	FILE* out = CreateTempFile(profileFile, tempFile);
+	if(out == nullptr)
+		throw LoaderException("Unable to write profile `" + profileFile + "`");
+
+	bool written = std::fwrite(&header, sizeof(header), 1, out) == 1;
+	if(written && !libraries.empty())
+		written = std::fwrite(libraries.data(), sizeof(ProfileLibrary), libraries.size(), out) == libraries.size();
+	if(written && !classes.empty())
+		written = std::fwrite(classes.data(), sizeof(ProfileClass), classes.size(), out) == classes.size();
+	if(written && !strings.empty())
+		written = std::fwrite(strings.data(), 1, strings.size(), out) == strings.size();
+
+	if(std::fclose(out) != 0 || !written || !ReplaceFile(tempFile, profileFile))
+	{
+		std::remove(tempFile.c_str());
+		throw LoaderException("Unable to write profile `" + profileFile + "`");
+	}
+
+	return records.size();
+}
+
+/**
+ * @brief Load and instantiate the classes of a profile ahead of use
+ * @param profileFile - [in] profile file name
+ * @param workers - [in] number of loader threads, 0 for one per core
+ * @return per library timings and errors
+ *
+ * Libraries are ranked by the longest chain of profiled libraries they
+ * link against, each rank is prepared in parallel once the previous one
+ * is done. A dependency cycle is cut after as many rounds as libraries.
+ */
+PreloadResult DynLoader::WarmStart(const dyn_string& profileFile, unsigned workers)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const Clock::time_point start = Clock::now();
+
+	PreloadResult result;
+
+	std::vector<dyn_string> libNames;
+	std::vector<ProfiledClasses> classes;
+	if(!ReadProfile(profileFile, libNames, classes))
+		return result;
+
+	const size_t count = libNames.size();
+	result.libraries.resize(count);
+
+	std::vector<std::vector<dyn_string> > needed(count);
+	std::vector<dyn_string> sonames(count);
+	for(size_t i = 0; i < count; ++i)
+	{
+		result.libraries[i].name = libNames[i];
+		ReadAhead(libNames[i]);
+		ElfScanner::ScanDependencies(libNames[i], needed[i], sonames[i]);
+	}
+
+	std::vector<std::vector<size_t> > dependencies(count);
+	for(size_t i = 0; i < count; ++i)
+	{
+		for(size_t j = 0; j < count; ++j)
+		{
+			for(auto& name : needed[i])
+			{
+				if(j != i && Provides(libNames[j], sonames[j], name))
+				{
+					dependencies[i].push_back(j);
+					break;
+				}
+			}
+		}
+	}
+
+	std::vector<size_t> rank(count, 0);
+	size_t maxRank = 0;
+	for(size_t round = 0; round < count; ++round)
+	{
+		bool changed = false;
+		for(size_t i = 0; i < count; ++i)
+		{
+			for(auto j : dependencies[i])
+			{
+				if(rank[i] <= rank[j])
+				{
+					rank[i] = rank[j] + 1;
+					maxRank = std::max(maxRank, rank[i]);
+					changed = true;
+				}
+			}
+		}
+
+		if(!changed)
+			break;
+	}
+
+	if(workers == 0)
+		workers = WorkerPool::DefaultThreadCount();
+	workers = static_cast<unsigned>(std::min<size_t>(workers, std::max<size_t>(count, 1)));
+
+	{
+		WorkerPool pool(workers);
+
+		for(size_t current = 0; current <= maxRank && count != 0; ++current)
+		{
+			for(size_t i = 0; i < count; ++i)
+			{
+				if(rank[i] != current)
+					continue;
+
+				pool.Submit([this, &result, &classes, i]()
+				{
+					PreloadEntry& entry = result.libraries[i];
+
+					const Clock::time_point opening = Clock::now();
+					try
+					{
+						EpochDomain::Guard guard(epoch);
+
+						DynLib* lib = OpenLib(0, entry.name);
+						entry.openTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - opening);
+						entry.loaded = lib != nullptr;
+						if(lib == nullptr)
+							return;
+
+						// Eviction must not throw away what is warmed up here
+						lib->pinned.store(true, std::memory_order_relaxed);
+
+						for(auto& profiled : classes[i])
+						{
+							if(profiled.second)
+								GetClassInstance(*lib, profiled.first);
+							else
+								GetClassBuilder(*lib, profiled.first);
+							++entry.classes;
+						}
+
+						DYN_SYMBOL symbol = GetModuleSymbol(*lib, DYN_MODULE_WARMUP_SYMBOL);
+						if(symbol != nullptr)
+						{
+							reinterpret_cast<DynModuleWarmUp>(symbol)();
+							entry.warmedUp = true;
+						}
+					}
+					catch(const LoaderException& ex)
+					{
+						entry.error = ex.what();
+
+						const dyn_string& reason = GetLastError();
+						if(!reason.empty())
+							entry.error += ": " + reason;
+					}
+					catch(const std::exception& ex)
+					{
+						entry.error = ex.what();
+					}
+
+					if(entry.openTime.count() == 0)
+						entry.openTime = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - opening);
+				});
+			}
+
+			// Dependents start once all libraries of this rank are ready
+			pool.Wait();
+		}
+	}
+
+	for(auto& entry : result.libraries)
+	{
+		if(entry.loaded && entry.error.empty())
+			++result.loaded;
+		else
+			++result.failed;
+	}
+
+	result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+
+	return result;
+}
+
+} // namespace DynLoader
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __PROBES_HPP__
+#define __PROBES_HPP__
+
+#include <platform.h>
+
+/**
+ * @file Probes.hpp
+ * @brief Statically defined tracepoints of the loader
+ *
+ * With <sys/sdt.h> available the probes are compiled in as single no-op
+ * instructions with ELF notes, provider "dynloader", which bpftrace or
+ * perf attach to at run time, e.g.
+ *
+ *   bpftrace -e 'usdt:./libdynloader.so:dynloader:open_start { @s[tid] = nsecs; }
+ *       usdt:./libdynloader.so:dynloader:open_done /@s[tid]/ { @ns = hist(nsecs - @s[tid]); }'
+ *
+ * Probes and arguments:
+ *   open_start(file)                     OpenLib() opens a library
+ *   open_done(file, lib)                 lib is nullptr on failure
+ *   resolve(file, symbol, address)
+ *   instance_start(file, class)          GetClassInstance() by name
+ *   instance_done(file, class, instance, constructed)
+ *   create(file, class, instance)
+ *   destroy_start(file, class, instance) ~DynLib()
+ *   destroy_done(file, class)
+ *   close_start(file, handle)            ~DynLib()
+ *   close_done(file, success)
+ *
+ * Otherwise the probes expand to nothing and their arguments are not
+ * evaluated.
+ */
+
+#if defined(HAVE_SYS_SDT_H)
+#include <sys/sdt.h>
+
+#define DYN_PROBE1(name, a) STAP_PROBE1(dynloader, name, a)
+#define DYN_PROBE2(name, a, b) STAP_PROBE2(dynloader, name, a, b)
+#define DYN_PROBE3(name, a, b, c) STAP_PROBE3(dynloader, name, a, b, c)
+#define DYN_PROBE4(name, a, b, c, d) STAP_PROBE4(dynloader, name, a, b, c, d)
+#else
+#define DYN_PROBE1(name, a) do {} while(0)
+#define DYN_PROBE2(name, a, b) do {} while(0)
+#define DYN_PROBE3(name, a, b, c) do {} while(0)
+#define DYN_PROBE4(name, a, b, c, d) do {} while(0)
+#endif
+
+#endif // __PROBES_HPP__
@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include "Reclaimer.hpp"
+
+#include <algorithm>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @brief Start the worker thread
+ * @param limit - [in] maximum number of queued libraries
+ */
+Reclaimer::Reclaimer(size_t limit) :
+		mutex(), wakeup(), drained(), queue(), limit(limit), busy(false), stopping(false),
+		stats(), thread()
+{
+	thread = std::thread(&Reclaimer::Run, this);
+}
+
+/**
+ * @brief Tear down the queued libraries and join the worker thread
+ */
+Reclaimer::~Reclaimer()
+{
+	Stop();
+}
+
+/**
+ * @brief Tear down the queued libraries and join the worker thread
+ */
+void Reclaimer::Stop()
+{
+	std::thread worker;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		worker.swap(thread);
+	}
+	wakeup.notify_all();
+
+	if(worker.joinable())
+		worker.join();
+}
+
+/**
+ * @brief Start the worker thread again after Stop()
+ */
+void Reclaimer::Start()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(thread.joinable())
+		return;
+
+	stopping = false;
+	thread = std::thread(&Reclaimer::Run, this);
+}
+
+/**
+ * @brief Queue an unloaded library
+ * @param lib - [in] library no reader can reach anymore
+ *
+ * Never blocks: a full queue, or a library released by a destructor that
+ * runs on the worker itself, is torn down on the calling thread.
+ */
+void Reclaimer::Submit(DynLib* lib)
+{
+	const Clock::time_point now = Clock::now();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if(queue.size() < limit && !stopping && std::this_thread::get_id() != thread.get_id())
+		{
+			queue.push_back(std::make_pair(lib, now));
+			stats.queued = queue.size();
+			wakeup.notify_one();
+			return;
+		}
+
+		++stats.overflows;
+	}
+
+	Teardown(lib, now);
+}
+
+/**
+ * @brief Wait until all queued libraries have been torn down
+ */
+void Reclaimer::Flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	drained.wait(lock, [this]() { return queue.empty() && !busy; });
+}
+
+/**
+ * @brief Change the maximum number of queued libraries
+ * @param limit - [in] maximum number of queued libraries
+ */
+void Reclaimer::SetLimit(size_t limit)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->limit = limit;
+}
+
+/**
+ * @brief Get the reclaim counters
+ */
+ReclaimStats Reclaimer::Stats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+/**
+ * @brief Tear down a library and account for it
+ * @param lib - [in] unloaded library
+ * @param queued - [in] time the library was retired
+ */
+void Reclaimer::Teardown(DynLib* lib, Clock::time_point queued)
+{
+	const Clock::time_point start = Clock::now();
+
+	const bool failed = !lib->Unload();
+	delete lib;
+
+	const Clock::time_point end = Clock::now();
+	const std::chrono::nanoseconds lag = std::chrono::duration_cast<std::chrono::nanoseconds>(start - queued);
+	const std::chrono::nanoseconds teardown = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	++stats.reclaimed;
+	if(failed)
+		++stats.failures;
+
+	stats.totalLag += lag;
+	stats.maxLag = std::max(stats.maxLag, lag);
+	stats.totalTeardown += teardown;
+	stats.maxTeardown = std::max(stats.maxTeardown, teardown);
+}
+
+/**
+ * @brief Worker thread loop
+ */
+void Reclaimer::Run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for(;;)
+	{
+		wakeup.wait(lock, [this]() { return stopping || !queue.empty(); });
+		if(queue.empty())
+			return;
+
+		std::pair<DynLib*, Clock::time_point> next = queue.front();
+		queue.pop_front();
+		stats.queued = queue.size();
+		busy = true;
+
+		lock.unlock();
+		Teardown(next.first, next.second);
+		lock.lock();
+
+		busy = false;
+		if(queue.empty())
+			drained.notify_all();
+	}
+}
+
+} // namespace DynLoader
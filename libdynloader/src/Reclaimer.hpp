@@ -0,0 +1,138 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __RECLAIMER_HPP__
+#define __RECLAIMER_HPP__
+
+#include <platform.h>
+
+#include <DynLoader.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @class Reclaimer
+ * @brief Worker thread tearing down unloaded libraries
+ *
+ * Destroying the instances of a library and closing it runs the module's
+ * static destructors and unmaps its segments. Queued libraries are torn
+ * down on the worker instead of the thread that released them. When the
+ * queue is full the releasing thread tears the library down itself.
+ */
+class API_LOCAL Reclaimer
+{
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::condition_variable drained;
+	std::deque<std::pair<DynLib*, Clock::time_point> > queue;
+	size_t limit;
+	bool busy;
+	bool stopping;
+	ReclaimStats stats;
+	std::thread thread;
+
+	/**
+	 * @brief Worker thread loop
+	 */
+	void Run();
+
+	/**
+	 * @brief Tear down a library and account for it, caller must not hold
+	 * the mutex
+	 * @param lib - [in] unloaded library
+	 * @param queued - [in] time the library was retired
+	 */
+	void Teardown(DynLib* lib, Clock::time_point queued);
+
+public:
+	/**
+	 * @brief Start the worker thread
+	 * @param limit - [in] maximum number of queued libraries
+	 */
+	explicit Reclaimer(size_t limit);
+
+	/**
+	 * @brief Tear down the queued libraries and join the worker thread
+	 */
+	~Reclaimer();
+
+	/* @brief Disable copy constructors */
+	Reclaimer(const Reclaimer&) = delete;
+	Reclaimer& operator=(const Reclaimer&) = delete;
+
+	/**
+	 * @brief Queue an unloaded library
+	 * @param lib - [in] library no reader can reach anymore
+	 */
+	void Submit(DynLib* lib);
+
+	/**
+	 * @brief Wait until all queued libraries have been torn down
+	 */
+	void Flush();
+
+	/**
+	 * @brief Tear down the queued libraries and join the worker thread
+	 * Libraries submitted until Start() are torn down by the submitting
+	 * thread.
+	 */
+	void Stop();
+
+	/**
+	 * @brief Start the worker thread again after Stop()
+	 */
+	void Start();
+
+	/**
+	 * @brief Change the maximum number of queued libraries
+	 * @param limit - [in] maximum number of queued libraries
+	 */
+	void SetLimit(size_t limit);
+
+	/**
+	 * @brief Get the reclaim counters
+	 */
+	ReclaimStats Stats();
+
+}; // class Reclaimer
+
+} // namespace DynLoader
+
+#endif // __RECLAIMER_HPP__
@@ -0,0 +1,239 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <DynLoader.hpp>
+
+#include "StatsPublisher.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if PLATFORM_POSIX
+#include <unistd.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+namespace
+{
+
+/**
+ * @brief Get the id of the calling process
+ */
+long ProcessId()
+{
+#if PLATFORM_POSIX
+	return static_cast<long>(::getpid());
+#else
+	return 0;
+#endif
+}
+
+} // anonymous namespace
+
+/**
+ * @brief Publish once and start the worker thread
+ * @param segment - [in] published segment
+ * @param interval - [in] time between updates
+ * @param collect - [in] function filling the segment data
+ */
+StatsPublisher::StatsPublisher(std::unique_ptr<DynStatsSegment> segment, std::chrono::milliseconds interval,
+		Collector collect) :
+		mutex(), wakeup(), segment(std::move(segment)), collect(collect), interval(interval),
+		data(new DynSegmentData()), stopping(false), thread()
+{
+	Publish();
+
+	thread = std::thread(&StatsPublisher::Run, this);
+}
+
+/**
+ * @brief Join the worker thread and remove the segment
+ */
+StatsPublisher::~StatsPublisher()
+{
+	Stop();
+}
+
+/**
+ * @brief Join the worker thread, the segment keeps its last update
+ */
+void StatsPublisher::Stop()
+{
+	std::thread worker;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		worker.swap(thread);
+	}
+	wakeup.notify_all();
+
+	if(worker.joinable())
+		worker.join();
+}
+
+/**
+ * @brief Start the worker thread again after Stop()
+ */
+void StatsPublisher::Start()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(thread.joinable())
+		return;
+
+	stopping = false;
+	thread = std::thread(&StatsPublisher::Run, this);
+}
+
+/**
+ * @brief Collect the state and write it to the segment
+ */
+void StatsPublisher::Publish()
+{
+	collect(*data);
+
+	data->pid = static_cast<uint64_t>(ProcessId());
+	data->updatedNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count());
+	++data->updates;
+
+	segment->Write(*data);
+}
+
+/**
+ * @brief Worker thread loop
+ */
+void StatsPublisher::Run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for(;;)
+	{
+		if(wakeup.wait_for(lock, interval, [this]() { return stopping; }))
+			return;
+
+		lock.unlock();
+		Publish();
+		lock.lock();
+	}
+}
+
+/**
+ * @brief Fill the data of a stats segment
+ * @param data - [out] segment data, the fields set by the publisher are
+ * left alone
+ */
+void DynLoader::CollectSegment(DynSegmentData& data)
+{
+	data.mappedBytes = mappedBytes.load(std::memory_order_relaxed);
+	data.memoryBudget = memoryBudget.load(std::memory_order_relaxed);
+
+	const DynStats snapshot = GetStats();
+	for(size_t m = 0; m < DynMetricCount; ++m)
+	{
+		const DynHistogram& histogram = snapshot.metrics[m];
+		DynSegmentMetric& metric = data.metrics[m];
+		metric.count = histogram.count;
+		metric.samples = histogram.samples;
+		metric.totalNs = static_cast<uint64_t>(histogram.total.count());
+		metric.maxNs = static_cast<uint64_t>(histogram.max.count());
+		metric.p50Ns = static_cast<uint64_t>(histogram.Percentile(50).count());
+		metric.p99Ns = static_cast<uint64_t>(histogram.Percentile(99).count());
+	}
+
+	const std::vector<LibraryUsage> usage = GetLibraryUsage();
+	data.libraryCount = std::min(usage.size(), DynSegmentLibraries);
+	data.librariesDropped = usage.size() - data.libraryCount;
+
+	for(size_t i = 0; i < data.libraryCount; ++i)
+	{
+		DynSegmentLibrary& library = data.libraries[i];
+		std::strncpy(library.name, usage[i].name.c_str(), DynSegmentNameLength - 1);
+		library.name[DynSegmentNameLength - 1] = '\0';
+		library.space = usage[i].space;
+		library.pinned = usage[i].pinned;
+		library.instances = usage[i].instances;
+		library.handles = usage[i].handles;
+		library.textBytes = usage[i].textBytes;
+		library.dataBytes = usage[i].dataBytes;
+		library.bssBytes = usage[i].bssBytes;
+		library.idleNs = static_cast<uint64_t>(usage[i].idle.count());
+	}
+}
+
+/**
+ * @brief Publish the loader's state to a shared memory segment
+ * @param segmentName - [in] shared memory object name, empty for the
+ * process' default name
+ * @param interval - [in] time between updates
+ * @return name of the published segment
+ */
+dyn_string DynLoader::PublishStats(const dyn_string& segmentName, std::chrono::milliseconds interval)
+{
+	// The current publisher may own a segment of the same name
+	StopPublishingStats();
+
+	std::unique_ptr<DynStatsSegment> segment(new DynStatsSegment(
+			segmentName.empty() ? DynStatsSegment::DefaultName(ProcessId()) : segmentName,
+			DynSegmentAccess::Publish));
+
+	StatsPublisher* started = new StatsPublisher(std::move(segment), interval,
+			[this](DynSegmentData& data) { CollectSegment(data); });
+	const dyn_string name = started->Name();
+
+	StatsPublisher* previous = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(publisherMutex);
+		previous = publisher;
+		publisher = started;
+	}
+	delete previous;
+
+	return name;
+}
+
+/**
+ * @brief Stop publishing and remove the stats segment
+ */
+void DynLoader::StopPublishingStats()
+{
+	StatsPublisher* previous = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(publisherMutex);
+		std::swap(previous, publisher);
+	}
+	delete previous;
+}
+
+} // namespace DynLoader
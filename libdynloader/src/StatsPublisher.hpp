@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __STATSPUBLISHER_HPP__
+#define __STATSPUBLISHER_HPP__
+
+#include <platform.h>
+
+#include <DynStatsSegment.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @class StatsPublisher
+ * @brief Worker thread copying a loader's state into a stats segment
+ *
+ * The state is collected and written on the worker only, the loader's
+ * own operations never touch the segment.
+ */
+class API_LOCAL StatsPublisher
+{
+public:
+	typedef std::function<void(DynSegmentData&)> Collector;
+
+private:
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::unique_ptr<DynStatsSegment> segment;
+	Collector collect;
+	std::chrono::milliseconds interval;
+	/* @brief Collected state, only used by the worker */
+	std::unique_ptr<DynSegmentData> data;
+	bool stopping;
+	std::thread thread;
+
+	/**
+	 * @brief Worker thread loop
+	 */
+	void Run();
+
+	/**
+	 * @brief Collect the state and write it to the segment
+	 */
+	void Publish();
+
+public:
+	/**
+	 * @brief Publish once and start the worker thread
+	 * @param segment - [in] published segment
+	 * @param interval - [in] time between updates
+	 * @param collect - [in] function filling the segment data
+	 */
+	StatsPublisher(std::unique_ptr<DynStatsSegment> segment, std::chrono::milliseconds interval,
+			Collector collect);
+
+	/**
+	 * @brief Join the worker thread and remove the segment
+	 */
+	~StatsPublisher();
+
+	/* @brief Disable copy constructors */
+	StatsPublisher(const StatsPublisher&) = delete;
+	StatsPublisher& operator=(const StatsPublisher&) = delete;
+
+	/**
+	 * @brief Join the worker thread, the segment keeps its last update
+	 */
+	void Stop();
+
+	/**
+	 * @brief Start the worker thread again after Stop()
+	 */
+	void Start();
+
+	/**
+	 * @brief Get the name of the published segment
+	 */
+	const dyn_string& Name() const { return segment->Name(); }
+
+}; // class StatsPublisher
+
+} // namespace DynLoader
+
+#endif // __STATSPUBLISHER_HPP__
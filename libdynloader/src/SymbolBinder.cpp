@@ -0,0 +1,309 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include "SymbolBinder.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define DYN_BIND_LAZY_SYMBOLS 1
+#include <dlfcn.h>
+#include <elf.h>
+#include <link.h>
+#endif
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+#if DYN_BIND_LAZY_SYMBOLS
+
+namespace
+{
+
+#if defined(__x86_64__)
+const uint16_t HostMachine = EM_X86_64;
+const uint32_t JumpSlot = R_X86_64_JUMP_SLOT;
+#else
+const uint16_t HostMachine = EM_AARCH64;
+const uint32_t JumpSlot = R_AARCH64_JUMP_SLOT;
+#endif
+
+/**
+ * @brief Dynamic segment entries needed to bind the function slots
+ */
+struct LazyTables
+{
+	uint64_t jmprel;
+	uint64_t jmprelSize;
+	uint64_t symtab;
+	uint64_t strtab;
+	uint64_t strSize;
+	uint64_t versym;
+	uint64_t verneed;
+	uint64_t verneedCount;
+	bool rela;
+	bool bindNow;
+
+	LazyTables() : jmprel(0), jmprelSize(0), symtab(0), strtab(0), strSize(0), versym(0),
+			verneed(0), verneedCount(0), rela(false), bindNow(false)
+	{
+	}
+};
+
+/**
+ * @brief Module file with virtual addresses mapped back to file offsets
+ */
+class ModuleImage
+{
+private:
+	const MappedFile& file;
+	const Elf64_Phdr* phdrs;
+	unsigned phdrCount;
+
+public:
+	ModuleImage(const MappedFile& file, const Elf64_Phdr* phdrs, unsigned phdrCount) :
+			file(file), phdrs(phdrs), phdrCount(phdrCount)
+	{
+	}
+
+	/**
+	 * @brief Get a bounds checked view of file backed memory
+	 * @param address - [in] virtual address of the first element
+	 * @param count - [in] number of elements
+	 * @return first element, nullptr if not backed by the file
+	 */
+	template<typename T>
+	const T* At(uint64_t address, uint64_t count = 1) const
+	{
+		for(unsigned i = 0; i < phdrCount; ++i)
+		{
+			const Elf64_Phdr& phdr = phdrs[i];
+			if(phdr.p_type == PT_LOAD && address >= phdr.p_vaddr && address - phdr.p_vaddr < phdr.p_filesz)
+				return file.At<T>(phdr.p_offset + (address - phdr.p_vaddr), count);
+		}
+
+		return nullptr;
+	}
+};
+
+/**
+ * @brief Read the dynamic segment of a module file
+ * @param dyn - [in] dynamic entries
+ * @param dynCount - [in] number of dynamic entries
+ * @return tables
+ */
+LazyTables ReadTables(const Elf64_Dyn* dyn, uint64_t dynCount)
+{
+	LazyTables tables;
+
+	for(uint64_t i = 0; i < dynCount && dyn[i].d_tag != DT_NULL; ++i)
+	{
+		switch(dyn[i].d_tag)
+		{
+		case DT_JMPREL: tables.jmprel = dyn[i].d_un.d_ptr; break;
+		case DT_PLTRELSZ: tables.jmprelSize = dyn[i].d_un.d_val; break;
+		case DT_PLTREL: tables.rela = dyn[i].d_un.d_val == DT_RELA; break;
+		case DT_SYMTAB: tables.symtab = dyn[i].d_un.d_ptr; break;
+		case DT_STRTAB: tables.strtab = dyn[i].d_un.d_ptr; break;
+		case DT_STRSZ: tables.strSize = dyn[i].d_un.d_val; break;
+		case DT_VERSYM: tables.versym = dyn[i].d_un.d_ptr; break;
+		case DT_VERNEED: tables.verneed = dyn[i].d_un.d_ptr; break;
+		case DT_VERNEEDNUM: tables.verneedCount = dyn[i].d_un.d_val; break;
+		case DT_BIND_NOW: tables.bindNow = true; break;
+		case DT_FLAGS: tables.bindNow |= (dyn[i].d_un.d_val & DF_BIND_NOW) != 0; break;
+		case DT_FLAGS_1: tables.bindNow |= (dyn[i].d_un.d_val & DF_1_NOW) != 0; break;
+		default: break;
+		}
+	}
+
+	return tables;
+}
+
+/**
+ * @brief Collect the names of the symbol versions a module requires
+ * @param image - [in] module file
+ * @param tables - [in] dynamic tables
+ * @param strings - [in] string table
+ * @param versions - [out] version name by version index
+ */
+void ReadVersions(const ModuleImage& image, const LazyTables& tables, const char* strings,
+		std::unordered_map<uint16_t, const char*>& versions)
+{
+	uint64_t address = tables.verneed;
+	for(uint64_t i = 0; i < tables.verneedCount && address != 0; ++i)
+	{
+		const Elf64_Verneed* need = image.At<Elf64_Verneed>(address);
+		if(need == nullptr)
+			return;
+
+		uint64_t auxAddress = address + need->vn_aux;
+		for(unsigned j = 0; j < need->vn_cnt; ++j)
+		{
+			const Elf64_Vernaux* aux = image.At<Elf64_Vernaux>(auxAddress);
+			if(aux == nullptr)
+				return;
+
+			if(aux->vna_name < tables.strSize)
+				versions[static_cast<uint16_t>(aux->vna_other)] = strings + aux->vna_name;
+
+			if(aux->vna_next == 0)
+				break;
+			auxAddress += aux->vna_next;
+		}
+
+		if(need->vn_next == 0)
+			break;
+		address += need->vn_next;
+	}
+}
+
+} // anonymous namespace
+
+#endif // DYN_BIND_LAZY_SYMBOLS
+
+/**
+ * @brief Bind the function slots of a lazily bound module ahead of use
+ * @param handle - [in] module handle
+ * @param deepBind - [in] the module was opened preferring its own symbols
+ * @return number of slots bound
+ *
+ * The tables are read from the module file, the unbound value of a slot is
+ * its file content relocated by the load address.
+ */
+size_t BindLazySymbols(DYN_HANDLE handle, bool deepBind)
+{
+#if DYN_BIND_LAZY_SYMBOLS
+	struct link_map* map = nullptr;
+	if(::dlinfo(handle, RTLD_DI_LINKMAP, &map) != 0 || map == nullptr ||
+			map->l_name == nullptr || map->l_name[0] == '\0')
+		return 0;
+
+	MappedFile file(map->l_name);
+	const Elf64_Ehdr* ehdr = file.IsValid() ? file.At<Elf64_Ehdr>(0) : nullptr;
+	if(ehdr == nullptr || std::memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+			ehdr->e_ident[EI_CLASS] != ELFCLASS64 || ehdr->e_machine != HostMachine ||
+			ehdr->e_phentsize != sizeof(Elf64_Phdr))
+		return 0;
+
+	const Elf64_Phdr* phdrs = file.At<Elf64_Phdr>(ehdr->e_phoff, ehdr->e_phnum);
+	if(phdrs == nullptr)
+		return 0;
+
+	const Elf64_Dyn* dyn = nullptr;
+	uint64_t dynCount = 0;
+	for(unsigned i = 0; i < ehdr->e_phnum && dyn == nullptr; ++i)
+	{
+		if(phdrs[i].p_type == PT_DYNAMIC)
+		{
+			dynCount = phdrs[i].p_filesz / sizeof(Elf64_Dyn);
+			dyn = file.At<Elf64_Dyn>(phdrs[i].p_offset, dynCount);
+		}
+	}
+	if(dyn == nullptr)
+		return 0;
+
+	const LazyTables tables = ReadTables(dyn, dynCount);
+	if(tables.bindNow || !tables.rela || tables.jmprel == 0)
+		return 0;
+
+	const ModuleImage image(file, phdrs, ehdr->e_phnum);
+	const uint64_t relocCount = tables.jmprelSize / sizeof(Elf64_Rela);
+	const Elf64_Rela* relocs = image.At<Elf64_Rela>(tables.jmprel, relocCount);
+	const char* strings = image.At<char>(tables.strtab, tables.strSize);
+	if(relocs == nullptr || strings == nullptr)
+		return 0;
+
+	std::unordered_map<uint16_t, const char*> versions;
+	if(tables.versym != 0)
+		ReadVersions(image, tables, strings, versions);
+
+	const uintptr_t base = static_cast<uintptr_t>(map->l_addr);
+	void* const scopes[2] = { deepBind ? handle : RTLD_DEFAULT, deepBind ? RTLD_DEFAULT : handle };
+
+	size_t bound = 0;
+	for(uint64_t i = 0; i < relocCount; ++i)
+	{
+		const Elf64_Rela& reloc = relocs[i];
+		if(ELF64_R_TYPE(reloc.r_info) != JumpSlot)
+			continue;
+
+		const uint64_t index = ELF64_R_SYM(reloc.r_info);
+		const Elf64_Sym* sym = image.At<Elf64_Sym>(tables.symtab + index * sizeof(Elf64_Sym));
+		const uint64_t* unbound = image.At<uint64_t>(reloc.r_offset);
+		if(sym == nullptr || unbound == nullptr || sym->st_name >= tables.strSize)
+			continue;
+
+		uintptr_t* slot = reinterpret_cast<uintptr_t*>(base + reloc.r_offset);
+		if(__atomic_load_n(slot, __ATOMIC_RELAXED) != base + *unbound)
+			continue;
+
+		const char* version = nullptr;
+		if(tables.versym != 0)
+		{
+			const uint16_t* versym = image.At<uint16_t>(tables.versym + index * sizeof(uint16_t));
+			if(versym != nullptr)
+			{
+				auto it = versions.find(static_cast<uint16_t>(*versym & 0x7fff));
+				if(it != versions.end())
+					version = it->second;
+			}
+		}
+
+		const char* name = strings + sym->st_name;
+		void* address = nullptr;
+		for(void* scope : scopes)
+		{
+			address = version != nullptr ? ::dlvsym(scope, name, version) : ::dlsym(scope, name);
+			if(address != nullptr)
+				break;
+		}
+
+		// Unresolvable weak references are left to the lazy resolver
+		if(address == nullptr)
+			continue;
+
+		__atomic_store_n(slot, reinterpret_cast<uintptr_t>(address), __ATOMIC_RELAXED);
+		++bound;
+	}
+
+	return bound;
+#else
+	(void) handle;
+	(void) deepBind;
+	return 0;
+#endif
+}
+
+} // namespace DynLoader
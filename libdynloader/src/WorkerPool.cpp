@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <platform.h>
+
+#include <WorkerPool.hpp>
+
+/**
+ * @namespace DynLoader
+ */
+namespace DynLoader
+{
+
+/**
+ * @brief Start the worker threads
+ * @param threadCount - [in] number of threads, 0 for one per core
+ */
+WorkerPool::WorkerPool(unsigned threadCount) :
+		mutex(), wakeup(), idle(), tasks(), threads(), running(0), stopping(false)
+{
+	if(threadCount == 0)
+		threadCount = DefaultThreadCount();
+
+	threads.reserve(threadCount);
+	for(unsigned i = 0; i < threadCount; ++i)
+		threads.push_back(std::thread(&WorkerPool::Run, this));
+}
+
+/**
+ * @brief Finish queued tasks and join the worker threads
+ */
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeup.notify_all();
+
+	for(auto& thread : threads)
+		thread.join();
+}
+
+/**
+ * @brief Queue a task
+ * @param task - [in] task, must not throw
+ */
+void WorkerPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	wakeup.notify_one();
+}
+
+/**
+ * @brief Wait until all queued tasks have finished
+ */
+void WorkerPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this]() { return tasks.empty() && running == 0; });
+}
+
+/**
+ * @brief Worker thread loop
+ */
+void WorkerPool::Run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for(;;)
+	{
+		wakeup.wait(lock, [this]() { return stopping || !tasks.empty(); });
+		if(tasks.empty())
+			return;
+
+		std::function<void()> task(std::move(tasks.front()));
+		tasks.pop_front();
+		++running;
+
+		lock.unlock();
+		task();
+		lock.lock();
+
+		if(--running == 0 && tasks.empty())
+			idle.notify_all();
+	}
+}
+
+/**
+ * @brief Get the default number of worker threads
+ * @return number of cores, at least 1
+ */
+unsigned WorkerPool::DefaultThreadCount()
+{
+	const unsigned cores = std::thread::hardware_concurrency();
+
+	return cores ? cores : 1;
+}
+
+} // namespace DynLoader
@@ -0,0 +1,166 @@
+/**
+ * Copyright (c) 2007-2008, Igor Semenov
+ * Copyright (c) 2010-2012, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors 
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <platform.h>
+
+#include <DynLoader.hpp>
+#include <LoaderException.hpp>
+
+#include "TestInterface.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Time loading libraries and creating a class instance of each
+ * @param libNames - [in] library file names, copies of one module
+ * @param className - [in] class name
+ * @param title - [in] printed mode name
+ * @param options - [in] load options
+ * @param iterations - [in] number of load and unload cycles
+ *
+ * All libraries are loaded in every cycle and unloaded after it. The first
+ * and the last quarter of the loads are reported separately, global loads
+ * slow down as every earlier global library joins the lookup scope of the
+ * later ones. With noDelete the modules stay mapped and later cycles only
+ * measure the loader's own bookkeeping.
+ */
+static void BenchMode(const std::vector<DynLoader::dyn_string>& libNames, const DynLoader::dyn_string& className,
+		const char* title, const DynLoader::DynLoadOptions& options, int iterations)
+{
+	DynLoader::DynLoader dynLoader;
+	dynLoader.SetLoadOptions(options);
+
+	const size_t quarter = std::max<size_t>(1, libNames.size() / 4);
+	std::chrono::nanoseconds first(0), last(0);
+	for(int n = 0; n < iterations; ++n)
+	{
+		for(size_t i = 0; i < libNames.size(); ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			dynLoader.GetClassInstance<DynLoader::ITest>(libNames[i], className);
+			const std::chrono::nanoseconds elapsed = std::chrono::steady_clock::now() - start;
+
+			if(i < quarter)
+				first += elapsed;
+			if(i >= libNames.size() - quarter)
+				last += elapsed;
+		}
+
+		dynLoader.Reset();
+	}
+
+	const double loads = static_cast<double>(quarter) * iterations;
+	printf("%-16s %10.1f %10.1f us/load\n", title,
+			std::chrono::duration<double, std::micro>(first).count() / loads,
+			std::chrono::duration<double, std::micro>(last).count() / loads);
+}
+
+/**
+ * @brief Copy a file
+ * @param from - [in] source file
+ * @param to - [in] target file
+ * @return true on success
+ */
+static bool CopyFile(const DynLoader::dyn_string& from, const DynLoader::dyn_string& to)
+{
+	std::ifstream in(from.c_str(), std::ios::binary);
+	std::ofstream out(to.c_str(), std::ios::binary | std::ios::trunc);
+	out << in.rdbuf();
+
+	return in && out;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 3)
+	{
+		fprintf(stderr, "Usage %s <libName> <className> [<libraries>] [<iterations>]\n", argv[0]);
+		return 1;
+	}
+
+	const DynLoader::dyn_string libName(argv[1]);
+	const DynLoader::dyn_string className(argv[2]);
+	const int libraries = argc > 3 ? std::max(1, atoi(argv[3])) : 64;
+	const int iterations = argc > 4 ? std::max(1, atoi(argv[4])) : 20;
+
+	// Copies are distinct modules to the system loader
+	std::vector<DynLoader::dyn_string> libNames;
+	for(int i = 0; i < libraries; ++i)
+	{
+		libNames.push_back("./benchloadmodes" + std::to_string(i) + DYN_MODULE_SUFFIX);
+		if(!CopyFile(libName, libNames.back()))
+		{
+			fprintf(stderr, "Unable to copy `%s`\n", libName.c_str());
+			return 1;
+		}
+	}
+
+	int result = 0;
+	try
+	{
+		printf("%-16s %10s %10s\n", "", "first", "last");
+
+		DynLoader::DynLoadOptions options;
+		BenchMode(libNames, className, "global now", options, iterations);
+
+		options.scope = DynLoader::SymbolScope::Local;
+		BenchMode(libNames, className, "local now", options, iterations);
+
+		options.binding = DynLoader::SymbolBinding::Lazy;
+		BenchMode(libNames, className, "local lazy", options, iterations);
+
+		options.bindInBackground = true;
+		BenchMode(libNames, className, "local lazy+bind", options, iterations);
+
+		options = DynLoader::DynLoadOptions();
+		options.deepBind = true;
+		BenchMode(libNames, className, "deepbind now", options, iterations);
+
+		options = DynLoader::DynLoadOptions();
+		options.noDelete = true;
+		BenchMode(libNames, className, "nodelete now", options, iterations);
+	}
+	catch(DynLoader::LoaderException& ex)
+	{
+		fprintf(stderr, "Loader exception: %s\n", ex.what());
+		result = 1;
+	}
+
+	for(auto& name : libNames)
+		std::remove(name.c_str());
+
+	return result;
+}
@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2007-2008, Igor Semenov
+ * Copyright (c) 2010-2012, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors 
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <platform.h>
+
+#include <DynLoader.hpp>
+#include <LoaderException.hpp>
+
+#include "TestInterface.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Call instances from one thread each for a while
+ * @param instances - [in] instance per thread
+ * @return calls per second of all threads
+ *
+ * The test classes write to stderr, which is redirected to /dev/null
+ * meanwhile. Threads calling into the same namespace share the C
+ * library's stream lock, threads in different namespaces do not.
+ */
+static double Run(const std::vector<DynLoader::ITest*>& instances)
+{
+	const int saved = ::dup(2);
+	const int null = ::open("/dev/null", O_WRONLY);
+	::dup2(null, 2);
+
+	std::atomic<bool> start(false), done(false);
+	std::vector<unsigned long> calls(instances.size(), 0);
+	std::vector<std::thread> threads;
+	for(size_t t = 0; t < instances.size(); ++t)
+	{
+		threads.push_back(std::thread([&, t]()
+		{
+			while(!start)
+				std::this_thread::yield();
+
+			unsigned long count = 0;
+			while(!done)
+			{
+				instances[t]->DoSomething();
+				++count;
+			}
+			calls[t] = count;
+		}));
+	}
+
+	start = true;
+	std::this_thread::sleep_for(std::chrono::milliseconds(500));
+	done = true;
+
+	for(auto& thread : threads)
+		thread.join();
+
+	::dup2(saved, 2);
+	::close(saved);
+	::close(null);
+
+	unsigned long total = 0;
+	for(auto count : calls)
+		total += count;
+
+	return total / 0.5;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 3)
+	{
+		fprintf(stderr, "Usage %s <libName> <className> [<tenants>]\n", argv[0]);
+		return 1;
+	}
+
+	const DynLoader::dyn_string libName(argv[1]);
+	const DynLoader::dyn_string className(argv[2]);
+	const int tenants = argc > 3 ? std::max(1, atoi(argv[3])) : 8;
+
+	try
+	{
+		DynLoader::DynLoader dynLoader;
+
+		DynLoader::ITest* shared = dynLoader.GetClassInstance<DynLoader::ITest>(libName, className);
+		std::vector<DynLoader::ITest*> isolated;
+		for(int t = 0; t < tenants; ++t)
+		{
+			const DynLoader::DynNamespace space = dynLoader.CreateNamespace();
+			isolated.push_back(dynLoader.GetClassInstance<DynLoader::ITest>(space, libName, className));
+		}
+
+		printf("%8s %16s %16s\n", "tenants", "shared calls/s", "isolated calls/s");
+		for(int t = 1; t <= tenants; t *= 2)
+		{
+			const double sharedRate = Run(std::vector<DynLoader::ITest*>(t, shared));
+			const double isolatedRate = Run(std::vector<DynLoader::ITest*>(isolated.begin(), isolated.begin() + t));
+
+			printf("%8d %16.0f %16.0f\n", t, sharedRate, isolatedRate);
+		}
+	}
+	catch(DynLoader::LoaderException& ex)
+	{
+		fprintf(stderr, "Loader exception: %s\n", ex.what());
+		return 1;
+	}
+
+	return 0;
+}
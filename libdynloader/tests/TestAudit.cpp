@@ -0,0 +1,170 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdio>
+
+#include <platform.h>
+
+#include "UnitTest.hpp"
+
+#include <DynAudit.hpp>
+#include <DynLoader.hpp>
+#include <LoaderException.hpp>
+
+#include "TestInterface.hpp"
+
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+static const char AuditFile[] = "TestAudit.log";
+
+/**
+ * @brief Open line of the audit file
+ */
+struct AuditLoad
+{
+	AuditLoad() : ok(0), total(0), phases(0), objects(0), relocs(0), plt(0), bound(0)
+	{
+	}
+
+	int ok;
+	unsigned long long total;
+	unsigned long long phases;
+	unsigned long long objects;
+	unsigned long long relocs;
+	unsigned long long plt;
+	unsigned long long bound;
+};
+
+/**
+ * @brief Read the loads and unloads of a library from the audit file
+ * @param libName - [in] library file name
+ * @param loads - [out] open lines of the library
+ * @return number of close lines of the library
+ */
+static size_t ReadAuditFile(const std::string& libName, std::vector<AuditLoad>& loads)
+{
+	std::ifstream file(AuditFile);
+	std::string line;
+	size_t closes = 0;
+
+	while(std::getline(file, line))
+	{
+		const size_t tab = line.rfind('\t');
+		if(tab == std::string::npos || line.substr(tab + 1) != libName)
+			continue;
+
+		std::istringstream fields(line);
+		std::string type;
+		unsigned long long pid, start, wait, search, map, reloc, init, relative, lazy;
+		fields >> type;
+
+		if(type == "close")
+		{
+			++closes;
+			continue;
+		}
+
+		AuditLoad load;
+		fields >> pid >> load.ok >> start >> load.total >> wait >> search >> map >> reloc >> init >>
+				load.objects >> load.relocs >> relative >> load.plt >> load.bound >> lazy;
+		load.phases = wait + search + map + reloc + init;
+		loads.push_back(load);
+	}
+
+	return closes;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 4)
+	{
+		fprintf(stderr, "Usage %s <auditModule> <libName> <className>\n", argv[0]);
+		return 1;
+	}
+
+	// The system loader only reads LD_AUDIT at startup
+	if(getenv("LD_AUDIT") == nullptr)
+	{
+		char module[PATH_MAX];
+		UNIT_TEST(realpath(argv[1], module) != nullptr);
+		setenv("LD_AUDIT", module, 1);
+		setenv(DYN_AUDIT_FILE_VARIABLE, AuditFile, 1);
+		std::remove(AuditFile);
+
+		execv(argv[0], argv);
+		UNIT_TEST(false);
+	}
+
+	const std::string libName(argv[2]);
+
+	try
+	{
+		DynLoader::DynLoader dynLoader;
+
+		// Bound while relocating
+		UNIT_TEST(dynLoader.GetClassInstance<DynLoader::ITest>(libName, argv[3]) != nullptr);
+		dynLoader.Reset();
+
+		// Bound on the first calls
+		DynLoader::DynLoadOptions options;
+		options.binding = DynLoader::SymbolBinding::Lazy;
+		dynLoader.SetLoadOptions(libName, options);
+		UNIT_TEST(dynLoader.GetClassInstance<DynLoader::ITest>(libName, argv[3]) != nullptr);
+		dynLoader.Reset();
+	}
+	catch(DynLoader::LoaderException& ex)
+	{
+		fprintf(stderr, "Loader exception: %s\n", ex.what());
+		UNIT_TEST(false);
+	}
+
+	std::vector<AuditLoad> loads;
+	const size_t closes = ReadAuditFile(libName, loads);
+	UNIT_TEST(loads.size() == 2 && closes == 2);
+
+	for(auto& load : loads)
+	{
+		fprintf(stderr, "total %lluns, %llu objects, %llu relocations, %llu PLT, %llu bound\n",
+				load.total, load.objects, load.relocs, load.plt, load.bound);
+		UNIT_TEST(load.ok == 1 && load.objects >= 1);
+		UNIT_TEST(load.phases == load.total);
+		UNIT_TEST(load.relocs >= load.plt && load.plt > 0);
+	}
+
+	UNIT_TEST(loads[0].bound > 0);
+	UNIT_TEST(loads[1].bound == 0);
+
+	std::remove(AuditFile);
+
+	return 0;
+}
@@ -30,9 +30,33 @@
 #include "TestClass.hpp"
 #include <cstdio>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 namespace DynLoader
 {
 
+namespace
+{
+
+std::atomic<int> parallelArrivals(0);
+
+/**
+ * @brief Wait until both Parallel constructors have started
+ * Gives up after a few seconds so serialized construction is slow, not hung.
+ */
+void WaitForParallelConstruction()
+{
+	++parallelArrivals;
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+	while(parallelArrivals < 2 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+}
+
 /**
  * @brief Test method
  */
@@ -49,5 +73,67 @@ void Test2::DoSomething() throw()
 	fprintf(stderr, "Test2::DoSomething()\n");
 }
 
+/**
+ * @brief Constructor
+ */
+Buffered::Buffered() : buffer(1024, 1)
+{
+}
+
+void Buffered::DoSomething() throw()
+{
+	fprintf(stderr, "Buffered::DoSomething() %zu\n", buffer.size());
 }
 
+Parallel1::Parallel1()
+{
+	WaitForParallelConstruction();
+}
+
+/**
+ * @brief Test method
+ */
+void Parallel1::DoSomething() throw()
+{
+	fprintf(stderr, "Parallel1::DoSomething()\n");
+}
+
+/**
+ * @brief Constructor
+ */
+Parallel2::Parallel2()
+{
+	WaitForParallelConstruction();
+}
+
+/**
+ * @brief Test method
+ */
+void Parallel2::DoSomething() throw()
+{
+	fprintf(stderr, "Parallel2::DoSomething()\n");
+}
+
+/**
+ * @brief Prepare the module for requests
+ */
+static void WarmUp()
+{
+	fprintf(stderr, "WarmUp()\n");
+}
+
+EXPORT_DYNMODULE_WARMUP(WarmUp)
+
+/**
+ * @brief Reopen per-process resources in forked workers
+ * @param phase - [in] fork phase
+ */
+static void Fork(DynLoader::DynForkPhase phase)
+{
+	if(phase == DynLoader::DynForkPhase::Child)
+		fprintf(stderr, "Fork(Child)\n");
+}
+
+EXPORT_DYNMODULE_FORK(Fork)
+
+}
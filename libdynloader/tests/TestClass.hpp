@@ -31,6 +31,8 @@
 
 #include "TestInterface.hpp"
 
+#include <vector>
+
 namespace DynLoader
 {
 
@@ -64,5 +66,64 @@ public:
 
 EXPORT_DYNCLASS(Test2)
 
+class API_LOCAL Buffered : public ITest
+{
+private:
+	std::vector<int, DynModuleAllocator<int>> buffer;
+
+public:
+	/**
+	 * @brief Constructor, fills a buffer allocated from the module allocator
+	 */
+	Buffered();
+
+	/**
+	 * @brief Test method
+	 */
+	void DoSomething() throw();
+};
+
+EXPORT_DYNCLASS(Buffered)
+
+/**
+ * @class Parallel1
+ * @brief Test class whose constructor waits for Parallel2 to be constructed
+ */
+class API_LOCAL Parallel1 : public ITest
+{
+public:
+	/**
+	 * @brief Constructor, blocks until both classes are being constructed
+	 */
+	Parallel1();
+
+	/**
+	 * @brief Test method
+	 */
+	void DoSomething() throw();
+};
+
+EXPORT_DYNCLASS(Parallel1)
+
+/**
+ * @class Parallel2
+ * @brief Test class whose constructor waits for Parallel1 to be constructed
+ */
+class API_LOCAL Parallel2 : public ITest
+{
+public:
+	/**
+	 * @brief Constructor, blocks until both classes are being constructed
+	 */
+	Parallel2();
+
+	/**
+	 * @brief Test method
+	 */
+	void DoSomething() throw();
+};
+
+EXPORT_DYNCLASS(Parallel2)
+
 }
 
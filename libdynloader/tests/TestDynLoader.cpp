@@ -26,17 +26,91 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <link.h>
+#endif
 
 #include <platform.h>
 
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "UnitTest.hpp"
 
 #include <DynLoader.hpp>
+#include <ElfScanner.hpp>
+#include <HotReloader.hpp>
 #include <LoaderException.hpp>
+#include <PluginCatalog.hpp>
 
 #include "TestInterface.hpp"
 
+using namespace DynLoader::Literals;
+
+/**
+ * @brief Install a copy of a file by renaming it over the target
+ * @param from - [in] source file
+ * @param to - [in] target file
+ * @return true on success
+ */
+static bool InstallFile(const DynLoader::dyn_string& from, const DynLoader::dyn_string& to)
+{
+	const DynLoader::dyn_string temporary = to + ".new";
+	{
+		std::ifstream in(from.c_str(), std::ios::binary);
+		std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		out << in.rdbuf();
+		if(!in || !out)
+			return false;
+	}
+
+	return std::rename(temporary.c_str(), to.c_str()) == 0;
+}
+
+/**
+ * @brief Create an empty directory
+ * @param directory - [in] directory name
+ * @return true on success
+ */
+static bool MakeDirectory(const DynLoader::dyn_string& directory)
+{
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+	return _mkdir(directory.c_str()) == 0;
+#else
+	return mkdir(directory.c_str(), 0755) == 0;
+#endif
+}
+
+/**
+ * @brief Remove an empty directory
+ * @param directory - [in] directory name
+ * @return true on success
+ */
+static bool RemoveDirectory(const DynLoader::dyn_string& directory)
+{
+#if PLATFORM_WIN32_VC || PLATFORM_WIN32_MINGW
+	return _rmdir(directory.c_str()) == 0;
+#else
+	return rmdir(directory.c_str()) == 0;
+#endif
+}
+
 int main(int argc, char** argv)
 {
 	if(argc < 2)
@@ -52,6 +126,46 @@ int main(int argc, char** argv)
 		
 		dynLoader->Reset();
 		UNIT_TEST(true);
+
+#if PLATFORM_POSIX
+		// Exported classes are listed without loading the module
+		std::vector<DynLoader::dyn_string> classNames;
+		UNIT_TEST(DynLoader::ElfScanner::ScanLibrary(DynLoader::dyn_string(argv[1]), classNames));
+		for(int i = 2; i < argc; ++i)
+			UNIT_TEST(std::find(classNames.begin(), classNames.end(), DynLoader::dyn_string(argv[i])) != classNames.end());
+		UNIT_TEST(dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) == nullptr);
+
+		DynLoader::ClassLibraryMap classes;
+		UNIT_TEST(DynLoader::ElfScanner::ScanDirectory(".", classes) >= 1);
+		UNIT_TEST(classes.count(DynLoader::dyn_string(argv[2])) == 1);
+		UNIT_TEST(!DynLoader::ElfScanner::ScanLibrary("SomeDefinitelyNotExistentFile", classNames));
+
+		// Catalog lookups find the library by class name, unchanged
+		// libraries are not scanned again when the catalog is updated
+		UNIT_TEST(DynLoader::PluginCatalog::Build("TestDynLoader.catalog", ".") >= 1);
+		UNIT_TEST(DynLoader::PluginCatalog::Build("TestDynLoader.catalog", ".") == 0);
+		UNIT_TEST(dynLoader->OpenCatalog("TestDynLoader.catalog"));
+		UNIT_TEST(!dynLoader->OpenCatalog("SomeDefinitelyNotExistentFile"));
+
+		DynLoader::ITest* byClass = dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[2]));
+		UNIT_TEST(byClass != nullptr);
+		UNIT_TEST(byClass == dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2])));
+
+		bool missing = false;
+		try
+		{
+			dynLoader->GetClassInstance<DynLoader::ITest>("SomeDefinitelyNotExistentClass");
+		}
+		catch(DynLoader::LoaderException&)
+		{
+			missing = true;
+		}
+		UNIT_TEST(missing);
+		std::remove("TestDynLoader.catalog");
+
+		dynLoader->Reset();
+		UNIT_TEST(true);
+#endif
 	
 		for(int i = 2; i < argc; ++i)
 		{
@@ -60,8 +174,67 @@ int main(int argc, char** argv)
 			UNIT_TEST(true);
 		}
 		
+		// The same module requested under another spelling must resolve
+		// to the already loaded library
+		DynLoader::DynLib* lib = dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1]));
+		UNIT_TEST(lib != nullptr);
+		UNIT_TEST(dynLoader->GetLoadedLibrary("./" + DynLoader::dyn_string(argv[1])) == lib);
+
+		// Classes are described by the module's class list
+		const DynLoader::DynClassInfo* info = dynLoader->GetClassInfo(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2]));
+		UNIT_TEST(info != nullptr && info->hash == DynLoader::DynClassHash(argv[2]) && info->size > 0);
+
+		// Compile time class identifiers resolve to the same instances
+		static_assert("Test1"_cls.hash == DynLoader::DynClassHash("Test1"), "class id not hashed at compile time");
+		UNIT_TEST(dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DYN_CLASS_ID("Test1")) ==
+				dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string("Test1")));
+		UNIT_TEST(dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), "Test2"_cls) ==
+				dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string("Test2")));
+		UNIT_TEST(dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]),
+				DynLoader::DynClassId("Test2", DynLoader::DynClassHash("Test1"))) ==
+				dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string("Test2")));
+
+		// Pools construct instances in caller memory and recycle slots
+		{
+			std::vector<unsigned char> storage(DynLoader::DynClassPool::RequiredBytes(*info, 4));
+			std::unique_ptr<DynLoader::DynClassPool> pool = dynLoader->CreatePool(DynLoader::dyn_string(argv[1]),
+					DynLoader::dyn_string(argv[2]), storage.data(), storage.size());
+			UNIT_TEST(pool->Capacity() == 4);
+
+			std::vector<DynLoader::ITest*> pooled;
+			for(size_t i = 0; i < pool->Capacity(); ++i)
+				pooled.push_back(pool->Create<DynLoader::ITest>());
+			UNIT_TEST(pooled.back() != nullptr && pool->Create<DynLoader::ITest>() == nullptr);
+			UNIT_TEST(reinterpret_cast<unsigned char*>(pooled.front()) >= storage.data() &&
+					reinterpret_cast<unsigned char*>(pooled.back()) < storage.data() + storage.size());
+			pooled.front()->DoSomething();
+
+			DynLoader::ITest* recycled = pooled.back();
+			recycled->Destroy();
+			UNIT_TEST(pool->Available() == 1);
+			UNIT_TEST(pool->Create<DynLoader::ITest>() == recycled);
+		}
+
+		// Factories hand out a new instance on every call
+		auto factory = dynLoader->GetFactory<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2]));
+		UNIT_TEST(factory);
+
+		DynLoader::ITest* first = factory();
+		DynLoader::ITest* second = factory();
+		UNIT_TEST(first != nullptr && second != nullptr && first != second);
+		first->DoSomething();
+		first->Destroy();
+		second->Destroy();
+
+		DynLoader::ITest* created = dynLoader->CreateInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2]));
+		UNIT_TEST(created != nullptr);
+		UNIT_TEST(created != dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2])));
+		created->Destroy();
+
 		dynLoader->Reset();
 		UNIT_TEST(true);
+
+		UNIT_TEST(dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) == nullptr);
 		
 		for(int i = 2; i < argc; ++i)
 		{
@@ -73,9 +246,495 @@ int main(int argc, char** argv)
 		dynLoader->Reset();
 		UNIT_TEST(true);
 
+		// Bulk preload reports failures per library instead of throwing
+		std::vector<DynLoader::dyn_string> preload;
+		preload.push_back(DynLoader::dyn_string(argv[1]));
+		preload.push_back("SomeDefinitelyNotExistentFile");
+
+		DynLoader::PreloadResult result = dynLoader->Preload(preload, 2);
+		UNIT_TEST(result.loaded == 1 && result.failed == 1);
+		UNIT_TEST(result.libraries[0].loaded && result.libraries[0].error.empty());
+		UNIT_TEST(!result.libraries[1].loaded && !result.libraries[1].error.empty());
+		UNIT_TEST(dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) != nullptr);
+
+		dynLoader->Reset();
+		UNIT_TEST(true);
+
+		// Directories are preloaded as a whole, the build directory holds
+		// other modules too
+		{
+			const DynLoader::dyn_string directory("./preload");
+			const DynLoader::dyn_string copy = directory + "/test_module" DYN_MODULE_SUFFIX;
+			UNIT_TEST(MakeDirectory(directory));
+			UNIT_TEST(InstallFile(DynLoader::dyn_string(argv[1]), copy));
+
+			result = dynLoader->PreloadDirectory(directory);
+			UNIT_TEST(result.loaded == 1 && result.failed == 0);
+			UNIT_TEST(dynLoader->GetLoadedLibrary(copy) != nullptr);
+
+			dynLoader->Reset();
+			UNIT_TEST(std::remove(copy.c_str()) == 0 && RemoveDirectory(directory));
+		}
+
+		// Modules opened with arenas allocate their instances from them
+		dynLoader->SetArenaMode(DynLoader::ArenaMode::ReleaseOnClose);
+		{
+			DynLoader::DynArenaStats before, after;
+			DynLoader::ITest* arenaInstance = dynLoader->CreateInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2]));
+			UNIT_TEST(arenaInstance != nullptr);
+			UNIT_TEST(dynLoader->GetArenaStats(DynLoader::dyn_string(argv[1]), before) && before.liveBytes > 0);
+			arenaInstance->Destroy();
+			UNIT_TEST(dynLoader->GetArenaStats(DynLoader::dyn_string(argv[1]), after) && after.liveBytes < before.liveBytes);
+			UNIT_TEST(after.allocations == before.allocations && after.deallocations == before.deallocations + 1);
+		}
+
 		dynLoader->Reset();
 		UNIT_TEST(true);
 
+		// Plugin containers allocate from the arena through the module allocator
+		dynLoader->SetArenaMode(DynLoader::ArenaMode::Tracked);
+		{
+			DynLoader::DynArenaStats before, during, after;
+			dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2]));
+			UNIT_TEST(dynLoader->GetArenaStats(DynLoader::dyn_string(argv[1]), before));
+
+			DynLoader::ITest* buffered = dynLoader->CreateInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), "Buffered");
+			UNIT_TEST(buffered != nullptr);
+			buffered->DoSomething();
+			UNIT_TEST(dynLoader->GetArenaStats(DynLoader::dyn_string(argv[1]), during));
+			UNIT_TEST(during.liveBytes >= before.liveBytes + 1024 * sizeof(int) && during.allocations == before.allocations + 2);
+
+			buffered->Destroy();
+			UNIT_TEST(dynLoader->GetArenaStats(DynLoader::dyn_string(argv[1]), after));
+			UNIT_TEST(after.liveBytes == before.liveBytes && after.deallocations == before.deallocations + 2);
+		}
+		dynLoader->SetArenaMode(DynLoader::ArenaMode::ReleaseOnClose);
+
+		// Outside of modules with an arena it falls back to the global heap
+		{
+			UNIT_TEST(DynLoader::GetModuleAllocator() == nullptr);
+			std::vector<int, DynLoader::DynModuleAllocator<int>> values(16, 1);
+			UNIT_TEST(values.size() == 16 && values.get_allocator() == DynLoader::DynModuleAllocator<long>());
+		}
+
+		dynLoader->Reset();
+		UNIT_TEST(true);
+
+		// A library only referenced by handles is closed with the last one
+		{
+			DynLoader::DynHandle<DynLoader::ITest> handle = dynLoader->GetClassHandle<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2]));
+			UNIT_TEST(handle && dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) != nullptr);
+			handle->DoSomething();
+
+			DynLoader::DynHandle<DynLoader::ITest> copy = handle;
+			UNIT_TEST(copy.Get() == handle.Get());
+			handle.Reset();
+			UNIT_TEST(!handle && dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) != nullptr);
+		}
+		UNIT_TEST(dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) == nullptr);
+
+		// Single libraries can be unloaded explicitly
+		dynLoader->GetClassInstance<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2]));
+		UNIT_TEST(dynLoader->UnloadLib(DynLoader::dyn_string(argv[1])));
+		UNIT_TEST(dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) == nullptr);
+		UNIT_TEST(!dynLoader->UnloadLib(DynLoader::dyn_string(argv[1])));
+
+		// Unloaded libraries are torn down by the reclaim thread
+		dynLoader->EnableBackgroundReclaim(4);
+		dynLoader->GetClassHandle<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2]));
+		dynLoader->FlushReclaim();
+		{
+			DynLoader::ReclaimStats reclaimStats = dynLoader->GetReclaimStats();
+			UNIT_TEST(reclaimStats.reclaimed == 1 && reclaimStats.queued == 0 && reclaimStats.failures == 0);
+			UNIT_TEST(dynLoader->GetCloseFailures() == 0);
+			UNIT_TEST(reclaimStats.overflows == 0);
+		}
+		UNIT_TEST(dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) == nullptr);
+
+		// Idle libraries stay loaded within the memory budget
+		dynLoader->SetMemoryBudget(SIZE_MAX);
+		dynLoader->GetClassHandle<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2]));
+		UNIT_TEST(dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) != nullptr);
+		{
+			std::vector<DynLoader::LibraryUsage> usage = dynLoader->GetLibraryUsage();
+			UNIT_TEST(usage.size() == 1 && usage[0].handles == 0 && usage[0].instances == 1 && !usage[0].pinned);
+			UNIT_TEST(usage[0].textBytes > 0 && usage[0].dataBytes > 0);
+		}
+		UNIT_TEST(dynLoader->EvictIdle() == 0);
+
+		// Libraries with live instances are kept above the budget too
+		dynLoader->SetMemoryBudget(1);
+		UNIT_TEST(dynLoader->EvictIdle() == 0);
+		UNIT_TEST(dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) != nullptr);
+
+		dynLoader->SetMemoryBudget(SIZE_MAX);
+		dynLoader->Reset();
+		dynLoader->Preload(std::vector<DynLoader::dyn_string>(1, DynLoader::dyn_string(argv[1])), 1);
+		dynLoader->SetMemoryBudget(1);
+		UNIT_TEST(dynLoader->EvictIdle() == 1);
+		UNIT_TEST(dynLoader->GetLoadedLibrary(DynLoader::dyn_string(argv[1])) == nullptr);
+		{
+			// Evicted libraries are opened again on demand
+			DynLoader::DynHandle<DynLoader::ITest> handle = dynLoader->GetClassHandle<DynLoader::ITest>(DynLoader::dyn_string(argv[1]), DynLoader::dyn_string(argv[2]));
+			handle->DoSomething();
+			UNIT_TEST(dynLoader->EvictIdle() == 0);
+		}
+		dynLoader->SetMemoryBudget(0);
+		dynLoader->Reset();
+
+#if defined(__linux__)
+		// Replaced plugin files are loaded alongside the old module
+		{
+			const DynLoader::dyn_string hotName("./hotreload" DYN_MODULE_SUFFIX);
+			UNIT_TEST(InstallFile(DynLoader::dyn_string(argv[1]), hotName));
+
+			DynLoader::DynHandle<DynLoader::ITest> before = dynLoader->GetClassHandle<DynLoader::ITest>(hotName, DynLoader::dyn_string(argv[2]));
+			DynLoader::DynLib* first = dynLoader->GetLoadedLibrary(hotName);
+
+			std::mutex reloadMutex;
+			std::condition_variable reloadDone;
+			size_t reloaded = 0;
+			DynLoader::HotReloader reloader(*dynLoader, [&](const DynLoader::dyn_string&, std::exception_ptr error)
+			{
+				std::lock_guard<std::mutex> lock(reloadMutex);
+				if(!error)
+					++reloaded;
+				reloadDone.notify_all();
+			});
+			UNIT_TEST(reloader.Watch(hotName));
+			UNIT_TEST(!reloader.Watch("NoDirectory" DYN_MODULE_SUFFIX));
+
+			UNIT_TEST(InstallFile(DynLoader::dyn_string(argv[1]), hotName));
+			{
+				std::unique_lock<std::mutex> lock(reloadMutex);
+				reloadDone.wait_for(lock, std::chrono::seconds(5), [&]() { return reloaded != 0; });
+				UNIT_TEST(reloaded == 1 && reloader.Reloads() == 1);
+			}
+
+			DynLoader::DynLib* second = dynLoader->GetLoadedLibrary(hotName);
+			UNIT_TEST(second != nullptr && second != first);
+
+			DynLoader::DynHandle<DynLoader::ITest> after = dynLoader->GetClassHandle<DynLoader::ITest>(hotName, DynLoader::dyn_string(argv[2]));
+			UNIT_TEST(after.Get() != before.Get());
+			before->DoSomething();
+			after->DoSomething();
+
+			UNIT_TEST(!dynLoader->ReloadLib("./notloaded" DYN_MODULE_SUFFIX));
+			std::remove(hotName.c_str());
+		}
+		UNIT_TEST(dynLoader->GetLoadedLibrary("./hotreload" DYN_MODULE_SUFFIX) == nullptr);
+
+		// Every reload runs the code of its own module
+		{
+			const DynLoader::dyn_string reloadName("./reloadtwice" DYN_MODULE_SUFFIX);
+			UNIT_TEST(InstallFile(DynLoader::dyn_string(argv[1]), reloadName));
+
+			std::vector<DynLoader::DynHandle<DynLoader::ITest>> handles;
+			std::vector<ElfW(Addr)> bases;
+			for(int i = 0; i < 3; ++i)
+			{
+				if(i != 0)
+				{
+					UNIT_TEST(InstallFile(DynLoader::dyn_string(argv[1]), reloadName));
+					UNIT_TEST(dynLoader->ReloadLib(reloadName));
+				}
+
+				handles.push_back(dynLoader->GetClassHandle<DynLoader::ITest>(reloadName, DynLoader::dyn_string(argv[2])));
+				handles.back()->DoSomething();
+
+				// Each module is mapped at its own base
+				struct link_map* map = nullptr;
+				UNIT_TEST(::dlinfo(dynLoader->GetLoadedLibrary(reloadName)->handle, RTLD_DI_LINKMAP, &map) == 0);
+				UNIT_TEST(std::find(bases.begin(), bases.end(), map->l_addr) == bases.end());
+				bases.push_back(map->l_addr);
+			}
+
+			handles.clear();
+			std::remove(reloadName.c_str());
+		}
+		UNIT_TEST(dynLoader->GetLoadedLibrary("./reloadtwice" DYN_MODULE_SUFFIX) == nullptr);
+#endif
+
+#if PLATFORM_POSIX
+		// Lazily bound local library, remaining references bound in background
+		{
+			const DynLoader::dyn_string lazyName("./lazybind" DYN_MODULE_SUFFIX);
+			UNIT_TEST(InstallFile(DynLoader::dyn_string(argv[1]), lazyName));
+
+			DynLoader::DynLoadOptions options;
+			options.scope = DynLoader::SymbolScope::Local;
+			options.binding = DynLoader::SymbolBinding::Lazy;
+			options.bindInBackground = true;
+			dynLoader->SetLoadOptions(lazyName, options);
+
+			DynLoader::DynHandle<DynLoader::ITest> handle = dynLoader->GetClassHandle<DynLoader::ITest>(lazyName, DynLoader::dyn_string(argv[2]));
+			UNIT_TEST(handle);
+			UNIT_TEST(dynLoader->GetLoadedLibrary(lazyName)->options.binding == DynLoader::SymbolBinding::Lazy);
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+			size_t bound = 0;
+			for(int n = 0; n < 500 && bound == 0; ++n)
+			{
+				for(const auto& usage : dynLoader->GetLibraryUsage())
+				{
+					if(usage.name == lazyName)
+						bound = usage.boundInBackground;
+				}
+				if(bound == 0)
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			UNIT_TEST(bound != 0);
+#endif
+			handle->DoSomething();
+
+			handle.Reset();
+			dynLoader->Reset();
+			std::remove(lazyName.c_str());
+		}
+#endif
+
+		// Loader operations are timed per thread and added up on read
+		{
+			const DynLoader::dyn_string libName(argv[1]);
+			dynLoader->FlushReclaim();
+			DynLoader::DynStats before = dynLoader->GetStats();
+			dynLoader->GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2]));
+			dynLoader->GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2]));
+			dynLoader->Reset();
+			dynLoader->FlushReclaim();
+
+			DynLoader::DynStats after = dynLoader->GetStats();
+			UNIT_TEST(after[DynLoader::DynMetric::Open].count == before[DynLoader::DynMetric::Open].count + 1);
+			UNIT_TEST(after[DynLoader::DynMetric::InstanceMiss].count == before[DynLoader::DynMetric::InstanceMiss].count + 1);
+			UNIT_TEST(after[DynLoader::DynMetric::InstanceHit].count == before[DynLoader::DynMetric::InstanceHit].count + 1);
+			UNIT_TEST(after[DynLoader::DynMetric::Construct].count == before[DynLoader::DynMetric::Construct].count + 1);
+			UNIT_TEST(after[DynLoader::DynMetric::Destroy].count == before[DynLoader::DynMetric::Destroy].count + 1);
+			UNIT_TEST(after[DynLoader::DynMetric::Close].count == before[DynLoader::DynMetric::Close].count + 1);
+			UNIT_TEST(after[DynLoader::DynMetric::Symbol].count > before[DynLoader::DynMetric::Symbol].count);
+			UNIT_TEST(after.threads >= 1);
+
+			const DynLoader::DynHistogram& open = after[DynLoader::DynMetric::Open];
+			UNIT_TEST(open.max > std::chrono::nanoseconds(0) && open.Percentile(50) <= open.max);
+			UNIT_TEST(open.Percentile(100) == open.max);
+			UNIT_TEST(after.ToJson().find("\"instance_hit\":{\"count\":") != DynLoader::dyn_string::npos);
+			fprintf(stderr, "%s", after.ToText().c_str());
+
+			dynLoader->SetStatsEnabled(false);
+			dynLoader->GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2]));
+			dynLoader->Reset();
+			dynLoader->SetStatsEnabled(true);
+			UNIT_TEST(dynLoader->GetStats()[DynLoader::DynMetric::Open].count == after[DynLoader::DynMetric::Open].count);
+		}
+
+		// Listeners see the lifecycle of libraries and instances
+		{
+			const DynLoader::dyn_string libName(argv[1]);
+			std::mutex eventMutex;
+			std::vector<DynLoader::DynEventType> types;
+			std::vector<std::string> names;
+			bool consistent = true;
+
+			dynLoader->FlushReclaim();
+			const size_t listener = dynLoader->AddListener([&](const DynLoader::DynEvent& event)
+			{
+				std::lock_guard<std::mutex> lock(eventMutex);
+				types.push_back(event.type);
+				names.push_back(event.name != nullptr ? event.name : "");
+				if(libName != event.library || event.duration.count() < 0 || event.failed || event.object == nullptr)
+					consistent = false;
+			});
+
+			dynLoader->GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2]));
+			dynLoader->GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2]));
+			dynLoader->Reset();
+			dynLoader->FlushReclaim();
+
+			{
+				std::lock_guard<std::mutex> lock(eventMutex);
+				UNIT_TEST(consistent);
+				UNIT_TEST(types.size() >= 5 && types.front() == DynLoader::DynEventType::Open);
+				UNIT_TEST(types.back() == DynLoader::DynEventType::Close);
+				UNIT_TEST(std::count(types.begin(), types.end(), DynLoader::DynEventType::Resolve) >= 1);
+
+				auto created = std::find(types.begin(), types.end(), DynLoader::DynEventType::Create);
+				UNIT_TEST(created != types.end() && names[created - types.begin()] == argv[2]);
+				UNIT_TEST(std::count(types.begin(), types.end(), DynLoader::DynEventType::Create) == 1);
+
+				auto destroyed = std::find(types.begin(), types.end(), DynLoader::DynEventType::Destroy);
+				UNIT_TEST(destroyed != types.end() && names[destroyed - types.begin()] == argv[2]);
+			}
+
+			UNIT_TEST(dynLoader->RemoveListener(listener));
+			UNIT_TEST(!dynLoader->RemoveListener(listener));
+
+			const size_t seen = types.size();
+			dynLoader->GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2]));
+			dynLoader->Reset();
+			dynLoader->FlushReclaim();
+			UNIT_TEST(types.size() == seen);
+		}
+
+#if PLATFORM_POSIX
+		// The loader's state is published to shared memory for other processes
+		{
+			const DynLoader::dyn_string libName(argv[1]);
+			const DynLoader::dyn_string segmentName = dynLoader->PublishStats("", std::chrono::milliseconds(5));
+			dynLoader->GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2]));
+
+			DynLoader::DynStatsSegment segment(segmentName, DynLoader::DynSegmentAccess::Read);
+			std::unique_ptr<DynLoader::DynSegmentData> data(new DynLoader::DynSegmentData());
+			bool published = false;
+			for(int n = 0; n < 500 && !published; ++n)
+			{
+				published = segment.Read(*data) && data->libraryCount == 1 && data->libraries[0].instances == 1;
+				if(!published)
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+			UNIT_TEST(published);
+			UNIT_TEST(libName == data->libraries[0].name && data->libraries[0].textBytes > 0);
+			UNIT_TEST(data->metrics[static_cast<size_t>(DynLoader::DynMetric::Open)].count > 0);
+			UNIT_TEST(data->pid != 0 && data->updates > 0);
+
+			dynLoader->StopPublishingStats();
+			try
+			{
+				DynLoader::DynStatsSegment removed(segmentName, DynLoader::DynSegmentAccess::Read);
+				UNIT_TEST(false);
+			}
+			catch(DynLoader::LoaderException& ex)
+			{
+				fprintf(stderr, "OK: LoaderException caught: %s\n", ex.what());
+				UNIT_TEST(true);
+			}
+
+			dynLoader->Reset();
+		}
+
+		// Code records let perf map readers name functions of closed libraries
+		{
+			const DynLoader::dyn_string libName(argv[1]);
+			const DynLoader::dyn_string mapName = dynLoader->EnablePerfMap(".");
+			dynLoader->GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2]));
+			const std::string factory = "Create" + std::string(argv[2]);
+			const uintptr_t address = reinterpret_cast<uintptr_t>(
+					::dlsym(dynLoader->GetLoadedLibrary(libName)->handle, factory.c_str()));
+			UNIT_TEST(address != 0);
+			dynLoader->Reset();
+			dynLoader->FlushReclaim();
+			dynLoader->DisablePerfMap();
+
+			// Resolved like the readers do: hex start and size, then the name
+			std::ifstream map(mapName.c_str());
+			std::string line;
+			bool named = false;
+			while(std::getline(map, line))
+			{
+				char* end = nullptr;
+				const uintptr_t start = static_cast<uintptr_t>(std::strtoull(line.c_str(), &end, 16));
+				const uintptr_t size = static_cast<uintptr_t>(std::strtoull(end, &end, 16));
+				if(address >= start && address < start + size)
+					named = named || std::string(end).compare(0, factory.size() + 3, " " + factory + " [") == 0;
+			}
+			UNIT_TEST(named);
+
+			// ./perf-<pid>.map
+			const DynLoader::dyn_string pid = mapName.substr(7, mapName.size() - 11);
+			const DynLoader::dyn_string logName = "./dynloader-" + pid + ".log";
+			std::ifstream log(logName.c_str());
+			size_t loads = 0, unloads = 0;
+			while(std::getline(log, line))
+			{
+				if(line.find(" load ") != std::string::npos && line.find(libName) != std::string::npos)
+					++loads;
+				else if(line.find(" unload ") != std::string::npos && line.find(libName) != std::string::npos)
+					++unloads;
+			}
+			UNIT_TEST(loads > 0 && loads == unloads);
+
+			UNIT_TEST(std::remove(mapName.c_str()) == 0 && std::remove(logName.c_str()) == 0);
+		}
+#endif
+
+#if defined(__GLIBC__)
+		// Every namespace gets its own copy of the module
+		{
+			const DynLoader::dyn_string libName(argv[1]);
+			const DynLoader::DynNamespace tenant1 = dynLoader->CreateNamespace();
+			const DynLoader::DynNamespace tenant2 = dynLoader->CreateNamespace();
+			UNIT_TEST(tenant1 != 0 && tenant2 != tenant1);
+
+			auto base = dynLoader->GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2]));
+			auto copy1 = dynLoader->GetClassInstance<DynLoader::ITest>(tenant1, libName, DynLoader::dyn_string(argv[2]));
+			auto copy2 = dynLoader->GetClassInstance<DynLoader::ITest>(tenant2, libName, DynLoader::dyn_string(argv[2]));
+			UNIT_TEST(copy1 != nullptr && copy2 != nullptr && copy1 != base && copy2 != copy1);
+			UNIT_TEST(dynLoader->GetClassInstance<DynLoader::ITest>(tenant1, libName, DynLoader::dyn_string(argv[2])) == copy1);
+			UNIT_TEST(dynLoader->GetClassInstance<DynLoader::ITest>(0, libName, DynLoader::dyn_string(argv[2])) == base);
+			copy1->DoSomething();
+			copy2->DoSomething();
+
+			DynLoader::DynLib* lib1 = dynLoader->GetLoadedLibrary(tenant1, libName);
+			UNIT_TEST(lib1 != nullptr && lib1 != dynLoader->GetLoadedLibrary(libName) && lib1->space == tenant1);
+			UNIT_TEST(lib1->name == libName);
+			UNIT_TEST(dynLoader->GetLoadedLibrary(tenant1, "./" + libName) == lib1);
+
+			size_t copies = 0;
+			for(const auto& usage : dynLoader->GetLibraryUsage())
+			{
+				if(usage.name == libName && usage.space != 0)
+					++copies;
+			}
+			UNIT_TEST(copies == 2);
+
+			UNIT_TEST(dynLoader->UnloadLib(tenant2, libName));
+			UNIT_TEST(dynLoader->GetLoadedLibrary(tenant2, libName) == nullptr);
+			UNIT_TEST(dynLoader->GetLoadedLibrary(libName) != nullptr);
+
+			bool unknown = false;
+			try
+			{
+				dynLoader->GetClassInstance<DynLoader::ITest>(1000, libName, DynLoader::dyn_string(argv[2]));
+			}
+			catch(DynLoader::LoaderException&)
+			{
+				unknown = true;
+			}
+			UNIT_TEST(unknown);
+
+			dynLoader->Reset();
+		}
+#endif
+
+		// Profiled classes are prepared again by a warm start
+		{
+			const DynLoader::dyn_string libName(argv[1]);
+			dynLoader->SetProfiling(true);
+			dynLoader->GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2]));
+			UNIT_TEST(dynLoader->GetFactory<DynLoader::ITest>(libName, "Parallel1"));
+			UNIT_TEST(dynLoader->GetFactory<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[2])));
+			dynLoader->SetProfiling(false);
+			dynLoader->GetClassInstance<DynLoader::ITest>(libName, "Test2");
+			UNIT_TEST(dynLoader->SaveProfile("TestDynLoader.profile") == 2);
+			dynLoader->Reset();
+
+			DynLoader::PreloadResult warm = dynLoader->WarmStart("TestDynLoader.profile");
+			UNIT_TEST(warm.loaded == 1 && warm.failed == 0 && warm.libraries.size() == 1);
+			UNIT_TEST(warm.libraries[0].name == libName && warm.libraries[0].classes == 2);
+			UNIT_TEST(warm.libraries[0].warmedUp);
+
+			std::vector<DynLoader::LibraryUsage> usage = dynLoader->GetLibraryUsage();
+			UNIT_TEST(usage.size() == 1 && usage[0].instances == 1 && usage[0].pinned);
+
+			// Warmed libraries survive eviction
+			dynLoader->SetMemoryBudget(1);
+			UNIT_TEST(dynLoader->EvictIdle() == 0);
+			dynLoader->SetMemoryBudget(0);
+
+			UNIT_TEST(dynLoader->WarmStart("SomeDefinitelyNotExistentFile").libraries.empty());
+			std::remove("TestDynLoader.profile");
+
+			dynLoader->Reset();
+		}
+
 		dynLoader->Destroy();
 		UNIT_TEST(true);
 	}
@@ -0,0 +1,230 @@
+/**
+ * Copyright (c) 2007-2008, Igor Semenov
+ * Copyright (c) 2010-2012, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors 
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <cstdio>
+
+#include <platform.h>
+
+#include "UnitTest.hpp"
+
+#include <DynLoader.hpp>
+#include <LoaderException.hpp>
+
+#include "TestInterface.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+static const int ThreadCount = 8;
+static const int Iterations = 2000;
+
+int main(int argc, char** argv)
+{
+	if(argc < 3)
+	{
+		fprintf(stderr, "Usage %s <libName> <className1> [<className2>...]\n", argv[0]);
+		return 1;
+	}
+
+	const DynLoader::dyn_string libName(argv[1]);
+
+	try
+	{
+		DynLoader::DynLoader dynLoader;
+		std::atomic<int> failures(0);
+		std::vector<DynLoader::ITest*> seen(ThreadCount * argc, nullptr);
+
+		// Every thread must observe the same singleton per class
+		std::vector<std::thread> threads;
+		for(int t = 0; t < ThreadCount; ++t)
+		{
+			threads.push_back(std::thread([&, t]()
+			{
+				try
+				{
+					for(int n = 0; n < Iterations; ++n)
+					{
+						for(int i = 2; i < argc; ++i)
+						{
+							auto instance = dynLoader.GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[i]));
+							if(instance == nullptr || (seen[t * argc + i] && seen[t * argc + i] != instance))
+								++failures;
+							seen[t * argc + i] = instance;
+						}
+					}
+				}
+				catch(...)
+				{
+					++failures;
+				}
+			}));
+		}
+
+		for(auto& thread : threads)
+			thread.join();
+		threads.clear();
+
+		UNIT_TEST(failures == 0);
+
+		for(int i = 2; i < argc; ++i)
+		{
+			for(int t = 1; t < ThreadCount; ++t)
+				UNIT_TEST(seen[t * argc + i] == seen[i]);
+		}
+
+		// Lookups racing with resets must neither crash nor fail
+		std::atomic<bool> done(false);
+		for(int t = 0; t < ThreadCount; ++t)
+		{
+			threads.push_back(std::thread([&]()
+			{
+				try
+				{
+					while(!done)
+					{
+						for(int i = 2; i < argc; ++i)
+						{
+							if(dynLoader.GetClassInstance<DynLoader::ITest>(libName, DynLoader::dyn_string(argv[i])) == nullptr)
+								++failures;
+						}
+					}
+				}
+				catch(...)
+				{
+					++failures;
+				}
+			}));
+		}
+
+		for(int n = 0; n < 50; ++n)
+		{
+			dynLoader.Reset();
+			std::this_thread::yield();
+		}
+
+		done = true;
+		for(auto& thread : threads)
+			thread.join();
+		threads.clear();
+
+		UNIT_TEST(failures == 0);
+
+		dynLoader.Reset();
+		UNIT_TEST(dynLoader.GetLoadedLibrary(libName) == nullptr);
+
+		// Constructors of different classes run in parallel: each Parallel
+		// constructor waits for the other one, serialized construction
+		// would take several seconds.
+		auto start = std::chrono::steady_clock::now();
+		std::atomic<DynLoader::ITest*> parallel[2];
+		parallel[0] = nullptr;
+		parallel[1] = nullptr;
+		for(int t = 0; t < 4; ++t)
+		{
+			threads.push_back(std::thread([&, t]()
+			{
+				try
+				{
+					auto className = (t % 2) ? "Parallel2" : "Parallel1";
+					auto instance = dynLoader.GetClassInstance<DynLoader::ITest>(libName, className);
+					DynLoader::ITest* expected = nullptr;
+					if(!parallel[t % 2].compare_exchange_strong(expected, instance) && expected != instance)
+						++failures;
+				}
+				catch(...)
+				{
+					++failures;
+				}
+			}));
+		}
+
+		for(auto& thread : threads)
+			thread.join();
+		threads.clear();
+
+		UNIT_TEST(failures == 0);
+		UNIT_TEST(parallel[0] != nullptr && parallel[1] != nullptr);
+		UNIT_TEST(std::chrono::steady_clock::now() - start < std::chrono::seconds(4));
+
+		dynLoader.Reset();
+
+		// Concurrent asynchronous requests share one load
+		std::vector<std::future<DynLoader::ITest*> > futures;
+		for(int t = 0; t < ThreadCount; ++t)
+			futures.push_back(dynLoader.GetClassInstanceAsync<DynLoader::ITest>(libName, argv[2]));
+
+		DynLoader::ITest* asyncInstance = futures[0].get();
+		UNIT_TEST(asyncInstance != nullptr);
+		for(int t = 1; t < ThreadCount; ++t)
+			UNIT_TEST(futures[t].get() == asyncInstance);
+		UNIT_TEST(dynLoader.GetClassInstance<DynLoader::ITest>(libName, argv[2]) == asyncInstance);
+
+		// Completions go through the given executor
+		std::atomic<int> executed(0);
+		std::promise<DynLoader::ITest*> completed;
+		dynLoader.GetClassInstanceAsync<DynLoader::ITest>(libName, argv[2],
+				[&completed](DynLoader::ITest* instance, std::exception_ptr)
+				{
+					completed.set_value(instance);
+				},
+				[&executed](std::function<void()> task)
+				{
+					++executed;
+					task();
+				});
+		UNIT_TEST(completed.get_future().get() == asyncInstance);
+		UNIT_TEST(executed == 1);
+
+		// Errors are delivered through the future
+		try
+		{
+			dynLoader.GetClassInstanceAsync<DynLoader::ITest>("SomeDefinitelyNotExistentFile", argv[2]).get();
+			UNIT_TEST(false);
+		}
+		catch(DynLoader::LoaderException& ex)
+		{
+			fprintf(stderr, "OK: LoaderException caught: %s\n", ex.what());
+			UNIT_TEST(true);
+		}
+	}
+	catch(DynLoader::LoaderException& ex)
+	{
+		fprintf(stderr, "Loader exception: %s\n", ex.what());
+		UNIT_TEST(false);
+	}
+	catch(...)
+	{
+		UNIT_TEST(false);
+	}
+
+	return 0;
+}
@@ -0,0 +1,318 @@
+/**
+ * Copyright (c) 2007-2008, Igor Semenov
+ * Copyright (c) 2010-2012, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors 
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstdio>
+
+#include <platform.h>
+
+#include "UnitTest.hpp"
+
+#include <DynLoader.hpp>
+#include <LoaderException.hpp>
+
+#include "TestInterface.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const int WorkerCount = 4;
+
+/**
+ * @brief Memory a worker reports to the parent
+ */
+struct WorkerMemory
+{
+	WorkerMemory() :
+			sharedModule(0), privateModule(0), sharedTotal(0), privateTotal(0), sameInstance(0), forked(0)
+	{
+	}
+
+	long sharedModule;
+	long privateModule;
+	long sharedTotal;
+	long privateTotal;
+	int sameInstance;
+	int forked;
+};
+
+/**
+ * @brief Add up the shared and private pages of the mappings of a file
+ * @param inode - [in] inode of the mapped file, 0 for every mapping
+ * @param shared - [out] shared kilobytes
+ * @param priv - [out] private kilobytes
+ */
+static void ReadSmaps(ino_t inode, long& shared, long& priv)
+{
+	std::ifstream smaps("/proc/self/smaps");
+	bool counted = false;
+	std::string line;
+	while(std::getline(smaps, line))
+	{
+		std::istringstream fields(line);
+		std::string key;
+		fields >> key;
+
+		if(key.empty() || key[key.size() - 1] != ':')
+		{
+			// Mapping header: address perms offset dev inode path
+			std::string perms, offset, dev;
+			unsigned long mappedInode = 0;
+			fields >> perms >> offset >> dev >> mappedInode;
+			counted = (inode == 0 || mappedInode == inode);
+			continue;
+		}
+
+		long kb = 0;
+		fields >> kb;
+		if(!counted)
+			continue;
+
+		if(key == "Shared_Clean:" || key == "Shared_Dirty:")
+			shared += kb;
+		else if(key == "Private_Clean:" || key == "Private_Dirty:")
+			priv += kb;
+	}
+}
+
+/**
+ * @brief Measure workers forked from a process that did not prepare the fork
+ * @param libName - [in] library file name
+ * @param argc - [in] argument count
+ * @param argv - [in] arguments, class names from the third one on
+ * @param inode - [in] inode of the library file
+ * @return private module kilobytes of all workers, -1 on failure
+ *
+ * Runs in its own process, so the library is opened and bound from
+ * scratch and none of its pages are shared with the prepared workers.
+ */
+static long MeasureUnprepared(const DynLoader::dyn_string& libName, int argc, char** argv, ino_t inode)
+{
+	int total[2];
+	if(pipe(total) != 0)
+		return -1;
+
+	const pid_t server = fork();
+	if(server == 0)
+	{
+		close(total[0]);
+
+		DynLoader::DynLoader dynLoader;
+		DynLoader::DynLoadOptions options;
+		options.scope = DynLoader::SymbolScope::Local;
+		options.binding = DynLoader::SymbolBinding::Lazy;
+		dynLoader.SetLoadOptions(libName, options);
+
+		for(int i = 2; i < argc; ++i)
+			dynLoader.GetClassInstance<DynLoader::ITest>(libName, argv[i]);
+
+		int results[2];
+		if(pipe(results) != 0)
+			_exit(1);
+
+		for(int w = 0; w < WorkerCount; ++w)
+		{
+			if(fork() != 0)
+				continue;
+
+			WorkerMemory memory;
+			for(int i = 2; i < argc; ++i)
+				dynLoader.GetClassInstance<DynLoader::ITest>(libName, argv[i])->DoSomething();
+
+			ReadSmaps(inode, memory.sharedModule, memory.privateModule);
+
+			const ssize_t written = write(results[1], &memory, sizeof(memory));
+			_exit(written == sizeof(memory) ? 0 : 1);
+		}
+
+		close(results[1]);
+
+		long privateModule = 0;
+		for(int w = 0; w < WorkerCount; ++w)
+		{
+			WorkerMemory memory;
+			if(read(results[0], &memory, sizeof(memory)) != sizeof(memory))
+				_exit(1);
+			privateModule += memory.privateModule;
+		}
+
+		for(int w = 0; w < WorkerCount; ++w)
+			wait(nullptr);
+
+		const ssize_t written = write(total[1], &privateModule, sizeof(privateModule));
+		_exit(written == sizeof(privateModule) ? 0 : 1);
+	}
+
+	close(total[1]);
+
+	long privateModule = -1;
+	if(server < 0 || read(total[0], &privateModule, sizeof(privateModule)) != sizeof(privateModule))
+		privateModule = -1;
+	close(total[0]);
+
+	if(server > 0)
+		waitpid(server, nullptr, 0);
+
+	return privateModule;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 3)
+	{
+		fprintf(stderr, "Usage %s <libName> <className1> [<className2>...]\n", argv[0]);
+		return 1;
+	}
+
+	const DynLoader::dyn_string libName(argv[1]);
+
+	struct stat module;
+	UNIT_TEST(stat(argv[1], &module) == 0);
+
+	// Measured before this process maps the library
+	const long unpreparedPrivate = MeasureUnprepared(libName, argc, argv, module.st_ino);
+	UNIT_TEST(unpreparedPrivate >= 0);
+
+	try
+	{
+		DynLoader::DynLoader dynLoader;
+
+		// Lazy slots are bound by PrepareFork() rather than in every worker
+		DynLoader::DynLoadOptions options;
+		options.scope = DynLoader::SymbolScope::Local;
+		options.binding = DynLoader::SymbolBinding::Lazy;
+		dynLoader.SetLoadOptions(libName, options);
+
+		// Singletons are created once, before forking
+		std::vector<DynLoader::ITest*> instances;
+		for(int i = 2; i < argc; ++i)
+		{
+			instances.push_back(dynLoader.GetClassInstance<DynLoader::ITest>(libName, argv[i]));
+			UNIT_TEST(instances.back() != nullptr);
+		}
+
+		DynLoader::ForkPreparation prepared = dynLoader.PrepareFork();
+		fprintf(stderr, "Prepared %zu libraries, bound %zu symbols, touched %zu bytes\n",
+				prepared.libraries, prepared.boundSymbols, prepared.touchedBytes);
+		UNIT_TEST(prepared.libraries == 1);
+		UNIT_TEST(prepared.boundSymbols > 0);
+		UNIT_TEST(prepared.touchedBytes > 0);
+
+		std::atomic<int> parentPhases(0);
+		int childPhases = 0;
+		dynLoader.AddForkHandler([&](DynLoader::DynForkPhase phase)
+		{
+			if(phase == DynLoader::DynForkPhase::Parent)
+				++parentPhases;
+			else if(phase == DynLoader::DynForkPhase::Child)
+				++childPhases;
+		});
+
+		int results[2];
+		UNIT_TEST(pipe(results) == 0);
+
+		for(int w = 0; w < WorkerCount; ++w)
+		{
+			if(dynLoader.ForkWorker() != 0)
+				continue;
+
+			// Worker: the parent's singletons serve requests without loading
+			WorkerMemory memory;
+			memory.forked = childPhases;
+			memory.sameInstance = dynLoader.GetLoadedLibrary(libName) != nullptr;
+			for(int i = 2; i < argc; ++i)
+			{
+				DynLoader::ITest* instance = dynLoader.GetClassInstance<DynLoader::ITest>(libName, argv[i]);
+				instance->DoSomething();
+				if(instance != instances[i - 2])
+					memory.sameInstance = 0;
+			}
+
+			ReadSmaps(module.st_ino, memory.sharedModule, memory.privateModule);
+			ReadSmaps(0, memory.sharedTotal, memory.privateTotal);
+
+			const ssize_t written = write(results[1], &memory, sizeof(memory));
+			_exit(written == sizeof(memory) ? 0 : 1);
+		}
+
+		close(results[1]);
+
+		long preparedPrivate = 0;
+		fprintf(stderr, "%-8s %14s %15s %14s %15s\n", "worker", "module shared", "module private", "total shared", "total private");
+		for(int w = 0; w < WorkerCount; ++w)
+		{
+			WorkerMemory memory;
+			UNIT_TEST(read(results[0], &memory, sizeof(memory)) == sizeof(memory));
+			fprintf(stderr, "%-8d %11ld kB %12ld kB %11ld kB %12ld kB\n", w,
+					memory.sharedModule, memory.privateModule, memory.sharedTotal, memory.privateTotal);
+
+			UNIT_TEST(memory.forked == 1);
+			UNIT_TEST(memory.sameInstance == 1);
+			preparedPrivate += memory.privateModule;
+		}
+
+		close(results[0]);
+
+		// Slots bound before the fork stay shared instead of being
+		// written by every worker
+		fprintf(stderr, "Private module memory of %d workers: %ld kB prepared, %ld kB unprepared\n",
+				WorkerCount, preparedPrivate, unpreparedPrivate);
+		UNIT_TEST(preparedPrivate <= unpreparedPrivate);
+
+		for(int w = 0; w < WorkerCount; ++w)
+		{
+			int status = 0;
+			UNIT_TEST(wait(&status) > 0);
+			UNIT_TEST(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+		}
+
+		UNIT_TEST(parentPhases == WorkerCount);
+		UNIT_TEST(childPhases == 0);
+
+		// The loader keeps working in the parent
+		dynLoader.Reset();
+		UNIT_TEST(dynLoader.GetClassInstance<DynLoader::ITest>(libName, argv[2]) != nullptr);
+	}
+	catch(DynLoader::LoaderException& ex)
+	{
+		fprintf(stderr, "Loader exception: %s\n", ex.what());
+		UNIT_TEST(false);
+	}
+	catch(...)
+	{
+		UNIT_TEST(false);
+	}
+
+	return 0;
+}
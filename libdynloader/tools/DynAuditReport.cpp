@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <platform.h>
+
+#include <DynAudit.hpp>
+
+#include "ToolFormat.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+/* @brief Columns of an open line before the file name */
+const size_t OpenColumns = 16;
+
+/**
+ * @brief Loads of one library file
+ */
+struct LibrarySummary
+{
+	std::string file;
+	uint64_t loads;
+	uint64_t failed;
+	uint64_t total;
+	uint64_t maxTotal;
+	uint64_t wait;
+	uint64_t search;
+	uint64_t map;
+	uint64_t reloc;
+	uint64_t init;
+	uint64_t objects;
+	uint64_t relocs;
+	uint64_t relative;
+	uint64_t plt;
+	uint64_t bound;
+	uint64_t lazy;
+	/* @brief PLT slots bound after loading, from the close lines */
+	uint64_t closes;
+	uint64_t lazyLater;
+
+	LibrarySummary() : file(), loads(0), failed(0), total(0), maxTotal(0), wait(0), search(0), map(0),
+			reloc(0), init(0), objects(0), relocs(0), relative(0), plt(0), bound(0), lazy(0), closes(0),
+			lazyLater(0)
+	{
+	}
+};
+
+/**
+ * @brief Split a line at its tabs, the last field keeps the rest
+ * @param line - [in] line without its newline, modified
+ * @param fields - [out] fields
+ * @param count - [in] number of fields
+ * @return false if the line has fewer fields
+ */
+bool SplitLine(char* line, char** fields, size_t count)
+{
+	for(size_t i = 0; i < count; ++i)
+	{
+		fields[i] = line;
+		if(i + 1 == count)
+			return true;
+
+		char* tab = strchr(line, '\t');
+		if(tab == nullptr)
+			return false;
+
+		*tab = '\0';
+		line = tab + 1;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Add the lines of an audit file to the summaries
+ * @param fileName - [in] file written by libdynloader-audit
+ * @param libraries - [in] summaries by library file
+ * @return false if the file could not be read
+ */
+bool ReadAuditFile(const char* fileName, std::map<std::string, LibrarySummary>& libraries)
+{
+	FILE* file = fopen(fileName, "r");
+	if(file == nullptr)
+		return false;
+
+	char line[4096];
+	char* fields[OpenColumns + 1];
+	while(fgets(line, sizeof(line), file) != nullptr)
+	{
+		line[strcspn(line, "\n")] = '\0';
+
+		if(strncmp(line, "open\t", 5) == 0 && SplitLine(line, fields, OpenColumns + 1))
+		{
+			uint64_t values[OpenColumns];
+			for(size_t i = 2; i < OpenColumns; ++i)
+				values[i] = strtoull(fields[i], nullptr, 10);
+
+			LibrarySummary& library = libraries[fields[OpenColumns]];
+			library.file = fields[OpenColumns];
+			++library.loads;
+			library.failed += values[2] == 0 ? 1 : 0;
+			library.total += values[4];
+			library.maxTotal = std::max(library.maxTotal, values[4]);
+			library.wait += values[5];
+			library.search += values[6];
+			library.map += values[7];
+			library.reloc += values[8];
+			library.init += values[9];
+			library.objects += values[10];
+			library.relocs += values[11];
+			library.relative += values[12];
+			library.plt += values[13];
+			library.bound += values[14];
+			library.lazy += values[15];
+		}
+		else if(strncmp(line, "close\t", 6) == 0 && SplitLine(line, fields, 4))
+		{
+			// Dependencies mapped by a load have no summary of their own
+			auto it = libraries.find(fields[3]);
+			if(it != libraries.end())
+			{
+				++it->second.closes;
+				it->second.lazyLater += strtoull(fields[2], nullptr, 10);
+			}
+		}
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+/**
+ * @brief Print the summaries, the most expensive libraries first
+ * @param libraries - [in] summaries by library file
+ */
+void PrintReport(const std::map<std::string, LibrarySummary>& libraries)
+{
+	std::vector<const LibrarySummary*> sorted;
+	for(auto& library : libraries)
+		sorted.push_back(&library.second);
+	std::sort(sorted.begin(), sorted.end(),
+			[](const LibrarySummary* x, const LibrarySummary* y) { return x->total > y->total; });
+
+	printf("%-32s %5s %9s %9s %9s %9s %9s %9s %9s %5s %7s %7s %6s %6s %6s\n", "library", "loads",
+			"total", "max", "wait", "search", "map", "reloc", "init", "objs", "relocs", "symbol",
+			"plt", "bound", "lazy");
+
+	char a[32], b[32], c[32], d[32], e[32], f[32], g[32];
+	for(auto library : sorted)
+	{
+		const uint64_t n = library->loads;
+		const char* name = library->file.c_str();
+		const size_t length = library->file.size();
+
+		// Means per load, the tail of long paths identifies the library
+		printf("%-32s %5llu %9s %9s %9s %9s %9s %9s %9s %5llu %7llu %7llu %6llu %6llu %6llu\n",
+				length > 32 ? name + length - 32 : name, static_cast<unsigned long long>(n),
+				FormatTime(library->total / n, a, sizeof(a)), FormatTime(library->maxTotal, b, sizeof(b)),
+				FormatTime(library->wait / n, c, sizeof(c)), FormatTime(library->search / n, d, sizeof(d)),
+				FormatTime(library->map / n, e, sizeof(e)), FormatTime(library->reloc / n, f, sizeof(f)),
+				FormatTime(library->init / n, g, sizeof(g)), static_cast<unsigned long long>(library->objects / n),
+				static_cast<unsigned long long>(library->relocs / n),
+				static_cast<unsigned long long>((library->relocs - library->relative) / n),
+				static_cast<unsigned long long>(library->plt / n), static_cast<unsigned long long>(library->bound / n),
+				static_cast<unsigned long long>((library->lazy + library->lazyLater) / n));
+
+		if(library->failed != 0)
+			printf("%-32s %5llu failed\n", "", static_cast<unsigned long long>(library->failed));
+	}
+}
+
+} // anonymous namespace
+
+/**
+ * @brief Summarize the library loads recorded by libdynloader-audit
+ */
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage %s <auditFile>...\n", argv[0]);
+		fprintf(stderr, "Record one with LD_AUDIT=libdynloader-audit.so %s=<auditFile>\n",
+				DYN_AUDIT_FILE_VARIABLE);
+		return 1;
+	}
+
+	std::map<std::string, LibrarySummary> libraries;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!ReadAuditFile(argv[i], libraries))
+		{
+			fprintf(stderr, "%s: %s\n", argv[i], strerror(errno));
+			return 1;
+		}
+	}
+
+	if(libraries.empty())
+	{
+		fprintf(stderr, "No library loads recorded\n");
+		return 1;
+	}
+
+	PrintReport(libraries);
+
+	return 0;
+}
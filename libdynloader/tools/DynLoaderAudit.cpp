@@ -0,0 +1,476 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <platform.h>
+
+#include <DynAudit.hpp>
+
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <link.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @file DynLoaderAudit.cpp
+ * @brief rtld-audit module timing the library loads of DynLoader
+ *
+ * The system loader calls the la_ functions of modules named in LD_AUDIT,
+ * see rtld-audit(7). The module runs in its own link-map namespace with
+ * its own copy of libc, so it only uses plain C interfaces and static
+ * storage. The file format is described in DynAudit.hpp.
+ */
+
+namespace
+{
+
+/* @brief Objects tracked at the same time, further ones are not counted */
+const size_t MaxObjects = 4096;
+/* @brief Length of a recorded file name, including the terminator */
+const size_t NameLength = 512;
+
+/**
+ * @brief Object mapped by the system loader
+ */
+struct AuditObject
+{
+	/* @brief Load that mapped the object, 0 if it was mapped outside of a DynLib */
+	uint64_t load;
+	const struct link_map* map;
+	/* @brief PLT slots bound on their first call */
+	std::atomic<uint64_t> lazy;
+	AuditObject* nextFree;
+};
+
+/**
+ * @brief Load of a DynLib in progress on a thread
+ */
+struct AuditLoad
+{
+	/* @brief Nested loads are part of the outer one */
+	unsigned depth;
+	/* @brief Id of the load, 0 while none is in progress */
+	uint64_t serial;
+	char file[NameLength];
+	uint64_t start;
+	uint64_t firstEvent;
+	uint64_t searchStart;
+	uint64_t lastCandidate;
+	uint64_t search;
+	uint64_t consistent;
+	uint64_t lastBinding;
+	uint64_t objects;
+	uint64_t relocs;
+	uint64_t relative;
+	uint64_t plt;
+	uint64_t bound;
+	uint64_t lazy;
+};
+
+/* @brief Object records, allocated and released under the lock of the system loader */
+AuditObject objects[MaxObjects];
+size_t usedObjects = 0;
+AuditObject* freeObjects = nullptr;
+
+std::atomic<uint64_t> loadSerial(0);
+thread_local AuditLoad load;
+
+pthread_once_t outputOnce = PTHREAD_ONCE_INIT;
+int output = -1;
+
+/**
+ * @brief Get the CLOCK_MONOTONIC time in nanoseconds
+ */
+uint64_t Now()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return uint64_t(now.tv_sec) * 1000000000ull + uint64_t(now.tv_nsec);
+}
+
+/**
+ * @brief Open the output file, called once
+ */
+void OpenOutput()
+{
+	char defaultName[64];
+	const char* fileName = getenv(DYN_AUDIT_FILE_VARIABLE);
+	if(fileName == nullptr || *fileName == '\0')
+	{
+		snprintf(defaultName, sizeof(defaultName), "/tmp/dynloader-audit-%ld.log", static_cast<long>(getpid()));
+		fileName = defaultName;
+	}
+
+	output = open(fileName, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if(output < 0)
+		fprintf(stderr, "dynloader-audit: unable to open %s: %s\n", fileName, strerror(errno));
+}
+
+/**
+ * @brief Append a line to the output file
+ * @param line - [in] complete line
+ * @param length - [in] length returned by snprintf()
+ * @param size - [in] size of the buffer the line was formatted into
+ */
+void WriteLine(const char* line, int length, size_t size)
+{
+	pthread_once(&outputOnce, OpenOutput);
+
+	if(output < 0 || length <= 0)
+		return;
+
+	// A truncated line keeps its terminator
+	if(static_cast<size_t>(length) >= size)
+		length = static_cast<int>(size - 1);
+
+	// Lines of concurrent loads must not interleave, so they are written at once
+	if(write(output, line, static_cast<size_t>(length)) < 0)
+		return;
+}
+
+/**
+ * @brief Get a free object record
+ * @return object record, nullptr if all are in use
+ */
+AuditObject* AllocateObject()
+{
+	AuditObject* object = freeObjects;
+	if(object != nullptr)
+		freeObjects = object->nextFree;
+	else if(usedObjects < MaxObjects)
+		object = &objects[usedObjects++];
+
+	return object;
+}
+
+/**
+ * @brief Return an object record
+ * @param object - [in] record of an unmapped object
+ */
+void ReleaseObject(AuditObject* object)
+{
+	object->map = nullptr;
+	object->nextFree = freeObjects;
+	freeObjects = object;
+}
+
+/**
+ * @brief Add the time of the current file search to the load
+ * @param current - [in] load in progress
+ */
+void EndSearch(AuditLoad& current)
+{
+	if(current.searchStart != 0)
+		current.search += current.lastCandidate - current.searchStart;
+	current.searchStart = 0;
+}
+
+/**
+ * @brief Add the relocations of a mapped object to the load
+ * @param map - [in] mapped object
+ * @param current - [in] load in progress
+ *
+ * Packed DT_RELR relocations are not counted.
+ */
+void CountRelocations(const struct link_map* map, AuditLoad& current)
+{
+	uint64_t relSize = 0, relEntry = sizeof(ElfW(Rel)), relaSize = 0, relaEntry = sizeof(ElfW(Rela));
+	uint64_t relative = 0, pltSize = 0, pltType = DT_RELA;
+	uintptr_t rel = 0, rela = 0, jmprel = 0;
+
+	for(const ElfW(Dyn)* dyn = map->l_ld; dyn != nullptr && dyn->d_tag != DT_NULL; ++dyn)
+	{
+		switch(dyn->d_tag)
+		{
+		case DT_REL: rel = dyn->d_un.d_ptr; break;
+		case DT_RELSZ: relSize = dyn->d_un.d_val; break;
+		case DT_RELENT: relEntry = dyn->d_un.d_val; break;
+		case DT_RELCOUNT: relative += dyn->d_un.d_val; break;
+		case DT_RELA: rela = dyn->d_un.d_ptr; break;
+		case DT_RELASZ: relaSize = dyn->d_un.d_val; break;
+		case DT_RELAENT: relaEntry = dyn->d_un.d_val; break;
+		case DT_RELACOUNT: relative += dyn->d_un.d_val; break;
+		case DT_JMPREL: jmprel = dyn->d_un.d_ptr; break;
+		case DT_PLTRELSZ: pltSize = dyn->d_un.d_val; break;
+		case DT_PLTREL: pltType = dyn->d_un.d_val; break;
+		default: break;
+		}
+	}
+
+	if(relEntry == 0 || relaEntry == 0)
+		return;
+
+	const uint64_t plt = pltSize / (pltType == DT_REL ? relEntry : relaEntry);
+	uint64_t relocs = relSize / relEntry + relaSize / relaEntry;
+
+	// Some linkers place the PLT relocations inside the DT_RELA range
+	if(pltSize != 0 && ((jmprel >= rela && jmprel - rela < relaSize) || (jmprel >= rel && jmprel - rel < relSize)))
+		relocs -= relocs >= plt ? plt : relocs;
+
+	current.relocs += relocs + plt;
+	current.relative += relative;
+	current.plt += plt;
+}
+
+/**
+ * @brief Start timing a load, bound to DynAuditOpenStartV1()
+ * @param fileName - [in] file name passed to the system loader
+ */
+void OpenStart(const char* fileName)
+{
+	AuditLoad& current = load;
+	if(current.depth++ != 0)
+		return;
+
+	std::memset(&current, 0, sizeof(current));
+	current.depth = 1;
+	current.serial = ++loadSerial;
+	strncpy(current.file, fileName != nullptr ? fileName : "", NameLength - 1);
+	current.start = Now();
+}
+
+/**
+ * @brief Write the phases of a load, bound to DynAuditOpenDoneV1()
+ * @param fileName - [in] file name passed to the system loader
+ * @param handle - [in] system library handle, nullptr on failure
+ */
+void OpenDone(const char* fileName, void* handle)
+{
+	const uint64_t end = Now();
+	AuditLoad& current = load;
+	(void) fileName;
+
+	if(current.depth == 0 || --current.depth != 0)
+		return;
+
+	EndSearch(current);
+
+	const uint64_t first = current.firstEvent != 0 ? current.firstEvent : end;
+	const uint64_t mapped = current.consistent != 0 ? current.consistent : end;
+	const uint64_t relocated = current.lastBinding > mapped ? current.lastBinding : mapped;
+	const uint64_t search = current.search < mapped - first ? current.search : mapped - first;
+
+	char line[NameLength + 512];
+	const int length = snprintf(line, sizeof(line),
+			"open\t%ld\t%d\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64
+			"\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64 "\t%s\n",
+			static_cast<long>(getpid()), handle != nullptr ? 1 : 0, current.start, end - current.start,
+			first - current.start, search, mapped - first - search, relocated - mapped, end - relocated,
+			current.objects, current.relocs, current.relative, current.plt, current.bound, current.lazy,
+			current.file);
+	WriteLine(line, length, sizeof(line));
+
+	current.serial = 0;
+}
+
+/**
+ * @brief Count a symbol binding and redirect the hooks of libdynloader
+ * @param value - [in] address the symbol was bound to
+ * @param refcook - [in] cookie of the object the reference is in
+ * @param flags - [in] binding flags
+ * @param name - [in] symbol name
+ * @return address to bind the reference to
+ */
+uintptr_t Bind(uintptr_t value, uintptr_t* refcook, unsigned int* flags, const char* name)
+{
+	if(name[0] == 'D')
+	{
+		if(std::strcmp(name, DYN_AUDIT_OPEN_START_SYMBOL) == 0)
+			return reinterpret_cast<uintptr_t>(&OpenStart);
+		if(std::strcmp(name, DYN_AUDIT_OPEN_DONE_SYMBOL) == 0)
+			return reinterpret_cast<uintptr_t>(&OpenDone);
+	}
+
+	// Lookups through dlsym() are no PLT bindings
+	AuditObject* from = reinterpret_cast<AuditObject*>(*refcook);
+	if(from == nullptr || (*flags & LA_SYMB_DLSYM) != 0)
+		return value;
+
+	AuditLoad& current = load;
+	const bool loading = current.serial != 0 && from->load == current.serial;
+
+	// Slots bound while relocating cannot have PLT enter and exit hooks
+	if((*flags & LA_SYMB_NOPLTENTER) != 0)
+	{
+		if(loading)
+		{
+			++current.bound;
+			current.lastBinding = Now();
+		}
+	}
+	else
+	{
+		from->lazy.fetch_add(1, std::memory_order_relaxed);
+		if(loading)
+			++current.lazy;
+	}
+
+	return value;
+}
+
+} // anonymous namespace
+
+/**
+ * @brief Agree on the audit interface version, never newer than the loader's
+ */
+extern "C" API_EXPORT unsigned int la_version(unsigned int version)
+{
+	return version < LAV_CURRENT ? version : LAV_CURRENT;
+}
+
+/**
+ * @brief Called for every file name the system loader tries
+ */
+extern "C" API_EXPORT char* la_objsearch(const char* name, uintptr_t* cookie, unsigned int flag)
+{
+	(void) cookie;
+
+	AuditLoad& current = load;
+	if(current.serial != 0)
+	{
+		const uint64_t now = Now();
+		if(current.firstEvent == 0)
+			current.firstEvent = now;
+
+		if(flag == LA_SER_ORIG)
+		{
+			EndSearch(current);
+			current.searchStart = now;
+		}
+		current.lastCandidate = now;
+	}
+
+	return const_cast<char*>(name);
+}
+
+/**
+ * @brief Called when objects are added to or removed from a namespace
+ */
+extern "C" API_EXPORT void la_activity(uintptr_t* cookie, unsigned int flag)
+{
+	(void) cookie;
+
+	AuditLoad& current = load;
+	if(current.serial == 0)
+		return;
+
+	const uint64_t now = Now();
+	if(current.firstEvent == 0)
+		current.firstEvent = now;
+
+	// Relocation starts once all objects of the load are mapped
+	if(flag == LA_ACT_CONSISTENT && current.consistent == 0)
+	{
+		EndSearch(current);
+		current.consistent = now;
+	}
+}
+
+/**
+ * @brief Called when an object was mapped
+ */
+extern "C" API_EXPORT unsigned int la_objopen(struct link_map* map, Lmid_t lmid, uintptr_t* cookie)
+{
+	(void) lmid;
+
+	AuditLoad& current = load;
+
+	// The file lookup ended with the last name tried
+	if(current.serial != 0)
+		EndSearch(current);
+
+	AuditObject* object = AllocateObject();
+	*cookie = reinterpret_cast<uintptr_t>(object);
+	if(object != nullptr)
+	{
+		object->map = map;
+		object->lazy.store(0, std::memory_order_relaxed);
+		object->load = 0;
+
+		if(current.serial != 0)
+		{
+			object->load = current.serial;
+			++current.objects;
+			CountRelocations(map, current);
+		}
+	}
+
+	return LA_FLG_BINDTO | LA_FLG_BINDFROM;
+}
+
+/**
+ * @brief Called before an object is unmapped
+ */
+extern "C" API_EXPORT unsigned int la_objclose(uintptr_t* cookie)
+{
+	AuditObject* object = reinterpret_cast<AuditObject*>(*cookie);
+	if(object == nullptr)
+		return 0;
+
+	if(object->load != 0)
+	{
+		char line[NameLength + 64];
+		const int length = snprintf(line, sizeof(line), "close\t%ld\t%" PRIu64 "\t%s\n", static_cast<long>(getpid()),
+				object->lazy.load(std::memory_order_relaxed), object->map->l_name);
+		WriteLine(line, length, sizeof(line));
+	}
+
+	ReleaseObject(object);
+	*cookie = 0;
+
+	return 0;
+}
+
+/**
+ * @brief Called when a PLT slot of a 32 bit object is bound
+ */
+extern "C" API_EXPORT uintptr_t la_symbind32(Elf32_Sym* sym, unsigned int ndx, uintptr_t* refcook,
+		uintptr_t* defcook, unsigned int* flags, const char* name)
+{
+	(void) ndx;
+	(void) defcook;
+	return Bind(sym->st_value, refcook, flags, name);
+}
+
+/**
+ * @brief Called when a PLT slot of a 64 bit object is bound
+ */
+extern "C" API_EXPORT uintptr_t la_symbind64(Elf64_Sym* sym, unsigned int ndx, uintptr_t* refcook,
+		uintptr_t* defcook, unsigned int* flags, const char* name)
+{
+	(void) ndx;
+	(void) defcook;
+	return Bind(sym->st_value, refcook, flags, name);
+}
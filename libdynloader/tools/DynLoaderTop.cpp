@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <platform.h>
+
+#include <DynStatsSegment.hpp>
+#include <LoaderException.hpp>
+
+#include "ToolFormat.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <unistd.h>
+
+namespace
+{
+
+/**
+ * @brief Format a byte count with a binary unit
+ */
+const char* FormatBytes(uint64_t bytes, char* buffer, size_t size)
+{
+	static const char units[] = { 'B', 'K', 'M', 'G', 'T' };
+
+	double value = static_cast<double>(bytes);
+	size_t unit = 0;
+	while(value >= 1024.0 && unit + 1 < sizeof(units))
+	{
+		value /= 1024.0;
+		++unit;
+	}
+
+	snprintf(buffer, size, unit == 0 ? "%.0f%c" : "%.1f%c", value, units[unit]);
+
+	return buffer;
+}
+
+/**
+ * @brief Print one screen of a segment
+ * @param data - [in] current contents
+ * @param previous - [in] contents of the last screen, nullptr on the first
+ */
+void PrintScreen(const DynLoader::DynSegmentData& data, const DynLoader::DynSegmentData* previous)
+{
+	char a[32], b[32], c[32], d[32], e[32];
+
+	const double elapsed = previous != nullptr && data.updatedNs > previous->updatedNs ?
+			(data.updatedNs - previous->updatedNs) / 1e9 : 0.0;
+
+	printf("pid %llu  update %llu  libraries %llu",
+			static_cast<unsigned long long>(data.pid), static_cast<unsigned long long>(data.updates),
+			static_cast<unsigned long long>(data.libraryCount + data.librariesDropped));
+	printf("  mapped %s", FormatBytes(data.mappedBytes, a, sizeof(a)));
+	if(data.memoryBudget != 0)
+		printf(" / budget %s", FormatBytes(data.memoryBudget, a, sizeof(a)));
+	printf("\n\n");
+
+	printf("%-14s %12s %10s %10s %10s %10s\n", "operation", "count", "rate/s", "mean", "p99", "max");
+	for(size_t m = 0; m < DynLoader::DynMetricCount; ++m)
+	{
+		const DynLoader::DynSegmentMetric& metric = data.metrics[m];
+		const double rate = elapsed > 0.0 ? (metric.count - previous->metrics[m].count) / elapsed : 0.0;
+
+		printf("%-14s %12llu %10.1f %10s %10s %10s\n",
+				DynLoader::DynStats::MetricName(static_cast<DynLoader::DynMetric>(m)),
+				static_cast<unsigned long long>(metric.count), rate,
+				FormatTime(metric.samples != 0 ? metric.totalNs / metric.samples : 0, a, sizeof(a)),
+				FormatTime(metric.p99Ns, b, sizeof(b)), FormatTime(metric.maxNs, c, sizeof(c)));
+	}
+
+	// Largest libraries first
+	std::vector<const DynLoader::DynSegmentLibrary*> libraries;
+	for(size_t i = 0; i < data.libraryCount; ++i)
+		libraries.push_back(&data.libraries[i]);
+	std::sort(libraries.begin(), libraries.end(),
+			[](const DynLoader::DynSegmentLibrary* x, const DynLoader::DynSegmentLibrary* y)
+			{
+				return x->textBytes + x->dataBytes + x->bssBytes > y->textBytes + y->dataBytes + y->bssBytes;
+			});
+
+	printf("\n%-40s %4s %9s %7s %8s %8s %8s %8s\n", "library", "ns", "instances", "handles",
+			"text", "data", "bss", "idle");
+	for(auto library : libraries)
+	{
+		printf("%-40.40s %4u %9llu %7llu %8s %8s %8s %8s%s\n", library->name, library->space,
+				static_cast<unsigned long long>(library->instances),
+				static_cast<unsigned long long>(library->handles),
+				FormatBytes(library->textBytes, b, sizeof(b)), FormatBytes(library->dataBytes, c, sizeof(c)),
+				FormatBytes(library->bssBytes, d, sizeof(d)), FormatTime(library->idleNs, e, sizeof(e)),
+				library->pinned ? "  pinned" : "");
+	}
+
+	if(data.librariesDropped != 0)
+		printf("... %llu more\n", static_cast<unsigned long long>(data.librariesDropped));
+}
+
+} // anonymous namespace
+
+/**
+ * @brief Display the stats segment published by a process
+ */
+int main(int argc, char** argv)
+{
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage %s <pid|segmentName> [<delayMs> [<updates>]]\n", argv[0]);
+		return 1;
+	}
+
+	const bool isPid = strspn(argv[1], "0123456789") == strlen(argv[1]);
+	const DynLoader::dyn_string name = isPid ?
+			DynLoader::DynStatsSegment::DefaultName(atol(argv[1])) : DynLoader::dyn_string(argv[1]);
+	const std::chrono::milliseconds delay(argc > 2 ? atol(argv[2]) : 1000);
+	const long updates = argc > 3 ? atol(argv[3]) : 0;
+
+	try
+	{
+		DynLoader::DynStatsSegment segment(name, DynLoader::DynSegmentAccess::Read);
+
+		const bool screen = isatty(STDOUT_FILENO) != 0;
+		std::unique_ptr<DynLoader::DynSegmentData> current(new DynLoader::DynSegmentData());
+		std::unique_ptr<DynLoader::DynSegmentData> previous;
+
+		for(long n = 0; updates == 0 || n < updates; ++n)
+		{
+			if(!segment.Read(*current))
+			{
+				fprintf(stderr, "%s: no consistent update\n", name.c_str());
+				return 1;
+			}
+
+			if(screen)
+				printf("\033[H\033[2J");
+			PrintScreen(*current, previous.get());
+			fflush(stdout);
+
+			// The segment outlives its process while mapped here
+			if(current->pid != 0 && kill(static_cast<pid_t>(current->pid), 0) != 0 && errno == ESRCH)
+			{
+				printf("\nprocess %llu exited\n", static_cast<unsigned long long>(current->pid));
+				break;
+			}
+
+			if(!previous)
+				previous.reset(new DynLoader::DynSegmentData());
+			std::swap(previous, current);
+
+			if(updates == 0 || n + 1 < updates)
+				std::this_thread::sleep_for(delay);
+		}
+	}
+	catch(DynLoader::LoaderException& ex)
+	{
+		fprintf(stderr, "Loader exception: %s\n", ex.what());
+		return 1;
+	}
+
+	return 0;
+}
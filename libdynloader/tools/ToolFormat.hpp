@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2010-2014, Adam Gregoire
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Igor Semenov nor the names of its contributors
+ *       may be used to endorse or promote products derived from this software
+ *       without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY IGOR SEMENOV ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL IGOR SEMENOV BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TOOLFORMAT_HPP__
+#define __TOOLFORMAT_HPP__
+
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @file ToolFormat.hpp
+ * @brief Value formatting shared by the command line tools
+ */
+
+/**
+ * @brief Format a duration in nanoseconds with a unit
+ * @param ns - [in] duration in nanoseconds
+ * @param buffer - [out] output buffer
+ * @param size - [in] size of the buffer
+ * @return buffer
+ */
+inline const char* FormatTime(uint64_t ns, char* buffer, size_t size)
+{
+	if(ns < 1000)
+		snprintf(buffer, size, "%lluns", static_cast<unsigned long long>(ns));
+	else if(ns < 1000000)
+		snprintf(buffer, size, "%.1fus", ns / 1e3);
+	else if(ns < 1000000000)
+		snprintf(buffer, size, "%.1fms", ns / 1e6);
+	else
+		snprintf(buffer, size, "%.1fs", ns / 1e9);
+
+	return buffer;
+}
+
+#endif // __TOOLFORMAT_HPP__